@@ -0,0 +1,95 @@
+#pragma once
+
+#include <stdlib.h>
+#include <string.h>
+#include <utility>
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+// A growable array whose storage is aligned to a cache line, so the SIMD
+// kernels can use aligned loads/stores and per-thread slices don't share
+// cache lines. Contents are not preserved across resize().
+template <typename T>
+class AlignedBuffer
+{
+public:
+	static const size_t Alignment = 64;
+
+	AlignedBuffer() :
+		myData(nullptr),
+		mySize(0),
+		myCapacity(0)
+	{
+	}
+
+	~AlignedBuffer()
+	{
+		release();
+	}
+
+	AlignedBuffer(const AlignedBuffer&) = delete;
+	AlignedBuffer& operator=(const AlignedBuffer&) = delete;
+
+	// Returns true if the buffer had to be reallocated
+	bool
+	resize(size_t size)
+	{
+		mySize = size;
+		if (size <= myCapacity)
+			return false;
+
+		release();
+		mySize = size;
+		myCapacity = size;
+#ifdef _WIN32
+		myData = static_cast<T*>(_aligned_malloc(size * sizeof(T), Alignment));
+#else
+		void* p = nullptr;
+		if (posix_memalign(&p, Alignment, size * sizeof(T)) != 0)
+			p = nullptr;
+		myData = static_cast<T*>(p);
+#endif
+		return true;
+	}
+
+	void
+	swap(AlignedBuffer& other)
+	{
+		std::swap(myData, other.myData);
+		std::swap(mySize, other.mySize);
+		std::swap(myCapacity, other.myCapacity);
+	}
+
+	void
+	clear()
+	{
+		if (myData)
+			memset(myData, 0, mySize * sizeof(T));
+	}
+
+	T*			data() { return myData; }
+	const T*	data() const { return myData; }
+	size_t		size() const { return mySize; }
+
+	T&			operator[](size_t i) { return myData[i]; }
+	const T&	operator[](size_t i) const { return myData[i]; }
+
+private:
+	void
+	release()
+	{
+#ifdef _WIN32
+		_aligned_free(myData);
+#else
+		free(myData);
+#endif
+		myData = nullptr;
+		mySize = 0;
+		myCapacity = 0;
+	}
+
+	T*			myData;
+	size_t		mySize;
+	size_t		myCapacity;
+};
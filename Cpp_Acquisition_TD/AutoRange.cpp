@@ -0,0 +1,81 @@
+#include "stdafx.h"
+#include "AutoRange.h"
+#include <algorithm>
+#include <cmath>
+
+// Narrowest range it will pick, one histogram bin
+static const double BinSize = double(1 << DepthStats::BinShift);
+
+AutoRange::AutoRange() :
+	myTotal(0.0),
+	myPrimed(false),
+	myStart(0.0),
+	myEnd(0.0)
+{
+	std::fill(myHistogram, myHistogram + DepthStats::NumBins, 0.0);
+}
+
+void
+AutoRange::reset()
+{
+	myPrimed = false;
+}
+
+void
+AutoRange::apply(const DepthStats& stats, const AutoRangeSettings& settings,
+	double startDistance, double endDistance)
+{
+	if (!myPrimed)
+	{
+		myStart = startDistance;
+		myEnd = endDistance;
+	}
+	if (stats.validCount == 0)
+		return;
+
+	// The first frame with any depth fills the histogram on its own
+	const double rate = myPrimed ? std::min(1.0, std::max(0.0, settings.rate)) : 1.0;
+	myTotal = 0.0;
+	for (int i = 0; i < DepthStats::NumBins; i++)
+	{
+		myHistogram[i] += (double(stats.histogram[i]) - myHistogram[i]) * rate;
+		myTotal += myHistogram[i];
+	}
+	if (myTotal <= 0.0)
+		return;
+
+	const double nearPercent = std::min(100.0, std::max(0.0, settings.nearPercentile));
+	const double farPercent = std::min(100.0, std::max(nearPercent, settings.farPercentile));
+	const double start = percentile(nearPercent);
+	const double end = std::max(start + BinSize, percentile(farPercent));
+
+	if (!myPrimed || std::fabs(start - myStart) > settings.hysteresis)
+		myStart = start;
+	if (!myPrimed || std::fabs(end - myEnd) > settings.hysteresis)
+		myEnd = end;
+	// Near moving past a Far that stayed put would turn the ramp around
+	if (myEnd < myStart + BinSize)
+	{
+		myStart = start;
+		myEnd = end;
+	}
+	myPrimed = true;
+}
+
+double
+AutoRange::percentile(double percent) const
+{
+	const double target = myTotal * percent / 100.0;
+	double below = 0.0;
+	for (int i = 0; i < DepthStats::NumBins; i++)
+	{
+		const double count = myHistogram[i];
+		if (below + count >= target && count > 0.0)
+		{
+			// Spread evenly over the bin
+			return (i + (target - below) / count) * BinSize;
+		}
+		below += count;
+	}
+	return DepthStats::NumBins * BinSize;
+}
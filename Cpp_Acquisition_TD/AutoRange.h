@@ -0,0 +1,48 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "DepthKernels.h"
+
+struct AutoRangeSettings
+{
+	bool		enabled = false;
+	// Percent of the valid pixels nearer than Near, and nearer than Far
+	double		nearPercentile = 2.0;
+	double		farPercentile = 98.0;
+	// Weight of the new frame in the running histogram, 0..1
+	double		rate = 0.1;
+	// Near or Far only move once the percentile is further than this (mm)
+	// from where they are, so they don't flicker with the noise
+	double		hysteresis = 100.0;
+};
+
+// Derives Near and Far from percentiles of a running histogram of the depth,
+// the DepthStats histogram averaged over the frames. Per frame this only
+// walks the 256 bins, the pixels are counted by extractDepth.
+class AutoRange
+{
+public:
+	AutoRange();
+
+	// Updates the range with a frame's statistics. Until there's been a
+	// frame with valid pixels the range is startDistance to endDistance.
+	void		apply(const DepthStats& stats, const AutoRangeSettings& settings,
+					double startDistance, double endDistance);
+
+	// Forget the history, the next frame sets the range straight away
+	void		reset();
+
+	double		startDistance() const { return myStart; }
+	double		endDistance() const { return myEnd; }
+
+private:
+	// Depth (mm) below which percent of the running histogram lies
+	double		percentile(double percent) const;
+
+	double		myHistogram[DepthStats::NumBins];
+	double		myTotal;
+	bool		myPrimed;
+	double		myStart;
+	double		myEnd;
+};
@@ -0,0 +1,233 @@
+#include "stdafx.h"
+#include "BackgroundModel.h"
+#include "Simd.h"
+#include <algorithm>
+#include <cmath>
+#include <string.h>
+
+BackgroundModel::BackgroundModel() :
+	myCount(0),
+	myRestart(true),
+	myFramesLearned(0),
+	myLearnInBackground(false),
+	myLearner(nullptr),
+	myLearnerExit(false),
+	myLearnerBusy(false),
+	myHasPending(false)
+{
+}
+
+BackgroundModel::~BackgroundModel()
+{
+	stopLearner();
+}
+
+void
+BackgroundModel::setLearnInBackground(bool background)
+{
+	if (!background)
+		stopLearner();
+	myLearnInBackground = background;
+}
+
+void
+BackgroundModel::learn()
+{
+	myRestart.store(true);
+}
+
+void
+BackgroundModel::stopLearner()
+{
+	if (!myLearner)
+		return;
+
+	{
+		std::lock_guard<std::mutex> lock(myLock);
+		myLearnerExit = true;
+	}
+	myWake.notify_all();
+	myLearner->join();
+	delete myLearner;
+	myLearner = nullptr;
+	myLearnerExit = false;
+	myHasPending = false;
+}
+
+void
+BackgroundModel::resize(size_t count)
+{
+	// Wait for the learner to finish with the old size, and keep it out
+	// until everything has the new one
+	std::unique_lock<std::mutex> lock(myLock);
+	myIdle.wait(lock, [this]() { return !myLearnerBusy; });
+
+	myCount = count;
+	myMean.assign(count, 0.0f);
+	myDeviation.assign(count, 0.0f);
+	mySamples.assign(count, 0);
+	myLimit.resize(count);
+	myLimit.clear();
+	myBackLimit.resize(count);
+	myHasPending = false;
+	myRestart.store(true);
+}
+
+void
+BackgroundModel::apply(int16_t* depth, uint8_t* mask, size_t count,
+	const BackgroundSettings& settings, bool clearBackground)
+{
+	if (count != myCount)
+		resize(count);
+
+	if (myLearnInBackground)
+	{
+		if (!myLearner)
+			myLearner = new std::thread([this]() { learnerMain(); });
+
+		// Replaces any frame the learner didn't get to yet
+		{
+			std::lock_guard<std::mutex> lock(myLock);
+			myPending.resize(count);
+			memcpy(myPending.data(), depth, count * sizeof(int16_t));
+			myPendingSettings = settings;
+			myHasPending = true;
+		}
+		myWake.notify_one();
+	}
+	else
+	{
+		update(depth, settings);
+	}
+
+	std::lock_guard<std::mutex> lock(myLimitLock);
+	const int16_t* limit = myLimit.data();
+
+	size_t i = 0;
+#ifdef DEPTH_SSE2
+	const __m128i zero = _mm_setzero_si128();
+	for (; i + 16 <= count; i += 16)
+	{
+		const __m128i z0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(depth + i));
+		const __m128i z1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(depth + i + 8));
+		const __m128i l0 = _mm_load_si128(reinterpret_cast<const __m128i*>(limit + i));
+		const __m128i l1 = _mm_load_si128(reinterpret_cast<const __m128i*>(limit + i + 8));
+
+		const __m128i f0 = _mm_and_si128(_mm_cmpgt_epi16(z0, zero), _mm_cmplt_epi16(z0, l0));
+		const __m128i f1 = _mm_and_si128(_mm_cmpgt_epi16(z1, zero), _mm_cmplt_epi16(z1, l1));
+
+		// 0xffff/0 saturate to 0xff/0
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(mask + i), _mm_packs_epi16(f0, f1));
+
+		if (clearBackground)
+		{
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(depth + i), _mm_and_si128(z0, f0));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(depth + i + 8), _mm_and_si128(z1, f1));
+		}
+	}
+#endif
+	for (; i < count; i++)
+	{
+		const bool foreground = depth[i] > 0 && depth[i] < limit[i];
+		mask[i] = foreground ? 255 : 0;
+		if (clearBackground && !foreground)
+			depth[i] = 0;
+	}
+}
+
+void
+BackgroundModel::update(const int16_t* depth, const BackgroundSettings& settings)
+{
+	if (myRestart.exchange(false))
+	{
+		std::fill(myMean.begin(), myMean.end(), 0.0f);
+		std::fill(myDeviation.begin(), myDeviation.end(), 0.0f);
+		std::fill(mySamples.begin(), mySamples.end(), uint16_t(0));
+		myFramesLearned = 0;
+	}
+
+	const bool learning = myFramesLearned < settings.learnFrames;
+	const float rate = float(std::min(1.0, std::max(0.0, settings.learnRate)));
+	const float minDistance = float(settings.minDistance);
+	const float deviations = float(settings.deviations);
+
+	if (learning)
+		myFramesLearned++;
+	const bool learned = myFramesLearned >= settings.learnFrames;
+
+	int16_t* limit = myBackLimit.data();
+	for (size_t i = 0; i < myCount; i++)
+	{
+		const int16_t z = depth[i];
+		float& mean = myMean[i];
+		float& deviation = myDeviation[i];
+		uint16_t& samples = mySamples[i];
+
+		// Pixels that never had depth while learning stay foreground until
+		// the next Learn
+		if (z != 0 && (learning || samples != 0))
+		{
+			float weight;
+			if (samples == 0)
+			{
+				// First depth seen at this pixel
+				samples = 1;
+				mean = z;
+				deviation = 0.0f;
+				weight = 0.0f;
+			}
+			else if (learning)
+			{
+				// Straight average over the learning frames
+				if (samples < 0xffff)
+					samples++;
+				weight = 1.0f / samples;
+			}
+			else
+			{
+				// Foreground doesn't get learned into the background
+				const float margin = std::max(minDistance, deviations * deviation);
+				weight = z < mean - margin ? 0.0f : rate;
+			}
+
+			const float diff = z - mean;
+			mean += weight * diff;
+			deviation += weight * (std::fabs(diff) - deviation);
+		}
+
+		// ...but they are background while it is still learning
+		float l;
+		if (samples == 0)
+			l = learned ? 32767.0f : 0.0f;
+		else
+			l = mean - std::max(minDistance, deviations * deviation);
+		limit[i] = int16_t(std::min(32767.0f, std::max(0.0f, l)));
+	}
+
+	std::lock_guard<std::mutex> lock(myLimitLock);
+	myLimit.swap(myBackLimit);
+}
+
+void
+BackgroundModel::learnerMain()
+{
+	std::unique_lock<std::mutex> lock(myLock);
+	while (true)
+	{
+		myWake.wait(lock, [this]() { return myLearnerExit || myHasPending; });
+		if (myLearnerExit)
+			break;
+
+		myWork.swap(myPending);
+		const BackgroundSettings settings = myPendingSettings;
+		myHasPending = false;
+		myLearnerBusy = true;
+
+		lock.unlock();
+		update(myWork.data(), settings);
+		lock.lock();
+
+		myLearnerBusy = false;
+		myIdle.notify_all();
+	}
+}
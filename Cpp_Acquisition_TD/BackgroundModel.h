@@ -0,0 +1,90 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "AlignedBuffer.h"
+
+struct BackgroundSettings
+{
+	// Weight of each new frame in the background once it has been learned.
+	// Only pixels that are background at the time are updated, 0 freezes
+	// the model.
+	double		learnRate = 0.01;
+	// Number of frames averaged after a Learn
+	int32_t		learnFrames = 30;
+	// A pixel has to be at least this much (mm) in front of the background
+	// to be foreground...
+	int32_t		minDistance = 50;
+	// ...and this many times its usual deviation from the background
+	double		deviations = 3.0;
+};
+
+// Per-pixel depth background for the int16 depth plane (mm, 0 = invalid).
+//
+// Learning keeps a float mean and mean absolute deviation per pixel, and
+// from those a single int16 plane holding the depth below which a pixel is
+// foreground. Classifying a frame is then one SIMD compare per pixel
+// against that plane, which is all the acquisition thread has to do; the
+// learning can run on a thread of its own, which picks up whichever frame
+// is newest when it's done with the last one.
+class BackgroundModel
+{
+public:
+	BackgroundModel();
+	~BackgroundModel();
+
+	BackgroundModel(const BackgroundModel&) = delete;
+	BackgroundModel& operator=(const BackgroundModel&) = delete;
+
+	// Learn on a thread of our own instead of in apply(). Off by default so
+	// offline processing gives the same result every run.
+	void		setLearnInBackground(bool background);
+
+	// Throws away the background and learns it again from the next frames
+	void		learn();
+
+	// Sets mask to 255 for foreground and 0 for background or invalid
+	// pixels, and hands the frame to the learner. If clearBackground is set
+	// everything but the foreground is zeroed in depth.
+	void		apply(int16_t* depth, uint8_t* mask, size_t count,
+					const BackgroundSettings& settings, bool clearBackground);
+
+private:
+	void		resize(size_t count);
+	void		update(const int16_t* depth, const BackgroundSettings& settings);
+	void		learnerMain();
+	void		stopLearner();
+
+	size_t					myCount;
+	std::atomic<bool>		myRestart;
+
+	// Only touched by whoever runs update()
+	std::vector<float>		myMean;
+	std::vector<float>		myDeviation;
+	std::vector<uint16_t>	mySamples;
+	int32_t					myFramesLearned;
+
+	// Foreground is depth < limit. The learner fills myBackLimit and swaps
+	// it with myLimit under myLimitLock, which apply() holds while it reads.
+	std::mutex				myLimitLock;
+	AlignedBuffer<int16_t>	myLimit;
+	AlignedBuffer<int16_t>	myBackLimit;
+
+	// Hand-off to the learner thread
+	bool					myLearnInBackground;
+	std::thread*			myLearner;
+	std::mutex				myLock;
+	std::condition_variable	myWake;
+	std::condition_variable	myIdle;
+	bool					myLearnerExit;
+	bool					myLearnerBusy;
+	bool					myHasPending;
+	AlignedBuffer<int16_t>	myPending;
+	BackgroundSettings		myPendingSettings;
+	AlignedBuffer<int16_t>	myWork;
+};
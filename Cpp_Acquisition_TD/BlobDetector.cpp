@@ -0,0 +1,192 @@
+#include "stdafx.h"
+#include "BlobDetector.h"
+#include <algorithm>
+
+BlobDetector::BlobDetector()
+{
+}
+
+// Path halving: every label visited skips to its grandparent
+int32_t
+BlobDetector::find(int32_t label)
+{
+	while (myParents[label] != label)
+	{
+		myParents[label] = myParents[myParents[label]];
+		label = myParents[label];
+	}
+	return label;
+}
+
+// The smaller label becomes the root, so a label's parent is never larger
+// than itself, which the second pass relies on
+int32_t
+BlobDetector::merge(int32_t a, int32_t b)
+{
+	a = find(a);
+	b = find(b);
+	if (a < b)
+	{
+		myParents[b] = a;
+		return a;
+	}
+	myParents[a] = b;
+	return b;
+}
+
+void
+BlobDetector::apply(const uint8_t* mask, const int16_t* depth, size_t width, size_t height,
+	const BlobSettings& settings, std::vector<Blob>& blobs)
+{
+	blobs.clear();
+	if (width == 0 || height == 0)
+		return;
+
+	const size_t count = width * height;
+	myLabels.resize(count);
+	myParents.clear();
+	// Label 0 is the background
+	myParents.push_back(0);
+
+	// First pass: provisional labels. Of the neighbors above and to the
+	// left only those that aren't already known to touch are checked.
+	for (size_t y = 0; y < height; y++)
+	{
+		const uint8_t* m = mask + y * width;
+		int32_t* labels = myLabels.data() + y * width;
+		const int32_t* above = y > 0 ? labels - width : nullptr;
+
+		for (size_t x = 0; x < width; x++)
+		{
+			if (!m[x])
+			{
+				labels[x] = 0;
+				continue;
+			}
+
+			const int32_t left = x > 0 ? labels[x - 1] : 0;
+			const int32_t up = above ? above[x] : 0;
+			const int32_t upLeft = above && x > 0 ? above[x - 1] : 0;
+			const int32_t upRight = above && x + 1 < width ? above[x + 1] : 0;
+
+			int32_t label;
+			if (up)
+			{
+				// Touches both the upper corners and the left pixel already
+				label = up;
+			}
+			else if (upRight)
+			{
+				label = upRight;
+				if (left)
+					label = merge(label, left);
+				else if (upLeft)
+					label = merge(label, upLeft);
+			}
+			else if (left)
+			{
+				label = left;
+			}
+			else if (upLeft)
+			{
+				label = upLeft;
+			}
+			else
+			{
+				label = int32_t(myParents.size());
+				myParents.push_back(label);
+			}
+			labels[x] = label;
+		}
+	}
+
+	// Second pass: number the roots 0..n-1 and point every label at its
+	// root's number
+	const int32_t numLabels = int32_t(myParents.size());
+	int32_t numComponents = 0;
+	for (int32_t l = 1; l < numLabels; l++)
+	{
+		if (myParents[l] == l)
+			myParents[l] = numComponents++;
+		else
+			myParents[l] = myParents[myParents[l]];
+	}
+
+	Stats empty;
+	empty.sumX = 0;
+	empty.sumY = 0;
+	empty.sumDepth = 0;
+	empty.area = 0;
+	empty.depthArea = 0;
+	empty.minX = int32_t(width);
+	empty.minY = int32_t(height);
+	empty.maxX = -1;
+	empty.maxY = -1;
+	empty.minDepth = INT32_MAX;
+	empty.nearX = 0;
+	empty.nearY = 0;
+	myStats.assign(numComponents, empty);
+
+	for (size_t y = 0; y < height; y++)
+	{
+		const int32_t* labels = myLabels.data() + y * width;
+		const int16_t* z = depth + y * width;
+		for (size_t x = 0; x < width; x++)
+		{
+			if (!labels[x])
+				continue;
+
+			Stats& s = myStats[myParents[labels[x]]];
+			s.area++;
+			s.sumX += x;
+			s.sumY += y;
+			s.minX = std::min(s.minX, int32_t(x));
+			s.maxX = std::max(s.maxX, int32_t(x));
+			s.minY = std::min(s.minY, int32_t(y));
+			s.maxY = std::max(s.maxY, int32_t(y));
+			if (z[x] > 0)
+			{
+				s.depthArea++;
+				s.sumDepth += z[x];
+				if (z[x] < s.minDepth)
+				{
+					s.minDepth = z[x];
+					s.nearX = int32_t(x);
+					s.nearY = int32_t(y);
+				}
+			}
+		}
+	}
+
+	const float w = float(width);
+	const float h = float(height);
+	for (const Stats& s : myStats)
+	{
+		if (s.area < settings.minArea)
+			continue;
+
+		Blob b;
+		b.id = 0;
+		b.area = s.area;
+		b.u = (float(s.sumX) / s.area + 0.5f) / w;
+		b.v = (h - float(s.sumY) / s.area - 0.5f) / h;
+		b.uMin = s.minX / w;
+		b.uMax = (s.maxX + 1) / w;
+		b.vMin = (h - s.maxY - 1) / h;
+		b.vMax = (h - s.minY) / h;
+		b.meanDepth = s.depthArea ? float(s.sumDepth) / s.depthArea : 0.0f;
+		b.minDepth = s.depthArea ? float(s.minDepth) : 0.0f;
+		b.nearU = (s.nearX + 0.5f) / w;
+		b.nearV = (h - s.nearY - 0.5f) / h;
+		b.velocityU = 0.0f;
+		b.velocityV = 0.0f;
+		blobs.push_back(b);
+	}
+
+	std::sort(blobs.begin(), blobs.end(),
+		[](const Blob& a, const Blob& b) { return a.area > b.area; });
+	if (settings.maxBlobs >= 0 && blobs.size() > size_t(settings.maxBlobs))
+		blobs.resize(settings.maxBlobs);
+	for (size_t i = 0; i < blobs.size(); i++)
+		blobs[i].id = int32_t(i);
+}
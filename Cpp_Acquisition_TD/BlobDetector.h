@@ -0,0 +1,90 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+enum class BlobSource : int32_t
+{
+	Off = 0,
+	// The foreground mask of the background model
+	Foreground,
+	// Everything between Near and Far
+	DepthSlice,
+};
+
+struct BlobSettings
+{
+	BlobSource	source = BlobSource::Off;
+	// Smaller blobs (pixels) are dropped as noise
+	int32_t		minArea = 50;
+	// Only the largest maxBlobs are kept
+	int32_t		maxBlobs = 16;
+};
+
+// One connected region of the mask. Positions are in the TOP's texture
+// coordinates: 0..1, with v going up like the output image.
+struct Blob
+{
+	// Persistent across frames once a tracker assigns it, else the rank
+	// by area
+	int32_t		id;
+
+	float		u;
+	float		v;
+	float		uMin;
+	float		vMin;
+	float		uMax;
+	float		vMax;
+
+	int32_t		area;
+	// mm
+	float		meanDepth;
+	float		minDepth;
+
+	// Where minDepth was found
+	float		nearU;
+	float		nearV;
+
+	// Per frame, filled in by the tracker
+	float		velocityU;
+	float		velocityV;
+};
+
+// Two pass connected components (8-connected) on an 8 bit mask, with a
+// union-find over the provisional labels. Runs in time linear in the
+// number of pixels, whatever the mask looks like.
+class BlobDetector
+{
+public:
+	BlobDetector();
+
+	// depth is only read where mask is set. Blobs come out sorted by area,
+	// largest first.
+	void		apply(const uint8_t* mask, const int16_t* depth, size_t width, size_t height,
+					const BlobSettings& settings, std::vector<Blob>& blobs);
+
+private:
+	int32_t		find(int32_t label);
+	int32_t		merge(int32_t a, int32_t b);
+
+	struct Stats
+	{
+		int64_t		sumX;
+		int64_t		sumY;
+		int64_t		sumDepth;
+		int32_t		area;
+		int32_t		depthArea;
+		int32_t		minX;
+		int32_t		minY;
+		int32_t		maxX;
+		int32_t		maxY;
+		int32_t		minDepth;
+		int32_t		nearX;
+		int32_t		nearY;
+	};
+
+	std::vector<int32_t>	myLabels;
+	std::vector<int32_t>	myParents;
+	std::vector<Stats>		myStats;
+};
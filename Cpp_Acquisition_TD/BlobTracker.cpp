@@ -0,0 +1,266 @@
+#include "stdafx.h"
+#include "BlobTracker.h"
+#include <algorithm>
+#include <limits>
+
+// Cost given to pairs outside the gate in the optimal assignment, more
+// than any real squared distance in u/v
+static const double OutsideGate = 1000.0;
+
+void
+BlobTracker::Axis::init(float p, float r)
+{
+	position = p;
+	velocity = 0.0f;
+	pp = r;
+	pv = 0.0f;
+	// Nothing is known about the velocity yet, allow for a tenth of the
+	// image per frame
+	vv = 0.01f;
+}
+
+void
+BlobTracker::Axis::predict(float q)
+{
+	// x' = F x, P' = F P F^T + Q for F = [1 1; 0 1] and a random
+	// acceleration with variance q
+	position += velocity;
+	pp += 2.0f * pv + vv + 0.25f * q;
+	pv += vv + 0.5f * q;
+	vv += q;
+}
+
+void
+BlobTracker::Axis::correct(float z, float r)
+{
+	const float s = pp + r;
+	const float kp = pp / s;
+	const float kv = pv / s;
+	const float innovation = z - position;
+
+	position += kp * innovation;
+	velocity += kv * innovation;
+
+	vv -= kv * pv;
+	pv -= kp * pv;
+	pp -= kp * pp;
+}
+
+BlobTracker::BlobTracker() :
+	myNextId(0)
+{
+}
+
+void
+BlobTracker::reset()
+{
+	myTracks.clear();
+	myNextId = 0;
+}
+
+void
+BlobTracker::apply(std::vector<Blob>& blobs, const TrackerSettings& settings)
+{
+	const float q = float(settings.processNoise * settings.processNoise);
+	const float r = float(settings.measurementNoise * settings.measurementNoise);
+
+	for (Track& t : myTracks)
+	{
+		t.u.predict(q);
+		t.v.predict(q);
+	}
+
+	myTrackBlob.assign(myTracks.size(), -1);
+	myBlobTrack.assign(blobs.size(), -1);
+	if (!myTracks.empty() && !blobs.empty())
+	{
+		if (settings.assignment == TrackAssignment::Optimal)
+			assignOptimal(blobs, float(settings.gate));
+		else
+			assignGreedy(blobs, float(settings.gate));
+	}
+
+	myOutput.clear();
+	for (size_t b = 0; b < blobs.size(); b++)
+	{
+		Blob blob = blobs[b];
+		Track* t;
+		if (myBlobTrack[b] >= 0)
+		{
+			t = &myTracks[myBlobTrack[b]];
+			t->u.correct(blob.u, r);
+			t->v.correct(blob.v, r);
+			t->missed = 0;
+		}
+		else
+		{
+			Track track;
+			track.id = myNextId++;
+			track.missed = 0;
+			track.u.init(blob.u, r);
+			track.v.init(blob.v, r);
+			myTracks.push_back(track);
+			t = &myTracks.back();
+		}
+
+		blob.id = t->id;
+		blob.u = t->u.position;
+		blob.v = t->v.position;
+		blob.velocityU = t->u.velocity;
+		blob.velocityV = t->v.velocity;
+		myOutput.push_back(blob);
+	}
+
+	// Tracks that found no blob coast along their prediction for a while.
+	// myTrackBlob only covers the tracks from before this frame.
+	for (size_t i = 0; i < myTrackBlob.size(); i++)
+	{
+		if (myTrackBlob[i] < 0)
+			myTracks[i].missed++;
+	}
+	const int32_t maxMissed = settings.maxMissed;
+	myTracks.erase(std::remove_if(myTracks.begin(), myTracks.end(),
+		[maxMissed](const Track& t) { return t.missed > maxMissed; }), myTracks.end());
+
+	blobs.swap(myOutput);
+}
+
+void
+BlobTracker::assignGreedy(const std::vector<Blob>& blobs, float gate)
+{
+	const float gate2 = gate * gate;
+
+	myPairs.clear();
+	for (size_t t = 0; t < myTracks.size(); t++)
+	{
+		const float pu = myTracks[t].u.position;
+		const float pv = myTracks[t].v.position;
+		for (size_t b = 0; b < blobs.size(); b++)
+		{
+			const float du = blobs[b].u - pu;
+			const float dv = blobs[b].v - pv;
+			const float cost = du * du + dv * dv;
+			if (cost <= gate2)
+			{
+				Pair pair;
+				pair.cost = cost;
+				pair.track = int32_t(t);
+				pair.blob = int32_t(b);
+				myPairs.push_back(pair);
+			}
+		}
+	}
+
+	std::sort(myPairs.begin(), myPairs.end(),
+		[](const Pair& a, const Pair& b) { return a.cost < b.cost; });
+
+	for (const Pair& pair : myPairs)
+	{
+		if (myTrackBlob[pair.track] < 0 && myBlobTrack[pair.blob] < 0)
+		{
+			myTrackBlob[pair.track] = pair.blob;
+			myBlobTrack[pair.blob] = pair.track;
+		}
+	}
+}
+
+void
+BlobTracker::assignOptimal(const std::vector<Blob>& blobs, float gate)
+{
+	const double gate2 = double(gate) * gate;
+
+	// The method wants no more rows than columns
+	const bool tracksAreRows = myTracks.size() <= blobs.size();
+	const size_t n = tracksAreRows ? myTracks.size() : blobs.size();
+	const size_t m = tracksAreRows ? blobs.size() : myTracks.size();
+
+	// 1-based, as in the usual formulation
+	myCost.assign((n + 1) * (m + 1), 0.0);
+	for (size_t t = 0; t < myTracks.size(); t++)
+	{
+		for (size_t b = 0; b < blobs.size(); b++)
+		{
+			const double du = blobs[b].u - myTracks[t].u.position;
+			const double dv = blobs[b].v - myTracks[t].v.position;
+			double cost = du * du + dv * dv;
+			if (cost > gate2)
+				cost = OutsideGate;
+
+			const size_t i = tracksAreRows ? t + 1 : b + 1;
+			const size_t j = tracksAreRows ? b + 1 : t + 1;
+			myCost[i * (m + 1) + j] = cost;
+		}
+	}
+
+	const double inf = std::numeric_limits<double>::infinity();
+	std::vector<double> rowPotential(n + 1, 0.0);
+	std::vector<double> columnPotential(m + 1, 0.0);
+	std::vector<size_t> columnRow(m + 1, 0);
+	std::vector<size_t> way(m + 1, 0);
+	std::vector<double> minSlack(m + 1);
+	std::vector<char> used(m + 1);
+
+	for (size_t i = 1; i <= n; i++)
+	{
+		columnRow[0] = i;
+		size_t j0 = 0;
+		std::fill(minSlack.begin(), minSlack.end(), inf);
+		std::fill(used.begin(), used.end(), 0);
+
+		do
+		{
+			used[j0] = 1;
+			const size_t i0 = columnRow[j0];
+			double delta = inf;
+			size_t j1 = 0;
+			for (size_t j = 1; j <= m; j++)
+			{
+				if (used[j])
+					continue;
+				const double slack = myCost[i0 * (m + 1) + j] - rowPotential[i0] - columnPotential[j];
+				if (slack < minSlack[j])
+				{
+					minSlack[j] = slack;
+					way[j] = j0;
+				}
+				if (minSlack[j] < delta)
+				{
+					delta = minSlack[j];
+					j1 = j;
+				}
+			}
+			for (size_t j = 0; j <= m; j++)
+			{
+				if (used[j])
+				{
+					rowPotential[columnRow[j]] += delta;
+					columnPotential[j] -= delta;
+				}
+				else
+				{
+					minSlack[j] -= delta;
+				}
+			}
+			j0 = j1;
+		} while (columnRow[j0] != 0);
+
+		do
+		{
+			const size_t j1 = way[j0];
+			columnRow[j0] = columnRow[j1];
+			j0 = j1;
+		} while (j0);
+	}
+
+	for (size_t j = 1; j <= m; j++)
+	{
+		const size_t i = columnRow[j];
+		if (!i || myCost[i * (m + 1) + j] >= OutsideGate)
+			continue;
+
+		const size_t t = tracksAreRows ? i - 1 : j - 1;
+		const size_t b = tracksAreRows ? j - 1 : i - 1;
+		myTrackBlob[t] = int32_t(b);
+		myBlobTrack[b] = int32_t(t);
+	}
+}
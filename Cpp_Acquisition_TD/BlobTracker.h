@@ -0,0 +1,90 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+#include "BlobDetector.h"
+
+enum class TrackAssignment : int32_t
+{
+	// Closest pairs first, cheap enough for hundreds of targets
+	Greedy = 0,
+	// Hungarian method, the lowest total distance, O(n^3)
+	Optimal,
+};
+
+struct TrackerSettings
+{
+	bool			enabled = false;
+	TrackAssignment	assignment = TrackAssignment::Greedy;
+	// Furthest (in u/v) a blob can be from where a track is expected to be
+	// and still continue it
+	double			gate = 0.05;
+	// Frames a track survives without a blob before its ID is dropped
+	int32_t			maxMissed = 10;
+	// Kalman noise, in u/v per frame. More process noise follows quick
+	// turns sooner, more measurement noise smooths more.
+	double			processNoise = 0.0005;
+	double			measurementNoise = 0.002;
+};
+
+// Gives blobs IDs that stay the same from frame to frame. Every track
+// runs a constant velocity Kalman filter per axis, which predicts where
+// it will be in the next frame; blobs within the gate of that prediction
+// are assigned to tracks, and the rest start new tracks.
+class BlobTracker
+{
+public:
+	BlobTracker();
+
+	// Replaces the blobs with the ones that continue or start a track,
+	// with the track's ID, filtered position and velocity
+	void		apply(std::vector<Blob>& blobs, const TrackerSettings& settings);
+
+	// Drops all tracks, IDs start over from 0
+	void		reset();
+
+private:
+	// One axis of the constant velocity filter
+	struct Axis
+	{
+		float	position;
+		float	velocity;
+		// Covariance
+		float	pp;
+		float	pv;
+		float	vv;
+
+		void	init(float p, float r);
+		void	predict(float q);
+		void	correct(float z, float r);
+	};
+
+	struct Track
+	{
+		int32_t	id;
+		int32_t	missed;
+		Axis	u;
+		Axis	v;
+	};
+
+	void		assignGreedy(const std::vector<Blob>& blobs, float gate);
+	void		assignOptimal(const std::vector<Blob>& blobs, float gate);
+
+	std::vector<Track>		myTracks;
+	int32_t					myNextId;
+
+	// Scratch, kept around to avoid allocating per frame
+	struct Pair
+	{
+		float	cost;
+		int32_t	track;
+		int32_t	blob;
+	};
+	std::vector<Pair>		myPairs;
+	// Blob assigned to each track, -1 for none
+	std::vector<int32_t>	myTrackBlob;
+	std::vector<int32_t>	myBlobTrack;
+	std::vector<double>		myCost;
+	std::vector<Blob>		myOutput;
+};
@@ -0,0 +1,160 @@
+#include "stdafx.h"
+#include "CameraControl.h"
+#include "CameraNodes.h"
+#include <algorithm>
+#include <string.h>
+
+static const char*
+rangeEntry(CameraRange range)
+{
+	switch (range)
+	{
+		case CameraRange::Near1250: return "Distance1250mmSingleFreq";
+		case CameraRange::Mid3000: return "Distance3000mmSingleFreq";
+		case CameraRange::Mid4000: return "Distance4000mmSingleFreq";
+		case CameraRange::Far5000: return "Distance5000mmMultiFreq";
+		case CameraRange::Far6000: return "Distance6000mmSingleFreq";
+		case CameraRange::Far8300: return "Distance8300mmMultiFreq";
+		default: return nullptr;
+	}
+}
+
+static const char*
+exposureEntry(CameraExposure exposure)
+{
+	switch (exposure)
+	{
+		case CameraExposure::Short62: return "Exp62_5Us";
+		case CameraExposure::Medium250: return "Exp250Us";
+		case CameraExposure::Long1000: return "Exp1000Us";
+		default: return nullptr;
+	}
+}
+
+static const char*
+gainEntry(CameraGain gain)
+{
+	switch (gain)
+	{
+		case CameraGain::Low: return "Low";
+		case CameraGain::High: return "High";
+		default: return nullptr;
+	}
+}
+
+CameraControl::CameraControl() :
+	myApplied(false)
+{
+}
+
+void
+CameraControl::open(GenApi::INodeMap* nodeMap)
+{
+	myOperatingMode = nodeMap->GetNode("Scan3dOperatingMode");
+	myExposureTime = nodeMap->GetNode("ExposureTimeSelector");
+	myExposure = nodeMap->GetNode("ExposureTime");
+	myConversionGain = nodeMap->GetNode("ConversionGain");
+	myAccumulation = nodeMap->GetNode("Scan3dImageAccumulation");
+	mySpatialFilter = nodeMap->GetNode("Scan3dSpatialFilterEnable");
+	myPtp = nodeMap->GetNode("PtpEnable");
+
+	myCoordinateSelector = nodeMap->GetNode("Scan3dCoordinateSelector");
+	myCoordinateScale = nodeMap->GetNode("Scan3dCoordinateScale");
+	myCoordinateOffset = nodeMap->GetNode("Scan3dCoordinateOffset");
+
+	myApplied = false;
+}
+
+bool
+CameraControl::apply(const CameraControlSettings& settings)
+{
+	if (myApplied && settings == mySettings)
+		return false;
+
+	// Each setting only counts as applied once it's written. If the camera
+	// refuses one, the ones before it stay recorded and the rest are tried
+	// again on the next call.
+	const bool first = !myApplied;
+	bool coordinatesChanged = false;
+	if (first || settings.range != mySettings.range)
+	{
+		if (rangeEntry(settings.range))
+			coordinatesChanged = setEnumerationNode(myOperatingMode, rangeEntry(settings.range));
+		mySettings.range = settings.range;
+	}
+	if (first || settings.exposure != mySettings.exposure)
+	{
+		if (exposureEntry(settings.exposure))
+			setEnumerationNode(myExposureTime, exposureEntry(settings.exposure));
+		mySettings.exposure = settings.exposure;
+	}
+	if (first || settings.gain != mySettings.gain)
+	{
+		if (gainEntry(settings.gain))
+			setEnumerationNode(myConversionGain, gainEntry(settings.gain));
+		mySettings.gain = settings.gain;
+	}
+	if (first || settings.accumulation != mySettings.accumulation)
+	{
+		if (settings.accumulation > 0)
+			setIntegerNode(myAccumulation, settings.accumulation, 0);
+		mySettings.accumulation = settings.accumulation;
+	}
+	if (first || settings.spatialFilter != mySettings.spatialFilter)
+	{
+		setBooleanNode(mySpatialFilter, settings.spatialFilter);
+		mySettings.spatialFilter = settings.spatialFilter;
+	}
+	if (first || settings.ptp != mySettings.ptp)
+	{
+		setBooleanNode(myPtp, settings.ptp);
+		mySettings.ptp = settings.ptp;
+	}
+	myApplied = true;
+	return coordinatesChanged;
+}
+
+ScanCoordinates
+CameraControl::coordinates()
+{
+	ScanCoordinates coordinates;
+	if (setEnumerationNode(myCoordinateSelector, "CoordinateA"))
+		coordinates.offsetA = float(getFloatNode(myCoordinateOffset, 0.0));
+	if (setEnumerationNode(myCoordinateSelector, "CoordinateB"))
+		coordinates.offsetB = float(getFloatNode(myCoordinateOffset, 0.0));
+	if (setEnumerationNode(myCoordinateSelector, "CoordinateC"))
+		coordinates.scale = float(getFloatNode(myCoordinateScale, 1.0));
+	return coordinates;
+}
+
+double
+CameraControl::illumination()
+{
+	// Per phase image, in us. Without the float feature the selector says
+	// which one it is, and anything unknown counts as the longest.
+	double exposure = getFloatNode(myExposure, 0.0);
+	if (exposure <= 0.0)
+	{
+		exposure = 1000.0;
+		if (myExposureTime && GenApi::IsReadable(myExposureTime))
+		{
+			const GenICam::gcstring entry = myExposureTime->ToString();
+			if (strcmp(entry.c_str(), exposureEntry(CameraExposure::Short62)) == 0)
+				exposure = 62.5;
+			else if (strcmp(entry.c_str(), exposureEntry(CameraExposure::Medium250)) == 0)
+				exposure = 250.0;
+		}
+	}
+
+	// Each frequency takes 4 phase images
+	int64_t phases = 4;
+	if (myOperatingMode && GenApi::IsReadable(myOperatingMode))
+	{
+		const GenICam::gcstring mode = myOperatingMode->ToString();
+		if (strstr(mode.c_str(), "MultiFreq"))
+			phases = 8;
+	}
+
+	const int64_t frames = std::max<int64_t>(1, getIntegerNode(myAccumulation, 1));
+	return exposure * 1e-6 * double(phases * frames);
+}
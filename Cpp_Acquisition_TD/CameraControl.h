@@ -0,0 +1,103 @@
+#pragma once
+
+#include <stdint.h>
+#include "ArenaApi.h"
+#include "DepthKernels.h"
+
+// The Helios settings that can change while the camera streams. Camera
+// leaves a setting as the camera has it.
+enum class CameraRange
+{
+	Camera,
+	Near1250,
+	Mid3000,
+	Mid4000,
+	Far5000,
+	Far6000,
+	Far8300,
+};
+
+enum class CameraExposure
+{
+	Camera,
+	Short62,
+	Medium250,
+	Long1000,
+};
+
+enum class CameraGain
+{
+	Camera,
+	Low,
+	High,
+};
+
+struct CameraControlSettings
+{
+	// The distance range sets the modulation frequencies, and with them the
+	// depth unit, so changing it changes the ScanCoordinates
+	CameraRange		range = CameraRange::Camera;
+	CameraExposure	exposure = CameraExposure::Camera;
+	CameraGain		gain = CameraGain::Camera;
+	// Frames the camera averages into each one, 0 leaves it as it is
+	int32_t			accumulation = 0;
+	// The camera's own edge preserving filter
+	bool			spatialFilter = true;
+	// Sync the camera's clock to the others' over PTP, so the timestamps of
+	// their frames can be compared
+	bool			ptp = false;
+
+	bool			operator==(const CameraControlSettings& other) const
+					{
+						return range == other.range && exposure == other.exposure && gain == other.gain &&
+							accumulation == other.accumulation && spatialFilter == other.spatialFilter &&
+							ptp == other.ptp;
+					}
+	bool			operator!=(const CameraControlSettings& other) const { return !(*this == other); }
+};
+
+// Changes the settings of a streaming camera. The nodes are looked up once,
+// when it's opened, and only the settings that differ from what was applied
+// last are written, all in one go, so apply() can be called every frame
+// from the acquisition thread and costs nothing until a parameter moves.
+class CameraControl
+{
+public:
+	CameraControl();
+
+	// Looks up the nodes. The node map has to outlive this.
+	void			open(GenApi::INodeMap* nodeMap);
+
+	// Writes what changed since the last call, and returns true if the
+	// ScanCoordinates may have changed with it. Settings the camera lacks,
+	// or won't change while it streams, are skipped. Throws
+	// GenICam::GenericException if the camera refuses a value, after
+	// keeping the settings written before it; the ScanCoordinates may have
+	// changed then too.
+	bool			apply(const CameraControlSettings& settings);
+
+	// Reads the scale and offsets that turn the camera's pixels into mm
+	ScanCoordinates	coordinates();
+
+	// Seconds the camera lights the scene for each depth frame, all its
+	// phase images and accumulated frames together. Cameras that see each
+	// other's light mustn't light the scene at the same time.
+	double			illumination();
+
+private:
+	GenApi::CEnumerationPtr	myOperatingMode;
+	GenApi::CEnumerationPtr	myExposureTime;
+	GenApi::CFloatPtr		myExposure;
+	GenApi::CEnumerationPtr	myConversionGain;
+	GenApi::CIntegerPtr		myAccumulation;
+	GenApi::CBooleanPtr		mySpatialFilter;
+	GenApi::CBooleanPtr		myPtp;
+
+	GenApi::CEnumerationPtr	myCoordinateSelector;
+	GenApi::CFloatPtr		myCoordinateScale;
+	GenApi::CFloatPtr		myCoordinateOffset;
+
+	// Nothing was applied before the first call
+	bool			myApplied;
+	CameraControlSettings	mySettings;
+};
@@ -0,0 +1,106 @@
+#include "stdafx.h"
+#include "CameraNodes.h"
+#include <algorithm>
+
+int64_t
+getIntegerNode(const GenApi::CIntegerPtr& node, int64_t fallback)
+{
+	if (!node || !GenApi::IsReadable(node))
+		return fallback;
+	return node->GetValue();
+}
+
+double
+getFloatNode(const GenApi::CFloatPtr& node, double fallback)
+{
+	if (!node || !GenApi::IsReadable(node))
+		return fallback;
+	return node->GetValue();
+}
+
+int64_t
+setIntegerNode(const GenApi::CIntegerPtr& node, int64_t value, int64_t fallback)
+{
+	if (!node || !GenApi::IsAvailable(node))
+		return fallback;
+
+	if (GenApi::IsWritable(node))
+	{
+		const int64_t lo = node->GetMin();
+		const int64_t hi = node->GetMax();
+		const int64_t inc = std::max<int64_t>(1, node->GetInc());
+		value = std::min(std::max(value, lo), hi);
+		value = lo + (value - lo) / inc * inc;
+		if (value != node->GetValue())
+			node->SetValue(value);
+	}
+	return GenApi::IsReadable(node) ? node->GetValue() : fallback;
+}
+
+double
+setFloatNode(const GenApi::CFloatPtr& node, double value, double fallback)
+{
+	if (!node || !GenApi::IsAvailable(node))
+		return fallback;
+
+	if (GenApi::IsWritable(node))
+		node->SetValue(std::min(std::max(value, node->GetMin()), node->GetMax()));
+	return GenApi::IsReadable(node) ? node->GetValue() : fallback;
+}
+
+bool
+setBooleanNode(const GenApi::CBooleanPtr& node, bool value)
+{
+	if (!node || !GenApi::IsWritable(node))
+		return false;
+	node->SetValue(value);
+	return true;
+}
+
+bool
+setEnumerationNode(const GenApi::CEnumerationPtr& node, const char* entry)
+{
+	if (!node || !GenApi::IsWritable(node))
+		return false;
+	const auto value = node->GetEntryByName(entry);
+	if (!value || !GenApi::IsAvailable(value))
+		return false;
+	node->FromString(entry);
+	return true;
+}
+
+int64_t
+getIntegerNode(GenApi::INodeMap* nodeMap, const char* name, int64_t fallback)
+{
+	return getIntegerNode(GenApi::CIntegerPtr(nodeMap->GetNode(name)), fallback);
+}
+
+double
+getFloatNode(GenApi::INodeMap* nodeMap, const char* name, double fallback)
+{
+	return getFloatNode(GenApi::CFloatPtr(nodeMap->GetNode(name)), fallback);
+}
+
+int64_t
+setIntegerNode(GenApi::INodeMap* nodeMap, const char* name, int64_t value, int64_t fallback)
+{
+	return setIntegerNode(GenApi::CIntegerPtr(nodeMap->GetNode(name)), value, fallback);
+}
+
+double
+setFloatNode(GenApi::INodeMap* nodeMap, const char* name, double value, double fallback)
+{
+	return setFloatNode(GenApi::CFloatPtr(nodeMap->GetNode(name)), value, fallback);
+}
+
+bool
+setBooleanNode(GenApi::INodeMap* nodeMap, const char* name, bool value)
+{
+	return setBooleanNode(GenApi::CBooleanPtr(nodeMap->GetNode(name)), value);
+}
+
+bool
+setEnumerationNode(GenApi::INodeMap* nodeMap, const char* name, const char* entry)
+{
+	return setEnumerationNode(GenApi::CEnumerationPtr(nodeMap->GetNode(name)), entry);
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <stdint.h>
+#include "ArenaApi.h"
+
+// Access to the GenICam features of a camera that not every model has. A
+// feature the camera lacks, or that can't be read or changed right now,
+// is skipped, and the getters give the fallback for it instead. Errors the
+// camera reports for a value it has are still thrown as
+// GenICam::GenericException.
+//
+// The ones taking a node work on a handle looked up before, for features
+// that are changed often. Finding a node by name is a string search
+// through the whole node map.
+
+int64_t			getIntegerNode(const GenApi::CIntegerPtr& node, int64_t fallback);
+double			getFloatNode(const GenApi::CFloatPtr& node, double fallback);
+int64_t			setIntegerNode(const GenApi::CIntegerPtr& node, int64_t value, int64_t fallback);
+double			setFloatNode(const GenApi::CFloatPtr& node, double value, double fallback);
+bool			setBooleanNode(const GenApi::CBooleanPtr& node, bool value);
+bool			setEnumerationNode(const GenApi::CEnumerationPtr& node, const char* entry);
+
+int64_t			getIntegerNode(GenApi::INodeMap* nodeMap, const char* name, int64_t fallback);
+double			getFloatNode(GenApi::INodeMap* nodeMap, const char* name, double fallback);
+
+// Set the value the feature allows that is closest to the one given, and
+// return what the feature ended up as
+int64_t			setIntegerNode(GenApi::INodeMap* nodeMap, const char* name, int64_t value, int64_t fallback);
+double			setFloatNode(GenApi::INodeMap* nodeMap, const char* name, double value, double fallback);
+
+// Return false if the camera doesn't have the feature, or the entry
+bool			setBooleanNode(GenApi::INodeMap* nodeMap, const char* name, bool value);
+bool			setEnumerationNode(GenApi::INodeMap* nodeMap, const char* name, const char* entry);
@@ -0,0 +1,47 @@
+#include "stdafx.h"
+#include "CameraRoi.h"
+#include "CameraNodes.h"
+#include <algorithm>
+#include <limits>
+
+CameraRoi
+readCameraRoi(GenApi::INodeMap* nodeMap)
+{
+	CameraRoi roi;
+	roi.binning = int32_t(getIntegerNode(nodeMap, "BinningHorizontal", 1));
+	roi.decimation = int32_t(getIntegerNode(nodeMap, "DecimationHorizontal", 1));
+	roi.offsetX = int32_t(getIntegerNode(nodeMap, "OffsetX", 0));
+	roi.offsetY = int32_t(getIntegerNode(nodeMap, "OffsetY", 0));
+	roi.width = int32_t(getIntegerNode(nodeMap, "Width", 0));
+	roi.height = int32_t(getIntegerNode(nodeMap, "Height", 0));
+	return roi;
+}
+
+CameraRoi
+applyCameraRoi(GenApi::INodeMap* nodeMap, const CameraRoiSettings& settings)
+{
+	CameraRoi roi;
+
+	// These change the largest Width and Height, so they go first. Both
+	// ways get the same factor, the lens and the remap expect square pixels.
+	roi.binning = int32_t(setIntegerNode(nodeMap, "BinningHorizontal", settings.binning, 1));
+	setIntegerNode(nodeMap, "BinningVertical", roi.binning, 1);
+	roi.decimation = int32_t(setIntegerNode(nodeMap, "DecimationHorizontal", settings.decimation, 1));
+	setIntegerNode(nodeMap, "DecimationVertical", roi.decimation, 1);
+
+	// With the offsets at 0 any size up to the whole sensor fits, and the
+	// largest offsets then follow from the size
+	setIntegerNode(nodeMap, "OffsetX", 0, 0);
+	setIntegerNode(nodeMap, "OffsetY", 0, 0);
+
+	const int64_t whole = std::numeric_limits<int32_t>::max();
+	const int64_t width = settings.width > 0 ? settings.width :
+		getIntegerNode(nodeMap, "WidthMax", whole) - settings.offsetX;
+	const int64_t height = settings.height > 0 ? settings.height :
+		getIntegerNode(nodeMap, "HeightMax", whole) - settings.offsetY;
+	roi.width = int32_t(setIntegerNode(nodeMap, "Width", width, 0));
+	roi.height = int32_t(setIntegerNode(nodeMap, "Height", height, 0));
+	roi.offsetX = int32_t(setIntegerNode(nodeMap, "OffsetX", settings.offsetX, 0));
+	roi.offsetY = int32_t(setIntegerNode(nodeMap, "OffsetY", settings.offsetY, 0));
+	return roi;
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <stdint.h>
+#include "ArenaApi.h"
+
+// The part of the sensor the camera sends. Binning and decimation are done
+// first, on the camera, and the window is in the pixels that come out of
+// them, the way the GenICam OffsetX, OffsetY, Width and Height are.
+struct CameraRoiSettings
+{
+	// 1 is off. Binning averages the pixels, decimation skips them.
+	int32_t		binning = 1;
+	int32_t		decimation = 1;
+
+	int32_t		offsetX = 0;
+	int32_t		offsetY = 0;
+	// 0 for the rest of the sensor from the offset on
+	int32_t		width = 0;
+	int32_t		height = 0;
+
+	bool		operator==(const CameraRoiSettings& other) const
+				{
+					return binning == other.binning && decimation == other.decimation &&
+						offsetX == other.offsetX && offsetY == other.offsetY &&
+						width == other.width && height == other.height;
+				}
+	bool		operator!=(const CameraRoiSettings& other) const { return !(*this == other); }
+};
+
+// What a camera ended up with. The camera rounds the window to its own
+// increments, and leaves out what it doesn't have, such as decimation.
+struct CameraRoi
+{
+	int32_t		binning = 1;
+	int32_t		decimation = 1;
+	int32_t		offsetX = 0;
+	int32_t		offsetY = 0;
+	int32_t		width = 0;
+	int32_t		height = 0;
+
+	// Sensor pixels per image pixel, both ways
+	int32_t		factor() const { return binning * decimation; }
+};
+
+// Reads the camera's current window
+CameraRoi		readCameraRoi(GenApi::INodeMap* nodeMap);
+
+// Programs the settings into the camera, clamped to what it allows, and
+// returns what it ended up with. Width and Height are locked while the
+// camera streams, so the stream has to be stopped around this. Throws
+// GenICam::GenericException if the camera refuses a value.
+CameraRoi		applyCameraRoi(GenApi::INodeMap* nodeMap, const CameraRoiSettings& settings);
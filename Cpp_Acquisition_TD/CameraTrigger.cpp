@@ -0,0 +1,192 @@
+#include "stdafx.h"
+#include "CameraTrigger.h"
+#include "CameraNodes.h"
+#include <algorithm>
+
+// How much of each new measurement goes into the smoothed ones
+static const double SmoothingRate = 0.1;
+
+// TriggerArmed is polled this often, and for at most this long
+static const auto ArmedPoll = std::chrono::microseconds(100);
+static const auto ArmedTimeout = std::chrono::milliseconds(50);
+
+// A slot is never shorter than this, so a sequence of cameras that can't be
+// triggered doesn't spin
+static const double MinSlotLength = 0.0001;
+
+void
+applyTriggerMode(GenApi::INodeMap* nodeMap, TriggerMode mode)
+{
+	// Each frame is triggered by itself, rather than a burst or a sequence
+	setEnumerationNode(nodeMap, "TriggerSelector", "FrameStart");
+	if (mode != TriggerMode::FreeRun)
+	{
+		setEnumerationNode(nodeMap, "TriggerSource", "Software");
+		setEnumerationNode(nodeMap, "TriggerMode", "On");
+	}
+	else
+	{
+		setEnumerationNode(nodeMap, "TriggerMode", "Off");
+	}
+}
+
+void
+SoftwareTrigger::open(GenApi::INodeMap* nodeMap)
+{
+	myArmed = nodeMap->GetNode("TriggerArmed");
+	myTrigger = nodeMap->GetNode("TriggerSoftware");
+}
+
+bool
+SoftwareTrigger::fire()
+{
+	if (!myTrigger || !GenApi::IsWritable(myTrigger))
+		return false;
+
+	// Cameras without TriggerArmed take a trigger whenever they can
+	if (myArmed && GenApi::IsReadable(myArmed))
+	{
+		const auto giveUp = std::chrono::steady_clock::now() + ArmedTimeout;
+		while (!myArmed->GetValue())
+		{
+			if (std::chrono::steady_clock::now() > giveUp)
+				return false;
+			std::this_thread::sleep_for(ArmedPoll);
+		}
+	}
+	myTrigger->Execute();
+	return true;
+}
+
+double
+planTriggerSlots(const std::vector<double>& illumination, double guard, std::vector<TriggerSlot>* slots)
+{
+	slots->resize(illumination.size());
+	double offset = 0.0;
+	for (size_t i = 0; i < illumination.size(); i++)
+	{
+		TriggerSlot& slot = (*slots)[i];
+		slot.offset = offset;
+		slot.length = std::max(illumination[i] + guard, MinSlotLength);
+		offset += slot.length;
+	}
+	return offset;
+}
+
+TriggerSequencer::TriggerSequencer() :
+	myStop(false)
+{
+}
+
+TriggerSequencer::~TriggerSequencer()
+{
+	stop();
+}
+
+void
+TriggerSequencer::start(const std::vector<SoftwareTrigger*>& triggers, const std::vector<TriggerSlot>& slots)
+{
+	stop();
+	myTriggers = triggers;
+	mySlots = slots;
+	myStop = false;
+	myThread = std::thread([this]() { run(); });
+}
+
+void
+TriggerSequencer::stop()
+{
+	if (!myThread.joinable())
+		return;
+	myStop = true;
+	myThread.join();
+}
+
+void
+TriggerSequencer::run()
+{
+	typedef std::chrono::steady_clock Clock;
+
+	// When the light of the camera fired last is off again
+	Clock::time_point dark = Clock::now();
+	while (!myStop)
+	{
+		// The next cycle starts as soon as the last one is done, which
+		// gets the most frames out of the cameras together
+		const Clock::time_point cycleStart = dark;
+		for (size_t i = 0; i < myTriggers.size() && !myStop; i++)
+		{
+			const TriggerSlot& slot = mySlots[i];
+			const auto offset = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(slot.offset));
+			std::this_thread::sleep_until(std::max(cycleStart + offset, dark));
+
+			try
+			{
+				myTriggers[i]->fire();
+			}
+			catch (GenICam::GenericException&)
+			{
+				// The frame is missed, which the camera's frame rate shows
+			}
+			dark = Clock::now() + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(slot.length));
+		}
+	}
+}
+
+TriggerScheduler::TriggerScheduler()
+{
+	reset();
+}
+
+void
+TriggerScheduler::reset()
+{
+	myFired = Clock::time_point();
+	myArrived = Clock::time_point();
+	myLatency = 0.0;
+	myProcessing = 0.0;
+	myHasLatency = false;
+	myHasProcessing = false;
+}
+
+TriggerScheduler::Clock::time_point
+TriggerScheduler::fireTime(Clock::time_point lastCook, double cookPeriod, double margin) const
+{
+	// Without a cook rate yet there's nothing to aim for
+	if (cookPeriod <= 0.0)
+		return Clock::now();
+
+	const double lead = myLatency + myProcessing + margin;
+	const auto nextCook = lastCook + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(cookPeriod));
+	return nextCook - std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(lead));
+}
+
+static void
+smooth(double* value, bool* has, double sample)
+{
+	*value = *has ? *value + (sample - *value) * SmoothingRate : sample;
+	*has = true;
+}
+
+void
+TriggerScheduler::fired(Clock::time_point time)
+{
+	myFired = time;
+}
+
+void
+TriggerScheduler::arrived(Clock::time_point time)
+{
+	myArrived = time;
+	if (myFired != Clock::time_point())
+		smooth(&myLatency, &myHasLatency, std::chrono::duration<double>(time - myFired).count());
+}
+
+void
+TriggerScheduler::completed(Clock::time_point time)
+{
+	if (myArrived != Clock::time_point())
+		smooth(&myProcessing, &myHasProcessing, std::chrono::duration<double>(time - myArrived).count());
+	myFired = Clock::time_point();
+	myArrived = Clock::time_point();
+}
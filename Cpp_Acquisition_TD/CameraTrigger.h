@@ -0,0 +1,114 @@
+#pragma once
+
+#include <chrono>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include "ArenaApi.h"
+
+// How the cameras decide when to take a frame
+enum class TriggerMode
+{
+	// The camera runs at its own rate, and each cook takes the newest frame.
+	// The stream only keeps that one, see applyTransport.
+	FreeRun,
+	// A frame is triggered for every cook, timed to arrive just before the
+	// next one
+	Software,
+	// The cameras are triggered one after the other, as fast as they go,
+	// each in a slot of its own so their light doesn't interfere. Only the
+	// cameras that are read take part, see Cpp_Acquisition::updateSlots.
+	Multiplexed,
+};
+
+// Turns triggering on or off, Multiplexed triggers by software as well.
+// The stream has to be stopped around this, so no frame taken the other
+// way is left in its buffers. Throws GenICam::GenericException if the
+// camera refuses a value.
+void			applyTriggerMode(GenApi::INodeMap* nodeMap, TriggerMode mode);
+
+// Fires a camera's software trigger, with the nodes looked up once
+class SoftwareTrigger
+{
+public:
+	void		open(GenApi::INodeMap* nodeMap);
+
+	// Waits until the camera is ready for a trigger, for a few frames at
+	// most, and then fires it. Returns false if it never got ready.
+	bool		fire();
+
+private:
+	GenApi::CBooleanPtr		myArmed;
+	GenApi::CCommandPtr		myTrigger;
+};
+
+// When a camera is fired within a trigger cycle, in seconds from its start
+struct TriggerSlot
+{
+	double		offset = 0.0;
+	double		length = 0.0;
+};
+
+// Lays the cameras' slots out back to back, each as long as the camera
+// lights the scene plus the guard, and returns how long the whole cycle is
+double			planTriggerSlots(const std::vector<double>& illumination, double guard,
+					std::vector<TriggerSlot>* slots);
+
+// Fires the triggers of several cameras in their slots, over and over, on
+// a thread of its own. A camera that's late to arm pushes the ones after
+// it back rather than overlapping them.
+class TriggerSequencer
+{
+public:
+	TriggerSequencer();
+	~TriggerSequencer();
+
+	// The triggers have to outlive the sequence, or stop() has to be
+	// called first
+	void		start(const std::vector<SoftwareTrigger*>& triggers, const std::vector<TriggerSlot>& slots);
+	void		stop();
+
+private:
+	void		run();
+
+	std::vector<SoftwareTrigger*>	myTriggers;
+	std::vector<TriggerSlot>	mySlots;
+	std::thread		myThread;
+	std::atomic<bool>	myStop;
+};
+
+// Works out when to fire the triggers, so the frame is converted and in the
+// output just before the next cook. Learns how long the camera takes to
+// deliver a triggered frame and how long the conversion takes, and fires
+// that much plus a margin ahead of the cook.
+class TriggerScheduler
+{
+public:
+	typedef std::chrono::steady_clock	Clock;
+
+	TriggerScheduler();
+
+	// Forget what was learned, after the cameras changed
+	void		reset();
+
+	// When to fire for the cook after lastCook, given how far apart the
+	// cooks are. May be in the past, then it's now.
+	Clock::time_point	fireTime(Clock::time_point lastCook, double cookPeriod, double margin) const;
+
+	// Report the steps of a frame as they happen
+	void		fired(Clock::time_point time);
+	void		arrived(Clock::time_point time);
+	void		completed(Clock::time_point time);
+
+	// Seconds from trigger to image, and from image to output, smoothed
+	double		latency() const { return myLatency; }
+	double		processing() const { return myProcessing; }
+
+private:
+	Clock::time_point	myFired;
+	Clock::time_point	myArrived;
+	double		myLatency;
+	double		myProcessing;
+	bool		myHasLatency;
+	bool		myHasProcessing;
+};
@@ -0,0 +1,281 @@
+#include "stdafx.h"
+#include "Colormap.h"
+#include "FileIo.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <cmath>
+
+bool
+ColorStop::operator==(const ColorStop& other) const
+{
+	return position == other.position && color[0] == other.color[0] && color[1] == other.color[1] &&
+		color[2] == other.color[2] && color[3] == other.color[3];
+}
+
+bool
+ColormapSettings::operator==(const ColormapSettings& other) const
+{
+	if (type != other.type)
+		return false;
+	// The stops only matter while they're in use
+	return type != ColormapType::Custom || stops == other.stops;
+}
+
+bool
+parseColorStop(const char* const* cells, int numCells, ColorStop* stop)
+{
+	if (numCells < 4)
+		return false;
+
+	float values[5] = { 0.0f, 0.0f, 0.0f, 0.0f, 1.0f };
+	for (int i = 0; i < std::min(numCells, 5); i++)
+	{
+		const char* cell = cells[i];
+		char* end = nullptr;
+		values[i] = float(strtod(cell, &end));
+		if (end == cell)
+		{
+			// An empty alpha is fine, anything else that isn't a number
+			// means this isn't a stop
+			if (i < 4)
+				return false;
+			values[i] = 1.0f;
+		}
+	}
+
+	stop->position = values[0];
+	for (int c = 0; c < 4; c++)
+		stop->color[c] = values[c + 1];
+	return true;
+}
+
+bool
+loadColorStops(const char* path, std::vector<ColorStop>* stops)
+{
+	FILE* file = openFile(path, "r");
+	if (!file)
+		return false;
+
+	std::vector<ColorStop> result;
+	bool ok = true;
+	char line[1024];
+	while (ok && fgets(line, sizeof(line), file))
+	{
+		const char* p = line;
+		while (*p == ' ' || *p == '\t')
+			p++;
+		if (*p == '#' || *p == '\n' || *p == '\r' || *p == '\0')
+			continue;
+
+		// Split on whitespace into at most 5 cells
+		char cells[5][64];
+		const char* cellPointers[5];
+		int numCells = 0;
+		while (*p && *p != '\n' && *p != '\r' && numCells < 5)
+		{
+			size_t n = 0;
+			while (*p && *p != ' ' && *p != '\t' && *p != '\n' && *p != '\r')
+			{
+				if (n < sizeof(cells[0]) - 1)
+					cells[numCells][n++] = *p;
+				p++;
+			}
+			cells[numCells][n] = '\0';
+			cellPointers[numCells] = cells[numCells];
+			numCells++;
+			while (*p == ' ' || *p == '\t')
+				p++;
+		}
+
+		ColorStop stop;
+		ok = parseColorStop(cellPointers, numCells, &stop);
+		if (ok)
+			result.push_back(stop);
+	}
+	fclose(file);
+
+	if (!ok)
+		return false;
+	*stops = result;
+	return true;
+}
+
+// The colors depthToColor has always used. Each quarter is scaled by the
+// yellow border, as it always was.
+static void
+classicColor(int32_t z, double start, double end, float* pixel)
+{
+	const double yellow = start + (end - start) / 4;
+	const double green = start + ((end - start) / 4) * 2;
+	const double cyan = start + ((end - start) / 4) * 3;
+
+	double r = 0.0;
+	double g = 0.0;
+	double b = 0.0;
+	if (z <= yellow)
+	{
+		r = 1.0;
+		g = (z - start) / yellow;
+	}
+	else if (z <= green)
+	{
+		r = 1.0 - (z - yellow) / yellow;
+		g = 1.0;
+	}
+	else if (z <= cyan)
+	{
+		g = 1.0;
+		b = (z - green) / yellow;
+	}
+	else
+	{
+		g = 1.0 - (z - cyan) / yellow;
+		b = 1.0;
+	}
+
+	pixel[0] = float(r);
+	pixel[1] = float(g);
+	pixel[2] = float(b);
+	pixel[3] = 1.0f;
+}
+
+static float
+saturate(double v)
+{
+	return float(std::min(1.0, std::max(0.0, v)));
+}
+
+// Polynomial fits of Google's Turbo and of matplotlib's viridis, within a
+// percent or so of the published tables
+static void
+turboColor(double t, float* pixel)
+{
+	pixel[0] = saturate(0.13572138 + t * (4.61539260 + t * (-42.66032258 + t * (132.13108234 + t * (-152.94239396 + t * 59.28637943)))));
+	pixel[1] = saturate(0.09140261 + t * (2.19418839 + t * (4.84296658 + t * (-14.18503333 + t * (4.27729857 + t * 2.82956604)))));
+	pixel[2] = saturate(0.10667330 + t * (12.64194608 + t * (-60.58204836 + t * (110.36276771 + t * (-89.90310912 + t * 27.34824973)))));
+	pixel[3] = 1.0f;
+}
+
+static void
+viridisColor(double t, float* pixel)
+{
+	static const double c[7][3] =
+	{
+		{ 0.2777273272234177, 0.005407344544966578, 0.3340998053353061 },
+		{ 0.1050930431085774, 1.404613529898575, 1.384590162594685 },
+		{ -0.3308618287255563, 0.214847559468213, 0.09509516302823659 },
+		{ -4.634230498983486, -5.799100973351585, -19.33244095627987 },
+		{ 6.228269936347081, 14.17993336680509, 56.69055260068105 },
+		{ 4.776384997670288, -13.74514537774601, -65.35303263337234 },
+		{ -5.435455855934631, 4.645852612178535, 26.3124352495832 },
+	};
+	for (int channel = 0; channel < 3; channel++)
+	{
+		double v = c[6][channel];
+		for (int i = 5; i >= 0; i--)
+			v = c[i][channel] + t * v;
+		pixel[channel] = saturate(v);
+	}
+	pixel[3] = 1.0f;
+}
+
+// Stops sorted by position, at least one
+static void
+gradientColor(const std::vector<ColorStop>& stops, double t, float* pixel)
+{
+	size_t next = 0;
+	while (next < stops.size() && stops[next].position < t)
+		next++;
+
+	if (next == 0 || next == stops.size())
+	{
+		const ColorStop& stop = stops[next == 0 ? 0 : stops.size() - 1];
+		std::copy(stop.color, stop.color + 4, pixel);
+		return;
+	}
+
+	const ColorStop& a = stops[next - 1];
+	const ColorStop& b = stops[next];
+	const double span = double(b.position) - double(a.position);
+	const double f = span > 0.0 ? (t - a.position) / span : 1.0;
+	for (int c = 0; c < 4; c++)
+		pixel[c] = float(a.color[c] + (b.color[c] - a.color[c]) * f);
+}
+
+DepthColormap::DepthColormap() :
+	myStart(0.0),
+	myEnd(0.0),
+	myValid(false),
+	myFirst(0),
+	myCount(0)
+{
+	myOutside[0] = 0.0f;
+	myOutside[1] = 0.0f;
+	myOutside[2] = 0.0f;
+	myOutside[3] = 1.0f;
+}
+
+void
+DepthColormap::update(const ColormapSettings& settings, double startDistance, double endDistance)
+{
+	if (myValid && settings == mySettings && startDistance == myStart && endDistance == myEnd)
+		return;
+
+	mySettings = settings;
+	myStart = startDistance;
+	myEnd = endDistance;
+	build();
+	myValid = true;
+}
+
+void
+DepthColormap::build()
+{
+	// Every whole mm from Near to Far, leaving out 0
+	const int32_t first = int32_t(std::min(32767.0, std::max(1.0, std::ceil(myStart))));
+	const int32_t last = int32_t(std::min(32767.0, std::max(0.0, std::floor(myEnd))));
+	myFirst = first;
+	myCount = last >= first ? uint32_t(last - first + 1) : 0;
+	myTable.resize(4 * size_t(myCount));
+
+	std::vector<ColorStop> stops = mySettings.stops;
+	std::stable_sort(stops.begin(), stops.end(),
+		[](const ColorStop& a, const ColorStop& b) { return a.position < b.position; });
+	ColormapType type = mySettings.type;
+	if (type == ColormapType::Custom && stops.empty())
+		type = ColormapType::Grayscale;
+
+	const double range = myEnd - myStart;
+	for (uint32_t i = 0; i < myCount; i++)
+	{
+		const int32_t z = first + int32_t(i);
+		const double t = range > 0.0 ? (z - myStart) / range : 0.0;
+		float* pixel = &myTable[4 * size_t(i)];
+		switch (type)
+		{
+			case ColormapType::Classic:
+				classicColor(z, myStart, myEnd, pixel);
+				break;
+			case ColormapType::Grayscale:
+			case ColormapType::InvertedGrayscale:
+			{
+				const float v = float(type == ColormapType::Grayscale ? t : 1.0 - t);
+				pixel[0] = v;
+				pixel[1] = v;
+				pixel[2] = v;
+				pixel[3] = 1.0f;
+				break;
+			}
+			case ColormapType::Turbo:
+				turboColor(t, pixel);
+				break;
+			case ColormapType::Viridis:
+				viridisColor(t, pixel);
+				break;
+			case ColormapType::Custom:
+				gradientColor(stops, t, pixel);
+				break;
+		}
+	}
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+#include "AlignedBuffer.h"
+
+enum class ColormapType : int32_t
+{
+	// Red at Near through yellow, green and cyan to blue at Far
+	Classic = 0,
+	// Black at Near to white at Far
+	Grayscale,
+	// White at Near to black at Far
+	InvertedGrayscale,
+	Turbo,
+	Viridis,
+	// The ColormapSettings' stops
+	Custom,
+};
+
+// A point of a custom gradient, position 0 at Near to 1 at Far
+struct ColorStop
+{
+	float		position = 0.0f;
+	float		color[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
+
+	bool		operator==(const ColorStop& other) const;
+};
+
+struct ColormapSettings
+{
+	ColormapType			type = ColormapType::Classic;
+	// Only used by Custom, in any order. Without any stops Custom is
+	// grayscale.
+	std::vector<ColorStop>	stops;
+
+	bool		operator==(const ColormapSettings& other) const;
+	bool		operator!=(const ColormapSettings& other) const { return !(*this == other); }
+};
+
+// Reads a stop from the cells of one row: position, r, g, b and optionally
+// a. Returns false if the row isn't a stop, such as a header row.
+bool		parseColorStop(const char* const* cells, int numCells, ColorStop* stop);
+
+// Plain text, one stop per line in the same columns as parseColorStop.
+// Empty lines and lines starting with # are skipped.
+bool		loadColorStops(const char* path, std::vector<ColorStop>* stops);
+
+// A colormap compiled for one Near/Far range into a table with the RGBA of
+// every depth (mm) in it, so coloring a pixel is a bounds check and a copy
+// whatever the colormap is. update() only rebuilds the table when the
+// colormap or the range change.
+//
+// Depths outside the range are black, and so is 0, which means no depth.
+class DepthColormap
+{
+public:
+	DepthColormap();
+
+	void		update(const ColormapSettings& settings, double startDistance, double endDistance);
+
+	// The RGBA of depth z (mm)
+	const float*
+	lookup(int16_t z) const
+	{
+		const uint32_t i = uint32_t(int32_t(z) - myFirst);
+		return i < myCount ? &myTable[4 * size_t(i)] : myOutside;
+	}
+
+	// Writes the RGBA of depth z (mm)
+	void
+	color(int16_t z, float* pixel) const
+	{
+		const float* c = lookup(z);
+		pixel[0] = c[0];
+		pixel[1] = c[1];
+		pixel[2] = c[2];
+		pixel[3] = c[3];
+	}
+
+private:
+	void		build();
+
+	ColormapSettings		mySettings;
+	double					myStart;
+	double					myEnd;
+	bool					myValid;
+
+	// The table starts at depth myFirst and has myCount entries
+	int32_t					myFirst;
+	uint32_t				myCount;
+	AlignedBuffer<float>	myTable;
+	float					myOutside[4];
+};
@@ -22,6 +22,8 @@
 #include <cmath>
 #include <random>
 #include <chrono>
+#include <utility>
+#include <thread>
 
  // Uncomment this if you want to run an example that fills the data using threading
  //#define THREADING_EXAMPLE
@@ -102,12 +104,27 @@ FillTOPPluginInfo(TOP_PluginInfo* info)
 
 Cpp_Acquisition::Cpp_Acquisition(const OP_NodeInfo* info) :
 	myNodeInfo(info),
+	myRigVersion(0),
+	myResetPipeline(false),
+	myLearnBackground(false),
+	myCalibrateFloor(false),
 	myThread(nullptr),
 	myThreadShouldExit(false),
 	myStartWork(false)
 {
 	myExecuteCount = 0;
 	myStep = 0.0;
+	myPublishedPoints = 0;
+	myInfoPoints = 0;
+	myPublishedStartDistance = 0.0;
+	myPublishedEndDistance = 0.0;
+	myInfoStartDistance = 0.0;
+	myInfoEndDistance = 0.0;
+	// Until there's a camera to follow
+	myImageWidth = 640;
+	myImageHeight = 480;
+
+	pImage = nullptr;
 
 	std::cout << "Hi Touch\n";
 
@@ -116,22 +133,38 @@ Cpp_Acquisition::Cpp_Acquisition(const OP_NodeInfo* info) :
 	pSystem->UpdateDevices(100);
 	std::vector<Arena::DeviceInfo> deviceInfos = pSystem->GetDevices();
 
-	numDevices = deviceInfos.size();
+	const size_t numDevices = deviceInfos.size();
 	if (numDevices > 0)
 	{
 		std::cout << "We have " << numDevices << " device\n";
-		pDevice = pSystem->CreateDevice(deviceInfos[0]);
-		pDevice->StartStream();
+		for (const Arena::DeviceInfo& deviceInfo : deviceInfos)
+		{
+			std::unique_ptr<RigCamera> camera(new RigCamera);
+			camera->serial = deviceInfo.SerialNumber().c_str();
+			camera->device = pSystem->CreateDevice(deviceInfo);
+			camera->device->StartStream();
+
+			GenApi::INodeMap* pNodeMap = camera->device->GetNodeMap();
+			camera->control.open(pNodeMap);
+			camera->trigger.open(pNodeMap);
+			camera->coordinates = camera->control.coordinates();
+			camera->roi = readCameraRoi(pNodeMap);
 
-		GenApi::INodeMap* pNodeMap = pDevice->GetNodeMap();
-		coordinateScale = static_cast<float>(Arena::GetNodeValue<double>(pNodeMap, "Scan3dCoordinateScale"));
+			camera->pipeline.setLearnInBackground(true);
 
-		std::cout << "Stream started\n";
+			std::cout << "Stream started on " << camera->serial << "\n";
+			myCameras.push_back(std::move(camera));
+		}
 	}
 	else {
 		std::cout << "We dont have a device\n";
 	}
 
+	if (!myCameras.empty())
+	{
+		myImageWidth = size_t(myCameras[0]->roi.width);
+		myImageHeight = size_t(myCameras[0]->roi.height);
+	}
 }
 
 Cpp_Acquisition::~Cpp_Acquisition()
@@ -149,11 +182,18 @@ Cpp_Acquisition::~Cpp_Acquisition()
 		}
 		delete myThread;
 	}
+	mySequencer.stop();
+
+	closeRecording();
 
-	std::cout << "Stopping stream\n";
-	pDevice->StopStream();
-	std::cout << "Destroying device\n";
-	pSystem->DestroyDevice(pDevice);
+	for (auto& camera : myCameras)
+	{
+		std::cout << "Stopping stream\n";
+		camera->device->StopStream();
+		std::cout << "Destroying device\n";
+		pSystem->DestroyDevice(camera->device);
+	}
+	myCameras.clear();
 	std::cout << "Closing the system\n";
 	Arena::CloseSystem(pSystem);
 	std::cout << "--- Houdoe!!\n";
@@ -173,12 +213,48 @@ Cpp_Acquisition::getOutputFormat(TOP_OutputFormat* format, const OP_Inputs* inpu
 	// the pixel format/resolution etc that we want to output to.
 	// If we did that, we'd want to return true to tell the TOP to use the settings we've
 	// specified.
-	// In this example we'll return false and use the TOP's settings
-	format->width = 640;
-	format->height = 480;
-	return format;
+	// We follow the primary camera's resolution, scaled and turned as the
+	// parameters ask
+	DepthSettings settings;
+	settings.output = (DepthOutputMode)inputs->getParInt("Outputmode");
+	inputs->getParInt2("Heightmapres", settings.heightmap.width, settings.heightmap.height);
+	settings.resample.resolution = (OutputResolution)inputs->getParInt("Outputresolution");
+	inputs->getParInt2("Outputsize", settings.resample.width, settings.resample.height);
+	settings.remap.orientation = (RemapOrientation)inputs->getParInt("Orientation");
+
+	myBlobLock.lock();
+	const size_t cameraWidth = myImageWidth;
+	const size_t cameraHeight = myImageHeight;
+	myBlobLock.unlock();
+
+	size_t width;
+	size_t height;
+	settings.outputSize(cameraWidth, cameraHeight, &width, &height);
+	format->width = int32_t(width);
+	format->height = int32_t(height);
+	return true;
 }
 
+// Reads the Custom colormap's stops from the rows of a DAT, skipping any
+// that aren't numbers such as a header
+static void
+readColorStops(const OP_DATInput* dat, std::vector<ColorStop>* stops)
+{
+	if (!dat || !dat->isTable)
+		return;
+
+	const int32_t numCells = std::min(dat->numCols, 5);
+	for (int32_t row = 0; row < dat->numRows; row++)
+	{
+		const char* cells[5];
+		for (int32_t col = 0; col < numCells; col++)
+			cells[col] = dat->getCell(row, col);
+
+		ColorStop stop;
+		if (parseColorStop(cells, numCells, &stop))
+			stops->push_back(stop);
+	}
+}
 
 void
 Cpp_Acquisition::execute(TOP_OutputFormatSpecs* output,
@@ -189,27 +265,170 @@ Cpp_Acquisition::execute(TOP_OutputFormatSpecs* output,
 
 	// if (myExecuteCount % 100 == 0) {
 
+	const auto cookTime = TriggerScheduler::Clock::now();
+
 	// Lock the settings to make sure only this thread can access it
 	mySettingsLock.lock();
-	const double startDistance = inputs->getParDouble("Near");
-	myStartDistance = startDistance;
-	const double endDistance = inputs->getParDouble("Far");
-	myEndDistance = endDistance;
+	if (myLastCook != TriggerScheduler::Clock::time_point())
+	{
+		const double period = std::chrono::duration<double>(cookTime - myLastCook).count();
+		myCookPeriod = myCookPeriod > 0.0 ? myCookPeriod + (period - myCookPeriod) * 0.1 : period;
+	}
+	myLastCook = cookTime;
+	mySettings.startDistance = inputs->getParDouble("Near");
+	mySettings.endDistance = inputs->getParDouble("Far");
+	mySettings.autoRange.enabled = inputs->getParInt("Autorange") != 0;
+	inputs->getParDouble2("Autorangepercentiles", mySettings.autoRange.nearPercentile, mySettings.autoRange.farPercentile);
+	mySettings.autoRange.rate = inputs->getParDouble("Autorangerate");
+	mySettings.autoRange.hysteresis = inputs->getParDouble("Autorangehysteresis");
+	mySettings.colormap.type = (ColormapType)inputs->getParInt("Colormap");
+	mySettings.colormap.stops.clear();
+	if (mySettings.colormap.type == ColormapType::Custom)
+		readColorStops(inputs->getParDAT("Colormapdat"), &mySettings.colormap.stops);
+	mySettings.validity.minIntensity = inputs->getParInt("Minintensity");
+	mySettings.validity.flyingThreshold = inputs->getParInt("Flyingpixels");
+	mySettings.holes.mode = (HoleFillMode)inputs->getParInt("Holefill");
+	mySettings.holes.maxSize = inputs->getParInt("Holesize");
+	mySettings.spatial.mode = (SpatialFilterMode)inputs->getParInt("Spatialfilter");
+	mySettings.spatial.rangeSigma = inputs->getParDouble("Bilateralrange");
+	mySettings.temporal.mode = (TemporalFilterMode)inputs->getParInt("Temporalfilter");
+	mySettings.temporal.alpha = inputs->getParDouble("Temporalweight");
+	mySettings.temporal.resetThreshold = inputs->getParInt("Temporalreset");
+	mySettings.temporal.medianFrames = inputs->getParInt("Medianframes") == 1 ? 5 : 3;
+	mySettings.output = (DepthOutputMode)inputs->getParInt("Outputmode");
+	mySettings.resample.resolution = (OutputResolution)inputs->getParInt("Outputresolution");
+	inputs->getParInt2("Outputsize", mySettings.resample.width, mySettings.resample.height);
+	mySettings.resample.filter = (ResampleFilter)inputs->getParInt("Resample");
+	inputs->getParInt2("Heightmapres", mySettings.heightmap.width, mySettings.heightmap.height);
+	inputs->getParDouble2("Heightmapcenter", mySettings.heightmap.centerX, mySettings.heightmap.centerY);
+	inputs->getParDouble2("Heightmapsize", mySettings.heightmap.sizeX, mySettings.heightmap.sizeY);
+	RemapSettings& remap = mySettings.remap;
+	remap.orientation = (RemapOrientation)inputs->getParInt("Orientation");
+	inputs->getParDouble2("Cornerpinbl", remap.corners[0], remap.corners[1]);
+	inputs->getParDouble2("Cornerpinbr", remap.corners[2], remap.corners[3]);
+	inputs->getParDouble2("Cornerpintl", remap.corners[4], remap.corners[5]);
+	inputs->getParDouble2("Cornerpintr", remap.corners[6], remap.corners[7]);
+	remap.undistort = inputs->getParInt("Undistort") != 0;
+	inputs->getParDouble2("Lensfocal", remap.focalX, remap.focalY);
+	inputs->getParDouble2("Lenscenter", remap.centerX, remap.centerY);
+	inputs->getParDouble3("Lensradial", remap.radial[0], remap.radial[1], remap.radial[2]);
+	inputs->getParDouble2("Lenstangential", remap.tangential[0], remap.tangential[1]);
+	mySettings.background.learnRate = inputs->getParDouble("Learnrate");
+	mySettings.background.learnFrames = inputs->getParInt("Learnframes");
+	mySettings.background.minDistance = inputs->getParInt("Foregrounddistance");
+	mySettings.background.deviations = inputs->getParDouble("Foregroundnoise");
+	mySettings.blobs.source = (BlobSource)inputs->getParInt("Blobsource");
+	mySettings.blobs.minArea = inputs->getParInt("Blobminarea");
+	mySettings.blobs.maxBlobs = inputs->getParInt("Blobmax");
+	mySettings.tracking.enabled = inputs->getParInt("Track") != 0;
+	mySettings.tracking.assignment = (TrackAssignment)inputs->getParInt("Trackassign");
+	mySettings.tracking.gate = inputs->getParDouble("Trackgate");
+	mySettings.tracking.maxMissed = inputs->getParInt("Trackcoast");
+	mySettings.stats = inputs->getParInt("Depthstats") != 0;
+	mySettings.heightAboveFloor = inputs->getParInt("Heightmode") != 0;
+	const std::string floorPath = inputs->getParFilePath("Floorfile");
+	if (floorPath != myFloorPath)
+	{
+		// A different file, use the plane saved in it if there is one
+		myFloorPath = floorPath;
+		mySettings.floor = FloorPlane();
+		if (!myFloorPath.empty() && loadFloorPlane(myFloorPath.c_str(), &mySettings.floor))
+			std::cout << "Loaded floor plane from " << myFloorPath << "\n";
+	}
+	const std::string rigPath = inputs->getParFilePath("Rigfile");
+	if (rigPath != myRigPath)
+	{
+		myRigPath = rigPath;
+		myRigPoses.clear();
+		if (!myRigPath.empty())
+		{
+			if (loadCameraPoses(myRigPath.c_str(), &myRigPoses))
+				std::cout << "Loaded " << myRigPoses.size() << " camera poses from " << myRigPath << "\n";
+			else
+				std::cout << "Unable to read camera poses from " << myRigPath << "\n";
+		}
+		myRigVersion++;
+	}
+	myRecord = inputs->getParInt("Record") != 0;
+	myRecordPath = inputs->getParFilePath("Recordfile");
+	myRoi.binning = 1 << inputs->getParInt("Binning");
+	myRoi.decimation = 1 << inputs->getParInt("Decimation");
+	inputs->getParInt2("Roioffset", myRoi.offsetX, myRoi.offsetY);
+	inputs->getParInt2("Roisize", myRoi.width, myRoi.height);
+	myTransport.autoPacketSize = inputs->getParInt("Autopacketsize") != 0;
+	myTransport.packetSize = inputs->getParInt("Packetsize");
+	myTransport.packetDelay = inputs->getParInt("Packetdelay");
+	myTransport.packetResend = inputs->getParInt("Packetresend") != 0;
+	myTransport.bandwidthLimit = inputs->getParDouble("Bandwidthlimit");
+	myTransport.bandwidthReserve = inputs->getParInt("Bandwidthreserve");
+	myControl.range = (CameraRange)inputs->getParInt("Camerarange");
+	myControl.exposure = (CameraExposure)inputs->getParInt("Exposure");
+	myControl.gain = (CameraGain)inputs->getParInt("Conversiongain");
+	myControl.accumulation = inputs->getParInt("Accumulation");
+	myControl.spatialFilter = inputs->getParInt("Cameraspatialfilter") != 0;
+	myTriggerMode = (TriggerMode)inputs->getParInt("Acquisition");
+	myTriggerMargin = inputs->getParDouble("Triggermargin") / 1000.0;
+	mySlotGuard = inputs->getParDouble("Slotguard") / 1000.0;
+	myControl.ptp = inputs->getParInt("Ptp") != 0;
+	myFrameSet.align = inputs->getParInt("Alignframes") != 0;
+	myFrameSet.tolerance = inputs->getParDouble("Aligntolerance") / 1000.0;
+	myFrameSet.maxWait = inputs->getParDouble("Alignwait") / 1000.0;
 	// Unlock them again
 	mySettingsLock.unlock();
 
+	// Take the latest blobs for the Info CHOP/DAT, which are read after this
+	myBlobLock.lock();
+	myInfoBlobs = myPublishedBlobs;
+	myInfoPoints = myPublishedPoints;
+	myInfoStats = myPublishedStats;
+	myInfoStartDistance = myPublishedStartDistance;
+	myInfoEndDistance = myPublishedEndDistance;
+	myInfoTransport = myPublishedTransport;
+	myInfoLatency = myPublishedLatency;
+	myInfoSlots = myPublishedSlots;
+	myInfoCycle = myPublishedCycle;
+	myInfoOffsets = myPublishedOffsets;
+	myInfoSpread = myPublishedSpread;
+	myInfoDropped = myPublishedDropped;
+	myInfoSlack = myPublishedCompletion != TriggerScheduler::Clock::time_point() ?
+		std::chrono::duration<double>(cookTime - myPublishedCompletion).count() : 0.0;
+	myBlobLock.unlock();
+
 	// Sync the output
 	myFrameQueue.sync(output);
 
+	// In Triggered mode the thread waits for this to take the next frame
+	startMoreWork();
+
 	// Start a thread
-	if (!myThread)
+	if (!myThread && !myCameras.empty())
 	{
 		myThread = new std::thread(
 			[this]()
 			{
+				int rigVersion = -1;
+				std::vector<CameraPose> poses;
+				// Applied on the first frame, so a window or packet size left
+				// in the camera from before doesn't stick
+				bool streamsApplied = false;
+				CameraRoiSettings roi;
+				TransportSettings transport;
+				CameraControlSettings control;
+				TriggerMode trigger = TriggerMode::FreeRun;
+				double slotGuard = 0.0;
+				bool fused = false;
+
 				// Exit when our owner tells us to
 				while (!this->myThreadShouldExit)
 				{
+					// A triggered frame is taken once per cook
+					if (trigger == TriggerMode::Software)
+					{
+						waitForMoreWork();
+						if (this->myThreadShouldExit)
+							break;
+					}
+
 					int width, height;
 					void* buf = this->myFrameQueue.getBufferForUpdate(&width, &height);
 
@@ -217,11 +436,158 @@ Cpp_Acquisition::execute(TOP_OutputFormatSpecs* output,
 					if (buf)
 					{
 
-						pImage = pDevice->GetImage(imageTimeout);
-						size_t bitsPerPixel = pImage->GetBitsPerPixel();
-						Cpp_Acquisition::pImageToTop(pImage->GetData(), myStartDistance, myEndDistance, width, height, bitsPerPixel, coordinateScale, (float*)buf);
-
+						mySettingsLock.lock();
+						DepthSettings settings = mySettings;
+						const std::string recordPath = myRecordPath;
+						const bool record = myRecord;
+						const bool posesChanged = rigVersion != myRigVersion;
+						if (posesChanged)
+						{
+							rigVersion = myRigVersion;
+							poses = myRigPoses;
+						}
+						const bool streamsChanged = !streamsApplied || roi != myRoi || transport != myTransport ||
+							trigger != myTriggerMode;
+						// The slots follow from the cameras' settings
+						const bool slotsChanged = streamsChanged || control != myControl || slotGuard != mySlotGuard ||
+							fused != (settings.output == DepthOutputMode::Fused);
+						roi = myRoi;
+						transport = myTransport;
+						control = myControl;
+						trigger = myTriggerMode;
+						slotGuard = mySlotGuard;
+						fused = settings.output == DepthOutputMode::Fused;
+						const double triggerMargin = myTriggerMargin;
+						const FrameSetSettings frameSet = myFrameSet;
+						const auto lastCook = myLastCook;
+						const double cookPeriod = myCookPeriod;
+						mySettingsLock.unlock();
+
+						if (posesChanged)
+							updatePoses(poses);
+						if (slotsChanged)
+							mySequencer.stop();
+						if (streamsChanged)
+						{
+							updateStreams(roi, transport, trigger);
+							myTriggerScheduler.reset();
+							streamsApplied = true;
+						}
+						updateControls(control);
+						if (slotsChanged)
+							updateSlots(trigger, slotGuard, fused);
+
+						const bool reset = myResetPipeline.exchange(false);
+						const bool learn = myLearnBackground.exchange(false);
+						for (auto& camera : myCameras)
+						{
+							if (reset)
+								camera->pipeline.reset();
+							if (learn)
+								camera->pipeline.learnBackground();
+						}
+
+						RigCamera& primary = *myCameras[0];
+						if (myCalibrateFloor.exchange(false))
+							primary.pipeline.calibrateFloor();
+
+						// The lens is given for the whole sensor, this is where
+						// the image sits on it
+						const double factor = 1.0 / primary.roi.factor();
+						settings.remap = settings.remap.scaled(factor, factor).shifted(primary.roi.offsetX, primary.roi.offsetY);
+
+						for (auto& camera : myCameras)
+							camera->fired = true;
+						if (trigger == TriggerMode::Software)
+						{
+							std::this_thread::sleep_until(myTriggerScheduler.fireTime(lastCook, cookPeriod, triggerMargin));
+							// Only the Fused output reads the other cameras, as in
+							// updateSlots. Their frames would pile up unread otherwise.
+							const size_t count = settings.output == DepthOutputMode::Fused ? myCameras.size() : 1;
+							for (size_t i = 0; i < count; i++)
+							{
+								RigCamera* camera = myCameras[i].get();
+								try
+								{
+									camera->fired = camera->trigger.fire();
+									if (!camera->fired)
+										std::cout << camera->serial << " wasn't ready for a trigger\n";
+								}
+								catch (GenICam::GenericException& e)
+								{
+									std::cout << "Unable to trigger " << camera->serial << ": " << e.what() << "\n";
+									camera->fired = false;
+								}
+							}
+							myTriggerScheduler.fired(TriggerScheduler::Clock::now());
+
+							// No frame is coming from the primary camera, so there's
+							// nothing to output. The buffer waits for the next cook.
+							if (!primary.fired)
+							{
+								this->myFrameQueue.updateCancelled();
+								continue;
+							}
+						}
+
+						if (settings.output == DepthOutputMode::Fused)
+						{
+							fuseCameras(settings, frameSet, recordPath, record, (float*)buf, width, height);
+						}
+						else
+						{
+							primary.pipeline.setWorkerPool(&myWorkers);
+							pImage = takeImage(primary);
+							if (!pImage)
+							{
+								this->myFrameQueue.updateCancelled();
+								continue;
+							}
+							myTriggerScheduler.arrived(TriggerScheduler::Clock::now());
+							primary.transport.addFrame(primary.device, pImage->GetSizeFilled());
+							size_t bitsPerPixel = pImage->GetBitsPerPixel();
+
+							recordFrame(recordPath, record);
+
+							Cpp_Acquisition::pImageToTop(pImage->GetData(), settings, pImage->GetWidth(), pImage->GetHeight(),
+								bitsPerPixel, primary.coordinates, (float*)buf, width, height);
+							primary.device->RequeueBuffer(pImage);
+						}
+
+						myBlobLock.lock();
+						myPublishedBlobs = primary.pipeline.blobs();
+						myPublishedPoints = primary.pipeline.pointCount();
+						myPublishedStats = settings.stats ? primary.pipeline.stats() : DepthStats();
+						myPublishedStartDistance = primary.pipeline.startDistance();
+						myPublishedEndDistance = primary.pipeline.endDistance();
+						myPublishedTransport.resize(myCameras.size());
+						for (size_t i = 0; i < myCameras.size(); i++)
+							myPublishedTransport[i] = myCameras[i]->transport.stats();
+						const bool aligned = settings.output == DepthOutputMode::Fused && frameSet.align;
+						myPublishedOffsets = aligned ? myFrameSets.offsets() : std::vector<double>();
+						myPublishedSpread = aligned ? myFrameSets.spread() : 0.0;
+						myPublishedDropped = aligned ? myFrameSets.dropped() : 0;
+						myBlobLock.unlock();
+
+						FloorPlane floor;
+						if (primary.pipeline.takeFloorPlane(&floor))
+							updateFloor(floor);
+
+						// The kernels stream into the buffer. The workers fence their
+						// own stores, this covers anything streamed from this thread,
+						// before TouchDesigner gets to upload it.
+						writeFence();
 						this->myFrameQueue.updateComplete();
+
+						const auto completion = TriggerScheduler::Clock::now();
+						myTriggerScheduler.completed(completion);
+						if (trigger == TriggerMode::Software)
+						{
+							myBlobLock.lock();
+							myPublishedLatency = myTriggerScheduler.latency();
+							myPublishedCompletion = completion;
+							myBlobLock.unlock();
+						}
 					}
 
 				}
@@ -236,118 +602,327 @@ Cpp_Acquisition::execute(TOP_OutputFormatSpecs* output,
 }
 
 void
-Cpp_Acquisition::pImageToTop(const uint8_t* pInput, double startDistance, double endDistance, size_t width, size_t height, size_t srcBpp, float scale, float* pOut)
+Cpp_Acquisition::pImageToTop(const uint8_t* pInput, const DepthSettings& settings, size_t width, size_t height, size_t srcBpp, const ScanCoordinates& coordinates, float* pOut, size_t outWidth, size_t outHeight)
 {
-	size_t size = width * height;
-	size_t srcPixelSize = srcBpp / 8; // divide by the number of bits in a byte
+	// The conversion itself lives in DepthPipeline so the batch tool can share it
+	myCameras[0]->pipeline.process(pInput, width, height, srcBpp, coordinates, settings, pOut, outWidth, outHeight);
+}
 
-	const uint8_t* pIn = pInput;
+void
+Cpp_Acquisition::fuseCameras(const DepthSettings& settings, const FrameSetSettings& frameSet,
+	const std::string& recordPath, bool record, float* pOut, size_t outWidth, size_t outHeight)
+{
+	if (outWidth != size_t(settings.heightmap.width) || outHeight != size_t(settings.heightmap.height))
+	{
+		// The output size hasn't caught up with a change of Output yet
+		memset(pOut, 0, outWidth * outHeight * 4 * sizeof(float));
+		return;
+	}
 
-	const double RGBmin = 0.0;
-	const double RGBmax = 1.0;
-	const double distance = endDistance - startDistance;
+	// The floor plane was calibrated for the primary camera only, the other
+	// cameras' points get their height from their pose
+	DepthSettings otherSettings = settings;
+	otherSettings.heightAboveFloor = false;
 
-	const double redColorBorder = startDistance;
-	const double yellowColorBorder = startDistance + (distance / 4);
-	const double greenColorBorder = startDistance + ((distance / 4) * 2);
-	const double cyanColorBorder = startDistance + ((distance / 4) * 3);
-	const double blueColorBorder = endDistance;
+	myFusion.begin(settings.heightmap);
 
-	// iterate through each pixel and assign a color to it according to a distance
-	for (size_t i = 0; i < size; i++)
+	// Lining the frames up takes them one camera after the other, which is
+	// quick as long as they're already in, and leaves the converting to
+	// the workers
+	if (frameSet.align)
 	{
-		// Isolate the z data
-		//    The first channel is the x coordinate, second channel is the y coordinate,
-		//    the third channel is the z coordinate (which is what we will use to determine
-		//    the coloring) and the fourth channel is intensity.
-		int16_t z = *reinterpret_cast<const int16_t*>((pIn + 4));
-
-		// Convert z to millimeters
-		//    The z data converts at a specified ratio to mm, so by multiplying it by the
-		//    Scan3dCoordinateScale for CoordinateC, we are able to convert it to mm and
-		//    can then compare it to the maximum distance of 6000mm.
-		z = int16_t(double(z) * scale);
-
-		double coordinateColorBlue = 0.0;
-		double coordinateColorGreen = 0.0;
-		double coordinateColorRed = 0.0;
+		std::vector<Arena::IDevice*> devices;
+		for (auto& camera : myCameras)
+			devices.push_back(camera->device);
+		myFrameSets.assemble(devices, frameSet, imageTimeout, &myFrameSetImages);
+	}
 
-		if (z >= startDistance && z <= endDistance) {
+	// One camera per chunk, so every camera converts and adds its frame on
+	// a thread of its own
+	myWorkers.parallelFor(myCameras.size(), [&](size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; i++)
+		{
+			RigCamera& camera = *myCameras[i];
+			// The cameras already keep the pool busy, and it can't be
+			// used from inside one of its own jobs
+			camera.pipeline.setWorkerPool(nullptr);
+
+			// A camera whose trigger didn't go off has no frame coming. Left
+			// out of an aligned set, it was too late to line up.
+			Arena::IImage* image = nullptr;
+			if (frameSet.align)
+				image = myFrameSetImages[i];
+			else if (camera.fired)
+				image = takeImage(camera);
+			if (!image)
+				continue;
+			camera.transport.addFrame(camera.device, image->GetSizeFilled());
+			const size_t width = image->GetWidth();
+			const size_t height = image->GetHeight();
+			const size_t bitsPerPixel = image->GetBitsPerPixel();
+
+			if (i == 0)
+			{
+				myTriggerScheduler.arrived(TriggerScheduler::Clock::now());
+				pImage = image;
+				recordFrame(recordPath, record);
+			}
 
-			// colors between red and yellow
-			if ((z >= redColorBorder) && (z <= yellowColorBorder))
+			camera.pipeline.process(image->GetData(), width, height, bitsPerPixel, camera.coordinates,
+				i == 0 ? settings : otherSettings, nullptr, 0, 0);
+			if (camera.hasPose)
 			{
-				double yellowColorPercentage = (z - redColorBorder) / yellowColorBorder;
+				myFusion.add(image->GetData(), camera.pipeline.depth(), width, height, bitsPerPixel,
+					camera.coordinates, camera.pose);
+			}
+			camera.device->RequeueBuffer(image);
+		}
+	});
+
+	myFusion.resolve(pOut, &myWorkers);
+}
 
-				coordinateColorBlue = RGBmin;
-				coordinateColorGreen = RGBmax * yellowColorPercentage;
-				coordinateColorRed = RGBmax;
+Arena::IImage*
+Cpp_Acquisition::takeImage(RigCamera& camera)
+{
+	try
+	{
+		return camera.device->GetImage(imageTimeout);
+	}
+	catch (GenICam::GenericException& e)
+	{
+		std::cout << "No frame from " << camera.serial << ": " << e.what() << "\n";
+		return nullptr;
+	}
+}
 
-			}
+void
+Cpp_Acquisition::recordFrame(const std::string& path, bool record)
+{
+	updateRecording(path, record);
 
-			// colors between yellow and green
-			else if ((z > yellowColorBorder) && (z <= greenColorBorder))
-			{
-				double greenColorPercentage = (z - yellowColorBorder) / yellowColorBorder;
+	// All frames of a recording have the size it was started with, so it
+	// leaves out the ones from after an ROI change
+	if (!myRecording.isOpen() || pImage->GetWidth() != myRecording.header().width ||
+		pImage->GetHeight() != myRecording.header().height)
+		return;
 
-				coordinateColorBlue = RGBmin;
-				coordinateColorGreen = RGBmax;
-				coordinateColorRed = RGBmax - RGBmax * greenColorPercentage;
-			}
+	// A full disk or a lost drive stops the recording, it is reported by
+	// closeRecording()
+	if (!myRecording.push(pImage->GetData(), pImage->GetTimestampNs()) && myRecording.failed())
+	{
+		myFailedRecording = myRecording.path();
+		closeRecording();
+	}
+}
 
-			// colors between green and cyan
-			else if ((z > greenColorBorder) && (z <= cyanColorBorder))
-			{
-				double cyanColorPercentage = (z - greenColorBorder) / yellowColorBorder;
+void
+Cpp_Acquisition::closeRecording()
+{
+	const std::string path = myRecording.path();
+	const uint32_t dropped = myRecording.dropped();
+	if (!myRecording.close())
+		std::cout << "Unable to write all of " << path << ", the recording stopped early\n";
+	if (dropped > 0)
+		std::cout << "Dropped " << dropped << " frames from " << path << ", the disk didn't keep up\n";
+}
 
-				coordinateColorBlue = RGBmax * cyanColorPercentage;
-				coordinateColorGreen = RGBmax;
-				coordinateColorRed = RGBmin;
+void
+Cpp_Acquisition::updateRecording(const std::string& path, bool record)
+{
+	if (!record || path.empty())
+	{
+		if (myRecording.isOpen())
+		{
+			std::cout << "Closing recording " << myRecording.path() << "\n";
+			closeRecording();
+		}
+		myFailedRecording.clear();
+		return;
+	}
 
-			}
+	if ((myRecording.isOpen() && myRecording.path() == path) || path == myFailedRecording)
+		return;
+	if (myRecording.isOpen())
+		closeRecording();
 
-			// colors between cyan and blue
-			else if ((z > cyanColorBorder) && (z <= blueColorBorder))
-			{
-				double blueColorPercentage = (z - cyanColorBorder) / yellowColorBorder;
+	DepthRecordingHeader header;
+	initDepthRecordingHeader(&header, DepthRecordingFormat::ABCY16,
+		(uint32_t)pImage->GetWidth(), (uint32_t)pImage->GetHeight(),
+		(uint32_t)pImage->GetBitsPerPixel(), myCameras[0]->coordinates);
+	if (myRecording.open(path.c_str(), header))
+	{
+		std::cout << "Recording to " << path << "\n";
+	}
+	else
+	{
+		std::cout << "Unable to open " << path << " for recording\n";
+		myFailedRecording = path;
+	}
+}
 
-				coordinateColorBlue = RGBmax;
-				coordinateColorGreen = RGBmax - RGBmax * blueColorPercentage;
-				coordinateColorRed = RGBmin;
-			}
-			else
-			{
-				coordinateColorBlue = RGBmin;
-				coordinateColorGreen = RGBmin;
-				coordinateColorRed = RGBmin;
-			}
+void
+Cpp_Acquisition::updateStreams(const CameraRoiSettings& roiSettings, const TransportSettings& transportSettings,
+	TriggerMode trigger)
+{
+	for (auto& camera : myCameras)
+	{
+		GenApi::INodeMap* pNodeMap = camera->device->GetNodeMap();
 
+		camera->device->StopStream();
+		try
+		{
+			camera->roi = applyCameraRoi(pNodeMap, roiSettings);
+		}
+		catch (GenICam::GenericException& e)
+		{
+			std::cout << "Unable to set the ROI of " << camera->serial << ": " << e.what() << "\n";
+			camera->roi = readCameraRoi(pNodeMap);
+		}
+		try
+		{
+			applyTransport(camera->device, transportSettings);
+		}
+		catch (GenICam::GenericException& e)
+		{
+			std::cout << "Unable to set the transport of " << camera->serial << ": " << e.what() << "\n";
+		}
+		try
+		{
+			applyTriggerMode(pNodeMap, trigger);
 		}
+		catch (GenICam::GenericException& e)
+		{
+			std::cout << "Unable to set the trigger mode of " << camera->serial << ": " << e.what() << "\n";
+		}
+		camera->coordinates = camera->control.coordinates();
+		camera->device->StartStream();
+		camera->transport.reset();
+
+		// The pixels moved, whatever the filters and the background model
+		// had no longer lines up with them. Every buffer follows the size
+		// of the next image by itself.
+		camera->pipeline.reset();
+		camera->pipeline.learnBackground();
+
+		const CameraRoi& roi = camera->roi;
+		std::cout << "Streaming " << roi.width << "x" << roi.height << " at " << roi.offsetX << "," << roi.offsetY
+			<< ", binning " << roi.binning << ", decimation " << roi.decimation << " from " << camera->serial << "\n";
+	}
+
+	if (myCameras.empty())
+		return;
 
-		int row = (height - (i / width) - 1);
-		int column = i % width;
+	myBlobLock.lock();
+	myImageWidth = size_t(myCameras[0]->roi.width);
+	myImageHeight = size_t(myCameras[0]->roi.height);
+	myBlobLock.unlock();
+}
+
+void
+Cpp_Acquisition::updateControls(const CameraControlSettings& settings)
+{
+	for (auto& camera : myCameras)
+	{
+		bool coordinatesChanged = false;
+		bool refused = false;
+		try
+		{
+			coordinatesChanged = camera->control.apply(settings);
+		}
+		catch (GenICam::GenericException& e)
+		{
+			std::cout << "Unable to change the settings of " << camera->serial << ": " << e.what() << "\n";
+			refused = true;
+		}
+		if (!coordinatesChanged && !refused)
+			continue;
 
-		float grayscale = (6000 -z ) / 6000.0;
-		if (grayscale < 0.0) {
-			grayscale = 0.0;
+		// The range may have gone in before the camera refused something
+		// else, so the coordinates are read again either way
+		const ScanCoordinates old = camera->coordinates;
+		try
+		{
+			camera->coordinates = camera->control.coordinates();
+		}
+		catch (GenICam::GenericException& e)
+		{
+			std::cout << "Unable to read the coordinates of " << camera->serial << ": " << e.what() << "\n";
 		}
-		else if (grayscale > 1.0) {
-			grayscale = 0.0;
+		if (camera->coordinates.scale == old.scale && camera->coordinates.offsetA == old.offsetA &&
+			camera->coordinates.offsetB == old.offsetB && !coordinatesChanged)
+			continue;
+
+		// A new range comes with a new depth unit, which the background
+		// model and the filters' history weren't kept in
+		camera->pipeline.reset();
+		camera->pipeline.learnBackground();
+	}
+}
+
+void
+Cpp_Acquisition::updateSlots(TriggerMode trigger, double guard, bool fused)
+{
+	std::vector<TriggerSlot> slots;
+	double cycle = 0.0;
+	if (trigger == TriggerMode::Multiplexed)
+	{
+		// Only the Fused output reads the other cameras. Triggered without
+		// being read, their frames would pile up in the stream and their
+		// frame rate and packet counters would never move.
+		const size_t count = fused ? myCameras.size() : 1;
+		std::vector<double> illumination;
+		std::vector<SoftwareTrigger*> triggers;
+		for (size_t i = 0; i < count; i++)
+		{
+			illumination.push_back(myCameras[i]->control.illumination());
+			triggers.push_back(&myCameras[i]->trigger);
 		}
+		cycle = planTriggerSlots(illumination, guard, &slots);
+		mySequencer.start(triggers, slots);
+
+		std::cout << "Triggering " << count << " cameras every " << cycle * 1000.0 << " ms\n";
+	}
 
-		// std::cout << i << ": " << row << " x " << column << "\n";
-		float* pixel = &pOut[4 * (row * width + column)];
-		pixel[0] = coordinateColorRed;
-		pixel[1] = coordinateColorGreen;
-		pixel[2] = coordinateColorBlue;
-		pixel[3] = 1;
-		
-		pIn += srcPixelSize;
+	myBlobLock.lock();
+	myPublishedSlots = slots;
+	myPublishedCycle = cycle;
+	myBlobLock.unlock();
+}
 
+void
+Cpp_Acquisition::updateFloor(const FloorPlane& floor)
+{
+	if (!floor.valid)
+	{
+		std::cout << "Unable to find the floor plane\n";
+		return;
 	}
 
-	pDevice->RequeueBuffer(pImage);
+	mySettingsLock.lock();
+	mySettings.floor = floor;
+	const std::string path = myFloorPath;
+	mySettingsLock.unlock();
+
+	std::cout << "Floor plane " << floor.normal[0] << " " << floor.normal[1] << " " << floor.normal[2]
+		<< " " << floor.distance << "\n";
+	if (!path.empty() && !saveFloorPlane(path.c_str(), floor))
+		std::cout << "Unable to save the floor plane to " << path << "\n";
+}
 
+void
+Cpp_Acquisition::updatePoses(const std::vector<CameraPose>& poses)
+{
+	for (auto& camera : myCameras)
+	{
+		const CameraPose* pose = findCameraPose(poses, camera->serial);
+		camera->hasPose = pose != nullptr;
+		if (pose)
+			camera->pose = *pose;
+		else if (!poses.empty())
+			std::cout << "No pose for camera " << camera->serial << ", it is left out of the fusion\n";
+	}
 }
 
 void
@@ -368,19 +943,111 @@ Cpp_Acquisition::waitForMoreWork()
 	myStartWork = false;
 }
 
+// The values of each blob, in the order of the Info DAT's columns and of
+// each blob's Info CHOP channels
+static const char* BlobFields[] =
+{
+	"id", "u", "v", "umin", "vmin", "umax", "vmax",
+	"area", "meandepth", "mindepth", "nearu", "nearv", "velu", "velv"
+};
+static const int32_t NumBlobFields = int32_t(sizeof(BlobFields) / sizeof(BlobFields[0]));
+
+static float
+blobField(const Blob& blob, int32_t field)
+{
+	switch (field)
+	{
+		case 0: return float(blob.id);
+		case 1: return blob.u;
+		case 2: return blob.v;
+		case 3: return blob.uMin;
+		case 4: return blob.vMin;
+		case 5: return blob.uMax;
+		case 6: return blob.vMax;
+		case 7: return float(blob.area);
+		case 8: return blob.meanDepth;
+		case 9: return blob.minDepth;
+		case 10: return blob.nearU;
+		case 11: return blob.nearV;
+		case 12: return blob.velocityU;
+		case 13: return blob.velocityV;
+		default: return 0.0f;
+	}
+}
+
+// executeCount, step, blobs, cameras, points, near, far, triggerlatency,
+// triggerslack, triggercycle, framesetspread and framesetdropped come
+// before the per camera channels
+static const int32_t NumFixedChans = 12;
+
+// A set of these per camera follows the fixed channels. fps is the frame
+// rate the camera achieved, slot and slotlength (ms) are its trigger slot,
+// and timeoffset (ms) is how much older its frame was than the newest one
+// of the frame set.
+static const char* CameraFields[] =
+{
+	"packetsize", "mbps", "fps", "missedpackets", "resends", "incomplete", "lostframes", "slot", "slotlength",
+	"timeoffset"
+};
+static const int32_t NumCameraFields = sizeof(CameraFields) / sizeof(CameraFields[0]);
+
+static float
+cameraField(const TransportStats& stats, const TriggerSlot& slot, double offset, int32_t field)
+{
+	switch (field)
+	{
+		case 0: return (float)stats.packetSize;
+		case 1: return (float)stats.megabitsPerSecond;
+		case 2: return (float)stats.framesPerSecond;
+		case 3: return (float)stats.missedPackets;
+		case 4: return (float)stats.resendRequests;
+		case 5: return (float)stats.incompleteImages;
+		case 6: return (float)stats.lostFrames;
+		case 7: return (float)(slot.offset * 1000.0);
+		case 8: return (float)(slot.length * 1000.0);
+		case 9: return (float)(offset * 1000.0);
+		default: return 0.0f;
+	}
+}
+
+// With Depth Statistics on, these and then a channel per histogram bin
+// come between the camera and the per blob channels
+static const char* StatsFields[] =
+{
+	"validpixels", "depthmin", "depthmax", "depthmean", "nearestu", "nearestv"
+};
+static const int32_t NumStatsFields = sizeof(StatsFields) / sizeof(StatsFields[0]);
+
+static float
+statsField(const DepthStats& stats, int32_t field)
+{
+	switch (field)
+	{
+		case 0: return (float)stats.validCount;
+		case 1: return (float)stats.minDepth;
+		case 2: return (float)stats.maxDepth;
+		case 3: return (float)stats.mean();
+		case 4: return stats.nearestU();
+		case 5: return stats.nearestV();
+		default: return (float)stats.histogram[field - NumStatsFields];
+	}
+}
+
 int32_t
 Cpp_Acquisition::getNumInfoCHOPChans(void* reserved1)
 {
 	// We return the number of channel we want to output to any Info CHOP
-	// connected to the TOP. In this example we are just going to send one channel.
-	return 2;
+	// connected to the TOP: a few fixed ones, a set per camera, the depth
+	// statistics if they were gathered, then a set per blob.
+	const int32_t cameraChans = int32_t(myInfoTransport.size()) * NumCameraFields;
+	const int32_t statsChans = myInfoStats.width > 0 ? NumStatsFields + DepthStats::NumBins : 0;
+	return NumFixedChans + cameraChans + statsChans + int32_t(myInfoBlobs.size()) * NumBlobFields;
 }
 
 void
 Cpp_Acquisition::getInfoCHOPChan(int32_t index, OP_InfoCHOPChan* chan, void* reserved1)
 {
 	// This function will be called once for each channel we said we'd want to return
-	// In this example it'll only be called once.
 
 	if (index == 0)
 	{
@@ -393,13 +1060,140 @@ Cpp_Acquisition::getInfoCHOPChan(int32_t index, OP_InfoCHOPChan* chan, void* res
 		chan->name->setString("step");
 		chan->value = (float)myStep;
 	}
+
+	if (index == 2)
+	{
+		chan->name->setString("blobs");
+		chan->value = (float)myInfoBlobs.size();
+	}
+
+	if (index == 3)
+	{
+		chan->name->setString("cameras");
+		chan->value = (float)myCameras.size();
+	}
+
+	if (index == 4)
+	{
+		chan->name->setString("points");
+		chan->value = (float)myInfoPoints;
+	}
+
+	// The range the colors used, which is Near and Far unless Auto Range
+	// picked it
+	if (index == 5)
+	{
+		chan->name->setString("near");
+		chan->value = (float)myInfoStartDistance;
+	}
+
+	if (index == 6)
+	{
+		chan->name->setString("far");
+		chan->value = (float)myInfoEndDistance;
+	}
+
+	// In Triggered mode, ms from trigger to image, and how long the frame
+	// was ready before the cook
+	if (index == 7)
+	{
+		chan->name->setString("triggerlatency");
+		chan->value = (float)(myInfoLatency * 1000.0);
+	}
+
+	if (index == 8)
+	{
+		chan->name->setString("triggerslack");
+		chan->value = (float)(myInfoSlack * 1000.0);
+	}
+
+	// In Multiplexed mode, ms for every camera to be triggered once
+	if (index == 9)
+	{
+		chan->name->setString("triggercycle");
+		chan->value = (float)(myInfoCycle * 1000.0);
+	}
+
+	// With Align Frames on, ms between the first and last frame of the
+	// fused set, and the cameras left out of it
+	if (index == 10)
+	{
+		chan->name->setString("framesetspread");
+		chan->value = (float)(myInfoSpread * 1000.0);
+	}
+
+	if (index == 11)
+	{
+		chan->name->setString("framesetdropped");
+		chan->value = (float)myInfoDropped;
+	}
+
+	const int32_t cameraChans = int32_t(myInfoTransport.size()) * NumCameraFields;
+	if (index >= NumFixedChans && index < NumFixedChans + cameraChans)
+	{
+		const int32_t camera = (index - NumFixedChans) / NumCameraFields;
+		const int32_t field = (index - NumFixedChans) % NumCameraFields;
+		const TriggerSlot slot = size_t(camera) < myInfoSlots.size() ? myInfoSlots[camera] : TriggerSlot();
+		const double offset = size_t(camera) < myInfoOffsets.size() ? myInfoOffsets[camera] : 0.0;
+
+		char tempBuffer[64];
+#ifdef _WIN32
+		sprintf_s(tempBuffer, "cam%d_%s", camera, CameraFields[field]);
+#else // macOS
+		snprintf(tempBuffer, sizeof(tempBuffer), "cam%d_%s", camera, CameraFields[field]);
+#endif
+		chan->name->setString(tempBuffer);
+		chan->value = cameraField(myInfoTransport[camera], slot, offset, field);
+	}
+
+	const int32_t statsBegin = NumFixedChans + cameraChans;
+	const int32_t statsChans = myInfoStats.width > 0 ? NumStatsFields + DepthStats::NumBins : 0;
+	if (index >= statsBegin && index < statsBegin + statsChans)
+	{
+		const int32_t field = index - statsBegin;
+		char tempBuffer[64];
+		if (field < NumStatsFields)
+		{
+#ifdef _WIN32
+			strcpy_s(tempBuffer, StatsFields[field]);
+#else // macOS
+			strlcpy(tempBuffer, StatsFields[field], sizeof(tempBuffer));
+#endif
+		}
+		else
+		{
+#ifdef _WIN32
+			sprintf_s(tempBuffer, "hist%d", field - NumStatsFields);
+#else // macOS
+			snprintf(tempBuffer, sizeof(tempBuffer), "hist%d", field - NumStatsFields);
+#endif
+		}
+		chan->name->setString(tempBuffer);
+		chan->value = statsField(myInfoStats, field);
+	}
+
+	if (index >= statsBegin + statsChans)
+	{
+		const int32_t blob = (index - statsBegin - statsChans) / NumBlobFields;
+		const int32_t field = (index - statsBegin - statsChans) % NumBlobFields;
+
+		char tempBuffer[64];
+#ifdef _WIN32
+		sprintf_s(tempBuffer, "blob%d_%s", blob, BlobFields[field]);
+#else // macOS
+		snprintf(tempBuffer, sizeof(tempBuffer), "blob%d_%s", blob, BlobFields[field]);
+#endif
+		chan->name->setString(tempBuffer);
+		chan->value = blobField(myInfoBlobs[blob], field);
+	}
 }
 
 bool
 Cpp_Acquisition::getInfoDATSize(OP_InfoDATSize* infoSize, void* reserved1)
 {
-	infoSize->rows = 2;
-	infoSize->cols = 2;
+	// A header row and then one row per blob
+	infoSize->rows = 1 + int32_t(myInfoBlobs.size());
+	infoSize->cols = NumBlobFields;
 	// Setting this to false means we'll be assigning values to the table
 	// one row at a time. True means we'll do it one column at a time.
 	infoSize->byColumn = false;
@@ -414,77 +1208,1021 @@ Cpp_Acquisition::getInfoDATEntries(int32_t index,
 {
 	char tempBuffer[4096];
 
-	if (index == 0)
-	{
-		// Set the value for the first column
-#ifdef _WIN32
-		strcpy_s(tempBuffer, "executeCount");
-#else // macOS
-		strlcpy(tempBuffer, "executeCount", sizeof(tempBuffer));
-#endif
-		entries->values[0]->setString(tempBuffer);
-
-		// Set the value for the second column
-#ifdef _WIN32
-		sprintf_s(tempBuffer, "%d", myExecuteCount);
-#else // macOS
-		snprintf(tempBuffer, sizeof(tempBuffer), "%d", myExecuteCount);
-#endif
-		entries->values[1]->setString(tempBuffer);
-	}
-
-	if (index == 1)
+	for (int32_t field = 0; field < nEntries && field < NumBlobFields; field++)
 	{
+		if (index == 0)
+		{
 #ifdef _WIN32
-		strcpy_s(tempBuffer, "step");
+			strcpy_s(tempBuffer, BlobFields[field]);
 #else // macOS
-		strlcpy(tempBuffer, "step", sizeof(tempBuffer));
+			strlcpy(tempBuffer, BlobFields[field], sizeof(tempBuffer));
 #endif
-		entries->values[0]->setString(tempBuffer);
-
+		}
+		else
+		{
 #ifdef _WIN32
-		sprintf_s(tempBuffer, "%g", myStep);
+			sprintf_s(tempBuffer, "%g", blobField(myInfoBlobs[index - 1], field));
 #else // macOS
-		snprintf(tempBuffer, sizeof(tempBuffer), "%g", myStep);
+			snprintf(tempBuffer, sizeof(tempBuffer), "%g", blobField(myInfoBlobs[index - 1], field));
 #endif
-		entries->values[1]->setString(tempBuffer);
+		}
+		entries->values[field]->setString(tempBuffer);
 	}
 }
 
 void
 Cpp_Acquisition::setupParameters(OP_ParameterManager* manager, void* reserved1)
 {
-	// Near distance
+	// Done on the camera, so the pixels left out never cross the network.
+	// Cameras without the feature ignore it.
 	{
-		OP_NumericParameter	np;
+		const char* parNames[] = { "Binning", "Decimation" };
+		for (int i = 0; i < 2; i++)
+		{
+			OP_StringParameter	sp;
 
-		np.name = "Near";
-		np.label = "Near";
-		np.defaultValues[0] = 0.0;
+			sp.name = parNames[i];
+			sp.label = parNames[i];
+			sp.defaultValue = "1";
 
-		np.minSliders[0] = 0.0;
-		np.maxSliders[0] = 6000.0;
+			const char* names[] = { "1", "2", "4" };
+			const char* labels[] = { "Off", "2x2", "4x4" };
 
-		np.minValues[0] = 0.0;
-		np.maxValues[0] = 6000.0;
+			OP_ParAppendResult res = manager->appendMenu(sp, 3, names, labels);
+			assert(res == OP_ParAppendResult::Success);
+		}
+	}
 
-		np.clampMins[0] = true;
-		np.clampMaxes[0] = true;
+	// Window of the sensor the camera sends, in pixels after the binning and
+	// decimation. A size of 0 goes to the edge of the sensor.
+	{
+		OP_NumericParameter	np;
 
-		OP_ParAppendResult res = manager->appendFloat(np);
+		np.name = "Roioffset";
+		np.label = "ROI Offset";
+		for (int i = 0; i < 2; i++)
+		{
+			np.defaultValues[i] = 0.0;
+			np.minSliders[i] = 0.0;
+			np.maxSliders[i] = 640.0;
+			np.minValues[i] = 0.0;
+			np.clampMins[i] = true;
+		}
+
+		OP_ParAppendResult res = manager->appendInt(np, 2);
 		assert(res == OP_ParAppendResult::Success);
 	}
-	
-	// Far distance
+
 	{
 		OP_NumericParameter	np;
 
-		np.name = "Far";
+		np.name = "Roisize";
+		np.label = "ROI Size";
+		for (int i = 0; i < 2; i++)
+		{
+			np.defaultValues[i] = 0.0;
+			np.minSliders[i] = 0.0;
+			np.maxSliders[i] = 640.0;
+			np.minValues[i] = 0.0;
+			np.clampMins[i] = true;
+		}
+
+		OP_ParAppendResult res = manager->appendInt(np, 2);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// GigE transport, applied when the streams restart. Auto Packet Size
+	// takes the largest packet the network carries, 9000 with jumbo frames
+	// on, otherwise Packet Size is used.
+	{
+		OP_NumericParameter	np;
+
+		np.name = "Autopacketsize";
+		np.label = "Auto Packet Size";
+		np.defaultValues[0] = 1.0;
+
+		OP_ParAppendResult res = manager->appendToggle(np);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	{
+		OP_NumericParameter	np;
+
+		np.name = "Packetsize";
+		np.label = "Packet Size";
+		np.defaultValues[0] = 1500.0;
+
+		np.minSliders[0] = 576.0;
+		np.maxSliders[0] = 9000.0;
+
+		np.minValues[0] = 576.0;
+		np.maxValues[0] = 9000.0;
+
+		np.clampMins[0] = true;
+		np.clampMaxes[0] = true;
+
+		OP_ParAppendResult res = manager->appendInt(np);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// Gap between packets in ns, spreads the cameras sharing a link
+	{
+		OP_NumericParameter	np;
+
+		np.name = "Packetdelay";
+		np.label = "Packet Delay";
+		np.defaultValues[0] = 0.0;
+
+		np.minSliders[0] = 0.0;
+		np.maxSliders[0] = 100000.0;
+
+		np.minValues[0] = 0.0;
+		np.clampMins[0] = true;
+
+		OP_ParAppendResult res = manager->appendInt(np);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	{
+		OP_NumericParameter	np;
+
+		np.name = "Packetresend";
+		np.label = "Packet Resend";
+		np.defaultValues[0] = 1.0;
+
+		OP_ParAppendResult res = manager->appendToggle(np);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// Per camera, in Mbit/s. 0 lets each camera use the whole link.
+	{
+		OP_NumericParameter	np;
+
+		np.name = "Bandwidthlimit";
+		np.label = "Bandwidth Limit";
+		np.defaultValues[0] = 0.0;
+
+		np.minSliders[0] = 0.0;
+		np.maxSliders[0] = 1000.0;
+
+		np.minValues[0] = 0.0;
+		np.clampMins[0] = true;
+
+		OP_ParAppendResult res = manager->appendFloat(np);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// Percent of the bandwidth held back for resent packets
+	{
+		OP_NumericParameter	np;
+
+		np.name = "Bandwidthreserve";
+		np.label = "Bandwidth Reserve";
+		np.defaultValues[0] = 10.0;
+
+		np.minSliders[0] = 0.0;
+		np.maxSliders[0] = 50.0;
+
+		np.minValues[0] = 0.0;
+		np.maxValues[0] = 100.0;
+
+		np.clampMins[0] = true;
+		np.clampMaxes[0] = true;
+
+		OP_ParAppendResult res = manager->appendInt(np);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// The camera's own settings, changed while it streams. Camera leaves
+	// a setting the way it was when the camera was opened.
+	{
+		OP_StringParameter	sp;
+
+		sp.name = "Camerarange";
+		sp.label = "Camera Range";
+		sp.defaultValue = "Camera";
+
+		const char* names[] = { "Camera", "Near1250", "Mid3000", "Mid4000", "Far5000", "Far6000", "Far8300" };
+		const char* labels[] = { "Camera", "1250 mm", "3000 mm", "4000 mm", "5000 mm", "6000 mm", "8300 mm" };
+
+		OP_ParAppendResult res = manager->appendMenu(sp, 7, names, labels);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	{
+		OP_StringParameter	sp;
+
+		sp.name = "Exposure";
+		sp.label = "Exposure";
+		sp.defaultValue = "Camera";
+
+		const char* names[] = { "Camera", "Short62", "Medium250", "Long1000" };
+		const char* labels[] = { "Camera", "62.5 us", "250 us", "1000 us" };
+
+		OP_ParAppendResult res = manager->appendMenu(sp, 4, names, labels);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	{
+		OP_StringParameter	sp;
+
+		sp.name = "Conversiongain";
+		sp.label = "Conversion Gain";
+		sp.defaultValue = "Camera";
+
+		const char* names[] = { "Camera", "Low", "High" };
+		const char* labels[] = { "Camera", "Low", "High" };
+
+		OP_ParAppendResult res = manager->appendMenu(sp, 3, names, labels);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// Frames averaged on the camera, 0 leaves it as it is
+	{
+		OP_NumericParameter	np;
+
+		np.name = "Accumulation";
+		np.label = "Accumulation";
+		np.defaultValues[0] = 0.0;
+
+		np.minSliders[0] = 0.0;
+		np.maxSliders[0] = 16.0;
+
+		np.minValues[0] = 0.0;
+		np.clampMins[0] = true;
+
+		OP_ParAppendResult res = manager->appendInt(np);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	{
+		OP_NumericParameter	np;
+
+		np.name = "Cameraspatialfilter";
+		np.label = "Camera Spatial Filter";
+		np.defaultValues[0] = 1.0;
+
+		OP_ParAppendResult res = manager->appendToggle(np);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// Free Run takes the newest frame each cook. Triggered takes one frame
+	// per cook, fired so it's ready Trigger Margin (ms) before the next one.
+	// Multiplexed fires the cameras one after the other as fast as they
+	// go, Slot Guard (ms) apart, so cameras facing each other don't
+	// disturb each other's depth. It takes in every camera with the Fused
+	// output only, the other outputs just trigger the primary camera.
+	{
+		OP_StringParameter	sp;
+
+		sp.name = "Acquisition";
+		sp.label = "Acquisition";
+		sp.defaultValue = "Freerun";
+
+		const char* names[] = { "Freerun", "Triggered", "Multiplexed" };
+		const char* labels[] = { "Free Run", "Triggered", "Multiplexed" };
+
+		OP_ParAppendResult res = manager->appendMenu(sp, 3, names, labels);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	{
+		OP_NumericParameter	np;
+
+		np.name = "Triggermargin";
+		np.label = "Trigger Margin";
+		np.defaultValues[0] = 2.0;
+
+		np.minSliders[0] = 0.0;
+		np.maxSliders[0] = 20.0;
+
+		np.minValues[0] = 0.0;
+		np.clampMins[0] = true;
+
+		OP_ParAppendResult res = manager->appendFloat(np);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	{
+		OP_NumericParameter	np;
+
+		np.name = "Slotguard";
+		np.label = "Slot Guard";
+		np.defaultValues[0] = 0.5;
+
+		np.minSliders[0] = 0.0;
+		np.maxSliders[0] = 5.0;
+
+		np.minValues[0] = 0.0;
+		np.clampMins[0] = true;
+
+		OP_ParAppendResult res = manager->appendFloat(np);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// Syncs the cameras' clocks, which Align Frames needs to compare their
+	// timestamps
+	{
+		OP_NumericParameter	np;
+
+		np.name = "Ptp";
+		np.label = "PTP Sync";
+		np.defaultValues[0] = 0.0;
+
+		OP_ParAppendResult res = manager->appendToggle(np);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// Fuses only frames taken within Align Tolerance (ms) of each other,
+	// waiting at most Align Wait (ms) for a camera that's behind before
+	// leaving it out
+	{
+		OP_NumericParameter	np;
+
+		np.name = "Alignframes";
+		np.label = "Align Frames";
+		np.defaultValues[0] = 0.0;
+
+		OP_ParAppendResult res = manager->appendToggle(np);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	{
+		OP_NumericParameter	np;
+
+		np.name = "Aligntolerance";
+		np.label = "Align Tolerance";
+		np.defaultValues[0] = 2.0;
+
+		np.minSliders[0] = 0.0;
+		np.maxSliders[0] = 50.0;
+
+		np.minValues[0] = 0.0;
+		np.clampMins[0] = true;
+
+		OP_ParAppendResult res = manager->appendFloat(np);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	{
+		OP_NumericParameter	np;
+
+		np.name = "Alignwait";
+		np.label = "Align Wait";
+		np.defaultValues[0] = 40.0;
+
+		np.minSliders[0] = 0.0;
+		np.maxSliders[0] = 200.0;
+
+		np.minValues[0] = 0.0;
+		np.clampMins[0] = true;
+
+		OP_ParAppendResult res = manager->appendFloat(np);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// Near distance
+	{
+		OP_NumericParameter	np;
+
+		np.name = "Near";
+		np.label = "Near";
+		np.defaultValues[0] = 0.0;
+
+		np.minSliders[0] = 0.0;
+		np.maxSliders[0] = 6000.0;
+
+		np.minValues[0] = 0.0;
+		np.maxValues[0] = 6000.0;
+
+		np.clampMins[0] = true;
+		np.clampMaxes[0] = true;
+
+		OP_ParAppendResult res = manager->appendFloat(np);
+		assert(res == OP_ParAppendResult::Success);
+	}
+	
+	// Far distance
+	{
+		OP_NumericParameter	np;
+
+		np.name = "Far";
 		np.label = "Far";
 		np.defaultValues[0] = 6000.0;
 
 		np.minSliders[0] = 0.0;
-		np.maxSliders[0] = 6000.0;
+		np.maxSliders[0] = 6000.0;
+
+		np.minValues[0] = 0.0;
+		np.maxValues[0] = 6000.0;
+
+		np.clampMins[0] = true;
+		np.clampMaxes[0] = true;
+
+		OP_ParAppendResult res = manager->appendFloat(np);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// Set Near and Far from where most of the depth is, instead of the
+	// parameters above. Only the colors use the picked range.
+	{
+		OP_NumericParameter	np;
+
+		np.name = "Autorange";
+		np.label = "Auto Range";
+		np.defaultValues[0] = 0.0;
+
+		OP_ParAppendResult res = manager->appendToggle(np);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// Percent of the pixels nearer than Near and than Far
+	{
+		OP_NumericParameter	np;
+
+		np.name = "Autorangepercentiles";
+		np.label = "Auto Range Percentiles";
+		np.defaultValues[0] = 2.0;
+		np.defaultValues[1] = 98.0;
+		for (int i = 0; i < 2; i++)
+		{
+			np.minSliders[i] = 0.0;
+			np.maxSliders[i] = 100.0;
+			np.minValues[i] = 0.0;
+			np.maxValues[i] = 100.0;
+			np.clampMins[i] = true;
+			np.clampMaxes[i] = true;
+		}
+
+		OP_ParAppendResult res = manager->appendFloat(np, 2);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// Weight of each new frame in the histogram the range comes from
+	{
+		OP_NumericParameter	np;
+
+		np.name = "Autorangerate";
+		np.label = "Auto Range Rate";
+		np.defaultValues[0] = 0.1;
+
+		np.minSliders[0] = 0.0;
+		np.maxSliders[0] = 1.0;
+
+		np.minValues[0] = 0.0;
+		np.maxValues[0] = 1.0;
+
+		np.clampMins[0] = true;
+		np.clampMaxes[0] = true;
+
+		OP_ParAppendResult res = manager->appendFloat(np);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// How far (mm) the range has to be off before Near or Far move
+	{
+		OP_NumericParameter	np;
+
+		np.name = "Autorangehysteresis";
+		np.label = "Auto Range Hysteresis";
+		np.defaultValues[0] = 100.0;
+
+		np.minSliders[0] = 0.0;
+		np.maxSliders[0] = 500.0;
+
+		np.minValues[0] = 0.0;
+		np.maxValues[0] = 6000.0;
+
+		np.clampMins[0] = true;
+		np.clampMaxes[0] = true;
+
+		OP_ParAppendResult res = manager->appendFloat(np);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// Colors of the depth from Near to Far
+	{
+		OP_StringParameter	sp;
+
+		sp.name = "Colormap";
+		sp.label = "Colormap";
+		sp.defaultValue = "Classic";
+
+		const char* names[] = { "Classic", "Grayscale", "Invertedgrayscale", "Turbo", "Viridis", "Custom" };
+		const char* labels[] = { "Classic", "Grayscale", "Inverted Grayscale", "Turbo", "Viridis", "Custom" };
+
+		OP_ParAppendResult res = manager->appendMenu(sp, 6, names, labels);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// The Custom colormap's gradient, a table with a row per stop of
+	// position (0 at Near to 1 at Far), r, g, b and optionally a
+	{
+		OP_StringParameter	sp;
+
+		sp.name = "Colormapdat";
+		sp.label = "Colormap DAT";
+
+		OP_ParAppendResult res = manager->appendDAT(sp);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// Pixels darker than this in the intensity channel are dropped
+	{
+		OP_NumericParameter	np;
+
+		np.name = "Minintensity";
+		np.label = "Min Intensity";
+		np.defaultValues[0] = 0.0;
+
+		np.minSliders[0] = 0.0;
+		np.maxSliders[0] = 1000.0;
+
+		np.minValues[0] = 0.0;
+		np.maxValues[0] = 65535.0;
+
+		np.clampMins[0] = true;
+		np.clampMaxes[0] = true;
+
+		OP_ParAppendResult res = manager->appendInt(np);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// Depth jump (mm) around a pixel that marks it as a flying pixel, 0 is off
+	{
+		OP_NumericParameter	np;
+
+		np.name = "Flyingpixels";
+		np.label = "Flying Pixel Threshold";
+		np.defaultValues[0] = 0.0;
+
+		np.minSliders[0] = 0.0;
+		np.maxSliders[0] = 500.0;
+
+		np.minValues[0] = 0.0;
+		np.maxValues[0] = 6000.0;
+
+		np.clampMins[0] = true;
+		np.clampMaxes[0] = true;
+
+		OP_ParAppendResult res = manager->appendInt(np);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// Fills the invalid pixels left by the checks above
+	{
+		OP_StringParameter	sp;
+
+		sp.name = "Holefill";
+		sp.label = "Hole Fill";
+		sp.defaultValue = "Off";
+
+		const char* names[] = { "Off", "Nearest", "Pushpull" };
+		const char* labels[] = { "Off", "Nearest", "Push-Pull" };
+
+		OP_ParAppendResult res = manager->appendMenu(sp, 3, names, labels);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// Largest hole (pixels) that gets filled
+	{
+		OP_NumericParameter	np;
+
+		np.name = "Holesize";
+		np.label = "Hole Size";
+		np.defaultValues[0] = 16.0;
+
+		np.minSliders[0] = 1.0;
+		np.maxSliders[0] = 64.0;
+
+		np.minValues[0] = 1.0;
+		np.maxValues[0] = 256.0;
+
+		np.clampMins[0] = true;
+		np.clampMaxes[0] = true;
+
+		OP_ParAppendResult res = manager->appendInt(np);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// Spatial filter, applied to the depth before it is colored
+	{
+		OP_StringParameter	sp;
+
+		sp.name = "Spatialfilter";
+		sp.label = "Spatial Filter";
+		sp.defaultValue = "Off";
+
+		const char* names[] = { "Off", "Median3", "Median5", "Bilateral" };
+		const char* labels[] = { "Off", "Median 3x3", "Median 5x5", "Bilateral" };
+
+		OP_ParAppendResult res = manager->appendMenu(sp, 4, names, labels);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// Depth difference (mm) the bilateral filter still smooths across
+	{
+		OP_NumericParameter	np;
+
+		np.name = "Bilateralrange";
+		np.label = "Bilateral Range";
+		np.defaultValues[0] = 50.0;
+
+		np.minSliders[0] = 1.0;
+		np.maxSliders[0] = 500.0;
+
+		np.minValues[0] = 1.0;
+		np.maxValues[0] = 2000.0;
+
+		np.clampMins[0] = true;
+		np.clampMaxes[0] = true;
+
+		OP_ParAppendResult res = manager->appendFloat(np);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// Temporal filter, applied to the depth before it is colored
+	{
+		OP_StringParameter	sp;
+
+		sp.name = "Temporalfilter";
+		sp.label = "Temporal Filter";
+		sp.defaultValue = "Off";
+
+		const char* names[] = { "Off", "Average", "Median" };
+		const char* labels[] = { "Off", "Moving Average", "Median" };
+
+		OP_ParAppendResult res = manager->appendMenu(sp, 3, names, labels);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	{
+		OP_NumericParameter	np;
+
+		np.name = "Temporalweight";
+		np.label = "Average Weight";
+		np.defaultValues[0] = 0.3;
+
+		np.minSliders[0] = 0.0;
+		np.maxSliders[0] = 1.0;
+
+		np.minValues[0] = 0.0;
+		np.maxValues[0] = 1.0;
+
+		np.clampMins[0] = true;
+		np.clampMaxes[0] = true;
+
+		OP_ParAppendResult res = manager->appendFloat(np);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// Depth change (mm) that counts as motion and restarts the average
+	{
+		OP_NumericParameter	np;
+
+		np.name = "Temporalreset";
+		np.label = "Average Reset";
+		np.defaultValues[0] = 100.0;
+
+		np.minSliders[0] = 0.0;
+		np.maxSliders[0] = 1000.0;
+
+		np.minValues[0] = 0.0;
+		np.maxValues[0] = 6000.0;
+
+		np.clampMins[0] = true;
+		np.clampMaxes[0] = true;
+
+		OP_ParAppendResult res = manager->appendInt(np);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	{
+		OP_StringParameter	sp;
+
+		sp.name = "Medianframes";
+		sp.label = "Median Frames";
+		sp.defaultValue = "3";
+
+		const char* names[] = { "3", "5" };
+		const char* labels[] = { "3", "5" };
+
+		OP_ParAppendResult res = manager->appendMenu(sp, 2, names, labels);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// What the TOP outputs
+	{
+		OP_StringParameter	sp;
+
+		sp.name = "Outputmode";
+		sp.label = "Output";
+		sp.defaultValue = "Color";
+
+		const char* names[] = { "Color", "Foregroundmask", "Foregrounddepth", "Heightmap", "Fused", "Pointcloud" };
+		const char* labels[] = { "Depth Color", "Foreground Mask", "Foreground Depth", "Heightmap", "Fused Heightmap",
+			"Point Cloud" };
+
+		OP_ParAppendResult res = manager->appendMenu(sp, 6, names, labels);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// Resolution of the image outputs, Camera follows the camera's Width and
+	// Height. Half and Quarter are cheaper previews.
+	{
+		OP_StringParameter	sp;
+
+		sp.name = "Outputresolution";
+		sp.label = "Output Resolution";
+		sp.defaultValue = "Camera";
+
+		const char* names[] = { "Camera", "Half", "Quarter", "Custom" };
+		const char* labels[] = { "Camera", "Half", "Quarter", "Custom" };
+
+		OP_ParAppendResult res = manager->appendMenu(sp, 4, names, labels);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// Used by the Custom resolution
+	{
+		OP_NumericParameter	np;
+
+		np.name = "Outputsize";
+		np.label = "Output Size";
+		np.defaultValues[0] = 640.0;
+		np.defaultValues[1] = 480.0;
+		for (int i = 0; i < 2; i++)
+		{
+			np.minSliders[i] = 16.0;
+			np.maxSliders[i] = 2048.0;
+			np.minValues[i] = 1.0;
+			np.maxValues[i] = 8192.0;
+			np.clampMins[i] = true;
+			np.clampMaxes[i] = true;
+		}
+
+		OP_ParAppendResult res = manager->appendInt(np, 2);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// How the camera image is scaled to that resolution
+	{
+		OP_StringParameter	sp;
+
+		sp.name = "Resample";
+		sp.label = "Resample";
+		sp.defaultValue = "Box";
+
+		const char* names[] = { "Box", "Bilinear", "Nearest" };
+		const char* labels[] = { "Box", "Bilinear", "Nearest" };
+
+		OP_ParAppendResult res = manager->appendMenu(sp, 3, names, labels);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// Heightmap resolution
+	{
+		OP_NumericParameter	np;
+
+		np.name = "Heightmapres";
+		np.label = "Heightmap Resolution";
+		for (int i = 0; i < 2; i++)
+		{
+			np.defaultValues[i] = 512.0;
+			np.minSliders[i] = 16.0;
+			np.maxSliders[i] = 2048.0;
+			np.minValues[i] = 1.0;
+			np.maxValues[i] = 8192.0;
+			np.clampMins[i] = true;
+			np.clampMaxes[i] = true;
+		}
+
+		OP_ParAppendResult res = manager->appendInt(np, 2);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// Center of the area on the floor (mm) that the heightmap covers, in
+	// world space for the Fused Heightmap
+	{
+		OP_NumericParameter	np;
+
+		np.name = "Heightmapcenter";
+		np.label = "Heightmap Center";
+		np.defaultValues[0] = 0.0;
+		np.defaultValues[1] = 2000.0;
+		for (int i = 0; i < 2; i++)
+		{
+			np.minSliders[i] = -5000.0;
+			np.maxSliders[i] = 5000.0;
+		}
+
+		OP_ParAppendResult res = manager->appendXY(np);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	{
+		OP_NumericParameter	np;
+
+		np.name = "Heightmapsize";
+		np.label = "Heightmap Size";
+		for (int i = 0; i < 2; i++)
+		{
+			np.defaultValues[i] = 4000.0;
+			np.minSliders[i] = 100.0;
+			np.maxSliders[i] = 10000.0;
+			np.minValues[i] = 1.0;
+			np.clampMins[i] = true;
+		}
+
+		OP_ParAppendResult res = manager->appendFloat(np, 2);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// Where each camera is in the world, for the Fused Heightmap
+	{
+		OP_StringParameter	sp;
+
+		sp.name = "Rigfile";
+		sp.label = "Rig File";
+		sp.defaultValue = "rig.txt";
+
+		OP_ParAppendResult res = manager->appendFile(sp);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// Rotates or mirrors the image outputs, after the corner pin
+	{
+		OP_StringParameter	sp;
+
+		sp.name = "Orientation";
+		sp.label = "Orientation";
+		sp.defaultValue = "None";
+
+		const char* names[] = { "None", "Rotate90", "Rotate180", "Rotate270", "Fliph", "Flipv" };
+		const char* labels[] = { "None", "Rotate 90", "Rotate 180", "Rotate 270", "Flip Horizontal", "Flip Vertical" };
+
+		OP_ParAppendResult res = manager->appendMenu(sp, 6, names, labels);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// Where each corner of the image lands in the output (0..1), for
+	// warping it into a projector's view
+	{
+		const char* names[] = { "Cornerpinbl", "Cornerpinbr", "Cornerpintl", "Cornerpintr" };
+		const char* labels[] = { "Corner Pin Bottom Left", "Corner Pin Bottom Right",
+			"Corner Pin Top Left", "Corner Pin Top Right" };
+
+		for (int corner = 0; corner < 4; corner++)
+		{
+			OP_NumericParameter	np;
+
+			np.name = names[corner];
+			np.label = labels[corner];
+			np.defaultValues[0] = corner % 2 ? 1.0 : 0.0;
+			np.defaultValues[1] = corner / 2 ? 1.0 : 0.0;
+			for (int i = 0; i < 2; i++)
+			{
+				np.minSliders[i] = 0.0;
+				np.maxSliders[i] = 1.0;
+			}
+
+			OP_ParAppendResult res = manager->appendUV(np);
+			assert(res == OP_ParAppendResult::Success);
+		}
+	}
+
+	// Undo the lens distortion of the image outputs
+	{
+		OP_NumericParameter	np;
+
+		np.name = "Undistort";
+		np.label = "Undistort";
+		np.defaultValues[0] = 0.0;
+
+		OP_ParAppendResult res = manager->appendToggle(np);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// Focal length and optical center, in pixels of the whole sensor without
+	// binning, whatever the ROI
+	{
+		OP_NumericParameter	np;
+
+		np.name = "Lensfocal";
+		np.label = "Lens Focal Length";
+		for (int i = 0; i < 2; i++)
+		{
+			np.defaultValues[i] = 520.0;
+			np.minSliders[i] = 100.0;
+			np.maxSliders[i] = 1000.0;
+			np.minValues[i] = 1.0;
+			np.clampMins[i] = true;
+		}
+
+		OP_ParAppendResult res = manager->appendFloat(np, 2);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	{
+		OP_NumericParameter	np;
+
+		np.name = "Lenscenter";
+		np.label = "Lens Center";
+		np.defaultValues[0] = 320.0;
+		np.defaultValues[1] = 240.0;
+		for (int i = 0; i < 2; i++)
+		{
+			np.minSliders[i] = 0.0;
+			np.maxSliders[i] = 640.0;
+		}
+
+		OP_ParAppendResult res = manager->appendXY(np);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// k1, k2 and k3
+	{
+		OP_NumericParameter	np;
+
+		np.name = "Lensradial";
+		np.label = "Lens Radial";
+		for (int i = 0; i < 3; i++)
+		{
+			np.minSliders[i] = -1.0;
+			np.maxSliders[i] = 1.0;
+		}
+
+		OP_ParAppendResult res = manager->appendFloat(np, 3);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// p1 and p2
+	{
+		OP_NumericParameter	np;
+
+		np.name = "Lenstangential";
+		np.label = "Lens Tangential";
+		for (int i = 0; i < 2; i++)
+		{
+			np.minSliders[i] = -0.1;
+			np.maxSliders[i] = 0.1;
+		}
+
+		OP_ParAppendResult res = manager->appendFloat(np, 2);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// Weight of each new frame in the learned background
+	{
+		OP_NumericParameter	np;
+
+		np.name = "Learnrate";
+		np.label = "Learn Rate";
+		np.defaultValues[0] = 0.01;
+
+		np.minSliders[0] = 0.0;
+		np.maxSliders[0] = 0.1;
+
+		np.minValues[0] = 0.0;
+		np.maxValues[0] = 1.0;
+
+		np.clampMins[0] = true;
+		np.clampMaxes[0] = true;
+
+		OP_ParAppendResult res = manager->appendFloat(np);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	{
+		OP_NumericParameter	np;
+
+		np.name = "Learnframes";
+		np.label = "Learn Frames";
+		np.defaultValues[0] = 30.0;
+
+		np.minSliders[0] = 1.0;
+		np.maxSliders[0] = 300.0;
+
+		np.minValues[0] = 1.0;
+		np.maxValues[0] = 10000.0;
+
+		np.clampMins[0] = true;
+		np.clampMaxes[0] = true;
+
+		OP_ParAppendResult res = manager->appendInt(np);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// How far (mm) in front of the background foreground has to be
+	{
+		OP_NumericParameter	np;
+
+		np.name = "Foregrounddistance";
+		np.label = "Foreground Distance";
+		np.defaultValues[0] = 50.0;
+
+		np.minSliders[0] = 0.0;
+		np.maxSliders[0] = 500.0;
 
 		np.minValues[0] = 0.0;
 		np.maxValues[0] = 6000.0;
@@ -492,10 +2230,224 @@ Cpp_Acquisition::setupParameters(OP_ParameterManager* manager, void* reserved1)
 		np.clampMins[0] = true;
 		np.clampMaxes[0] = true;
 
+		OP_ParAppendResult res = manager->appendInt(np);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	{
+		OP_NumericParameter	np;
+
+		np.name = "Foregroundnoise";
+		np.label = "Foreground Noise";
+		np.defaultValues[0] = 3.0;
+
+		np.minSliders[0] = 0.0;
+		np.maxSliders[0] = 10.0;
+
+		np.minValues[0] = 0.0;
+		np.maxValues[0] = 100.0;
+
+		np.clampMins[0] = true;
+		np.clampMaxes[0] = true;
+
+		OP_ParAppendResult res = manager->appendFloat(np);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// Where the blobs in the Info CHOP/DAT come from
+	{
+		OP_StringParameter	sp;
+
+		sp.name = "Blobsource";
+		sp.label = "Blobs";
+		sp.defaultValue = "Off";
+
+		const char* names[] = { "Off", "Foreground", "Depthslice" };
+		const char* labels[] = { "Off", "Foreground", "Near to Far" };
+
+		OP_ParAppendResult res = manager->appendMenu(sp, 3, names, labels);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	{
+		OP_NumericParameter	np;
+
+		np.name = "Blobminarea";
+		np.label = "Blob Min Area";
+		np.defaultValues[0] = 50.0;
+
+		np.minSliders[0] = 1.0;
+		np.maxSliders[0] = 5000.0;
+
+		np.minValues[0] = 1.0;
+		np.maxValues[0] = 307200.0;
+
+		np.clampMins[0] = true;
+		np.clampMaxes[0] = true;
+
+		OP_ParAppendResult res = manager->appendInt(np);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	{
+		OP_NumericParameter	np;
+
+		np.name = "Blobmax";
+		np.label = "Max Blobs";
+		np.defaultValues[0] = 16.0;
+
+		np.minSliders[0] = 1.0;
+		np.maxSliders[0] = 64.0;
+
+		np.minValues[0] = 1.0;
+		np.maxValues[0] = 256.0;
+
+		np.clampMins[0] = true;
+		np.clampMaxes[0] = true;
+
+		OP_ParAppendResult res = manager->appendInt(np);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// Keep blob IDs the same from frame to frame
+	{
+		OP_NumericParameter	np;
+
+		np.name = "Track";
+		np.label = "Track Blobs";
+		np.defaultValues[0] = 0.0;
+
+		OP_ParAppendResult res = manager->appendToggle(np);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	{
+		OP_StringParameter	sp;
+
+		sp.name = "Trackassign";
+		sp.label = "Track Assignment";
+		sp.defaultValue = "Greedy";
+
+		const char* names[] = { "Greedy", "Optimal" };
+		const char* labels[] = { "Greedy", "Optimal" };
+
+		OP_ParAppendResult res = manager->appendMenu(sp, 2, names, labels);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// How far (in u/v) a blob may be from its predicted position
+	{
+		OP_NumericParameter	np;
+
+		np.name = "Trackgate";
+		np.label = "Track Gate";
+		np.defaultValues[0] = 0.05;
+
+		np.minSliders[0] = 0.0;
+		np.maxSliders[0] = 0.25;
+
+		np.minValues[0] = 0.0;
+		np.maxValues[0] = 1.0;
+
+		np.clampMins[0] = true;
+		np.clampMaxes[0] = true;
+
 		OP_ParAppendResult res = manager->appendFloat(np);
 		assert(res == OP_ParAppendResult::Success);
 	}
 
+	// Frames a lost blob keeps its ID
+	{
+		OP_NumericParameter	np;
+
+		np.name = "Trackcoast";
+		np.label = "Track Coast Frames";
+		np.defaultValues[0] = 10.0;
+
+		np.minSliders[0] = 0.0;
+		np.maxSliders[0] = 60.0;
+
+		np.minValues[0] = 0.0;
+		np.maxValues[0] = 1000.0;
+
+		np.clampMins[0] = true;
+		np.clampMaxes[0] = true;
+
+		OP_ParAppendResult res = manager->appendInt(np);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// Min, max, mean, nearest pixel and a histogram of the depth on the
+	// Info CHOP, off by default as it costs a little in the conversion
+	{
+		OP_NumericParameter	np;
+
+		np.name = "Depthstats";
+		np.label = "Depth Statistics";
+		np.defaultValues[0] = 0.0;
+
+		OP_ParAppendResult res = manager->appendToggle(np);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// Output the height above the calibrated floor instead of the depth
+	{
+		OP_NumericParameter	np;
+
+		np.name = "Heightmode";
+		np.label = "Height Above Floor";
+		np.defaultValues[0] = 0.0;
+
+		OP_ParAppendResult res = manager->appendToggle(np);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// The floor plane is kept here, so it survives a restart
+	{
+		OP_StringParameter	sp;
+
+		sp.name = "Floorfile";
+		sp.label = "Floor File";
+		sp.defaultValue = "floor.txt";
+
+		OP_ParAppendResult res = manager->appendFile(sp);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// Fit the floor plane to the next frame
+	{
+		OP_NumericParameter	np;
+
+		np.name = "Calibratefloor";
+		np.label = "Calibrate Floor";
+
+		OP_ParAppendResult res = manager->appendPulse(np);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	// Record the raw camera frames, for use with Cpp_Acquisition_Batch
+	{
+		OP_NumericParameter	np;
+
+		np.name = "Record";
+		np.label = "Record";
+		np.defaultValues[0] = 0.0;
+
+		OP_ParAppendResult res = manager->appendToggle(np);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
+	{
+		OP_StringParameter	sp;
+
+		sp.name = "Recordfile";
+		sp.label = "Record File";
+		sp.defaultValue = "capture.adr";
+
+		OP_ParAppendResult res = manager->appendFile(sp);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
 	// pulse
 	{
 		OP_NumericParameter	np;
@@ -507,6 +2459,17 @@ Cpp_Acquisition::setupParameters(OP_ParameterManager* manager, void* reserved1)
 		assert(res == OP_ParAppendResult::Success);
 	}
 
+	// Learn the background again from the next frames
+	{
+		OP_NumericParameter	np;
+
+		np.name = "Learn";
+		np.label = "Learn";
+
+		OP_ParAppendResult res = manager->appendPulse(np);
+		assert(res == OP_ParAppendResult::Success);
+	}
+
 }
 
 void
@@ -514,6 +2477,18 @@ Cpp_Acquisition::pulsePressed(const char* name, void* reserved1)
 {
 	if (!strcmp(name, "Reset"))
 	{
+		// Picked up by the acquisition thread before the next frame
+		myResetPipeline.store(true);
+	}
+
+	if (!strcmp(name, "Learn"))
+	{
+		myLearnBackground.store(true);
+	}
+
+	if (!strcmp(name, "Calibratefloor"))
+	{
+		myCalibrateFloor.store(true);
 	}
 
 
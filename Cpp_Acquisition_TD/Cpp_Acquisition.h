@@ -13,12 +13,44 @@
 */
 
 #include "TOP_CPlusPlusBase.h"
+#include "CameraControl.h"
+#include "CameraRoi.h"
+#include "CameraTrigger.h"
+#include "GigeTransport.h"
 #include "FrameQueue.h"
+#include "FrameSet.h"
+#include "WorkerPool.h"
+#include "DepthPipeline.h"
+#include "DepthRecording.h"
+#include "FusionGrid.h"
 #include <thread>
 #include <atomic>
+#include <memory>
 #include "stdafx.h"
 #include "ArenaApi.h"
 
+// One camera of the rig. The first one found is the primary camera, which
+// feeds every output; the others only take part in the Fused output.
+struct RigCamera
+{
+	Arena::IDevice*		device = nullptr;
+	std::string			serial;
+	ScanCoordinates		coordinates;
+	// Its live settings, with the nodes looked up when it was opened
+	CameraControl		control;
+	SoftwareTrigger		trigger;
+	// In Triggered mode, whether its trigger went off for the frame being
+	// taken. Always true otherwise.
+	bool				fired = true;
+	// The window of the sensor it streams
+	CameraRoi			roi;
+	TransportMonitor	transport;
+	// From the rig file, cameras without a pose are left out of the fusion
+	bool				hasPose = false;
+	CameraPose			pose;
+	DepthPipeline		pipeline;
+};
+
 class Cpp_Acquisition : public TOP_CPlusPlusBase
 {
 public:
@@ -34,7 +66,7 @@ public:
 		TOP_Context* context,
 		void* reserved1) override;
 
-	virtual void		pImageToTop(const uint8_t* pInput, double startDistance, double endDistance, size_t width, size_t height, size_t srcBpp, float scale, float* pOut);
+	virtual void		pImageToTop(const uint8_t* pInput, const DepthSettings& settings, size_t width, size_t height, size_t srcBpp, const ScanCoordinates& coordinates, float* pOut, size_t outWidth, size_t outHeight);
 
 	virtual int32_t		getNumInfoCHOPChans(void* reserved1) override;
 	virtual void		getInfoCHOPChan(int32_t index,
@@ -54,13 +86,56 @@ public:
 private:
 
 	Arena::ISystem*		pSystem;
-	Arena::IDevice*		pDevice;
+	// The primary camera's current image
 	Arena::IImage*		pImage;
 
-	float				coordinateScale;
+	// Every camera found at startup, the primary one first
+	std::vector<std::unique_ptr<RigCamera>>	myCameras;
 	int					imageTimeout = 2000;
 
 	void				startMoreWork();
+
+	// The camera's next image, or nullptr if none came within imageTimeout.
+	// A missed trigger or a dropped connection would otherwise throw on
+	// the acquisition thread and take TouchDesigner down with it.
+	Arena::IImage*		takeImage(RigCamera& camera);
+
+	// Records the primary camera's current image in pImage, if recording
+	void				recordFrame(const std::string& path, bool record);
+
+	// Opens, switches or closes the raw recording to match the parameters.
+	// Called from the acquisition thread with the current image in pImage.
+	// The frames are written from the recording's own thread.
+	void				updateRecording(const std::string& path, bool record);
+	// Closes the recording, reporting failed writes and dropped frames
+	void				closeRecording();
+
+	// Takes a newly calibrated floor plane into the settings and saves it
+	void				updateFloor(const FloorPlane& floor);
+
+	// Gives each camera its pose from the rig file
+	void				updatePoses(const std::vector<CameraPose>& poses);
+
+	// Programs the ROI, binning and decimation, the GigE transport and the
+	// trigger mode into every camera, restarting their streams
+	void				updateStreams(const CameraRoiSettings& roi, const TransportSettings& transport,
+							TriggerMode trigger);
+
+	// Writes the live settings that changed into every camera
+	void				updateControls(const CameraControlSettings& settings);
+
+	// Plans the cameras' trigger slots and starts firing them, in
+	// Multiplexed mode: every camera's for the Fused output, only the
+	// primary one's otherwise. The sequence has to be stopped before the
+	// streams or the settings change.
+	void				updateSlots(TriggerMode trigger, double guard, bool fused);
+
+	// Grabs a frame from every camera in parallel, or a set of frames taken
+	// at the same time if frameSet asks, and merges them into the
+	// outWidth x outHeight Fused output
+	void				fuseCameras(const DepthSettings& settings, const FrameSetSettings& frameSet,
+							const std::string& recordPath, bool record, float* pOut, size_t outWidth, size_t outHeight);
+
 	// We don't need to store this pointer, but we do for the example.
 	// The OP_NodeInfo class store information about the node that's using
 	// this instance of the class (like its name).
@@ -74,10 +149,86 @@ private:
 	double				myStep;
 	double				mySpeed;
 	double				myBrightness;
-	double				myStartDistance;
-	double				myEndDistance;
-
-	std::size_t			numDevices;
+	DepthSettings		mySettings;
+	bool				myRecord = false;
+	std::string			myRecordPath;
+	// The floor plane in mySettings was loaded from, or will be saved to,
+	// this file
+	std::string			myFloorPath;
+	// The camera poses loaded from this file, myRigVersion goes up each time
+	// they change so the acquisition thread knows to pick them up
+	std::string			myRigPath;
+	std::vector<CameraPose>	myRigPoses;
+	int					myRigVersion;
+	CameraRoiSettings	myRoi;
+	TransportSettings	myTransport;
+	CameraControlSettings	myControl;
+	TriggerMode			myTriggerMode = TriggerMode::FreeRun;
+	// Seconds the triggered frame should be ready before the cook
+	double				myTriggerMargin = 0.002;
+	// Seconds left between the slots of multiplexed cameras
+	double				mySlotGuard = 0.0005;
+	FrameSetSettings	myFrameSet;
+	// When execute() last ran, and the smoothed seconds between its runs
+	TriggerScheduler::Clock::time_point	myLastCook;
+	double				myCookPeriod = 0.0;
+
+	// Only touched by the acquisition thread
+	WorkerPool			myWorkers;
+	DepthRecordingQueue	myRecording;
+	// A recording that couldn't be opened or written isn't tried again
+	// until Record or the path changes
+	std::string			myFailedRecording;
+	FusionGrid			myFusion;
+	TriggerScheduler	myTriggerScheduler;
+	TriggerSequencer	mySequencer;
+	FrameSetAssembler	myFrameSets;
+	std::vector<Arena::IImage*>	myFrameSetImages;
+	std::atomic<bool>	myResetPipeline;
+	std::atomic<bool>	myLearnBackground;
+	std::atomic<bool>	myCalibrateFloor;
+
+	// The acquisition thread copies each frame's blobs, point count, depth
+	// statistics and color range into myPublished*, and execute() copies those into myInfo*
+	// for the Info CHOP/DAT. Either copy is a kilobyte or two, so neither
+	// thread ever waits on the other's processing.
+	std::mutex			myBlobLock;
+	std::vector<Blob>	myPublishedBlobs;
+	std::vector<Blob>	myInfoBlobs;
+	size_t				myPublishedPoints;
+	size_t				myInfoPoints;
+	DepthStats			myPublishedStats;
+	DepthStats			myInfoStats;
+	double				myPublishedStartDistance;
+	double				myPublishedEndDistance;
+	double				myInfoStartDistance;
+	double				myInfoEndDistance;
+	// One per camera, in the order of myCameras
+	std::vector<TransportStats>	myPublishedTransport;
+	std::vector<TransportStats>	myInfoTransport;
+	// In Triggered mode, the seconds from trigger to image, when the last
+	// frame was ready, and how long before the cook that was
+	double				myPublishedLatency = 0.0;
+	TriggerScheduler::Clock::time_point	myPublishedCompletion;
+	double				myInfoLatency = 0.0;
+	double				myInfoSlack = 0.0;
+	// In Multiplexed mode, each camera's slot and the seconds a cycle takes
+	std::vector<TriggerSlot>	myPublishedSlots;
+	std::vector<TriggerSlot>	myInfoSlots;
+	double				myPublishedCycle = 0.0;
+	double				myInfoCycle = 0.0;
+	// With Align Frames on, the last frame set's offsets per camera, its
+	// spread and how many cameras were left out of it
+	std::vector<double>	myPublishedOffsets;
+	std::vector<double>	myInfoOffsets;
+	double				myPublishedSpread = 0.0;
+	double				myInfoSpread = 0.0;
+	size_t				myPublishedDropped = 0;
+	size_t				myInfoDropped = 0;
+	// The primary camera's image size, which the outputs follow. Changes
+	// with the ROI, so it's kept under myBlobLock as well.
+	size_t				myImageWidth;
+	size_t				myImageHeight;
 
 	// Used for threading example
 	// Search for #define THREADING_EXAMPLE to enable that example
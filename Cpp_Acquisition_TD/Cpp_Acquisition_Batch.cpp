@@ -0,0 +1,854 @@
+// Cpp_Acquisition_Batch
+//
+// Runs recorded captures (see the Record parameter on the TOP) through the
+// same DepthPipeline the TOP uses, as fast as the machine allows.
+// Frames are independent, so they are handed out to one worker per core.
+// The temporal filter makes each frame depend on the previous ones, so with
+// it enabled frames are processed in order on a single pipeline instead,
+// which then splits each frame over all cores.
+//
+// Usage:
+//   Cpp_Acquisition_Batch <input.adr> <output> [options]
+//   Cpp_Acquisition_Batch <input.adr> --bench
+//
+//   --bench times every specialization of the row conversion kernels on
+//   the first frame of the input, on one thread, and checks that each
+//   gives the same result as the scalar one. It then times writing the
+//   color and mask outputs with ordinary and with streaming stores, and
+//   resampling the depth to the Half and Quarter previews.
+//
+//   <output> is either a .adr file, which gets the converted RGBA32Float
+//   frames, or a printf style pattern such as renders/depth_%05d.tif, which
+//   writes one 32 bit float RGBA TIFF per frame.
+//
+// Options:
+//   --near <mm>       Near distance, as the Near parameter (default 0)
+//   --far <mm>        Far distance, as the Far parameter (default 6000)
+//   --threads <n>     Number of worker threads (default: all cores)
+//   --temporal <mode> off, average or median (default off)
+//   --weight <w>      Moving average weight, as Average Weight (default 0.3)
+//   --reset <mm>      Moving average reset, as Average Reset (default 100)
+//   --median <n>      Median frames, 3 or 5 (default 3)
+//   --intensity <n>   Min Intensity (default 0)
+//   --flying <mm>     Flying Pixel Threshold (default 0, off)
+//   --holes <mode>    off, nearest or pushpull (default off)
+//   --holesize <px>   Hole Size (default 16)
+//   --spatial <mode>  off, median3, median5 or bilateral (default off)
+//   --range <mm>      Bilateral range, as Bilateral Range (default 50)
+//   --output <mode>   color, mask, foreground, heightmap or points (default
+//                     color)
+//   --resolution <r>  Output Resolution of the image outputs, camera, half
+//                     or quarter (default camera)
+//   --size <w> <h>    Custom output resolution, after any rotation
+//   --resample <f>    box, bilinear or nearest (default box)
+//   --mapres <w> <h>  Heightmap resolution (default 512 512)
+//   --mapcenter <x> <y> Heightmap center on the floor in mm (default 0 2000)
+//   --mapsize <x> <y> Heightmap size on the floor in mm (default 4000 4000)
+//   --orientation <mode> none, rotate90, rotate180, rotate270, fliph or
+//                     flipv (default none)
+//   --cornerpin <8 values> u v of the bottom left, bottom right, top left
+//                     and top right corners (default 0 0 1 0 0 1 1 1)
+//   --lens <9 values> Undistort with fx fy cx cy k1 k2 k3 p1 p2
+//   --learnrate <r>   Learn Rate (default 0.01)
+//   --learnframes <n> Learn Frames (default 30)
+//   --fgdist <mm>     Foreground Distance (default 50)
+//   --fgnoise <n>     Foreground Noise (default 3)
+//   --floor <file>    Output the height above the floor plane in the file
+//   --calibrate <file> Fit the floor plane to the first frame, save it to
+//                     the file and output heights above it
+//   --stats           Print each frame's depth statistics
+//   --autorange <near%> <far%> Pick Near and Far from these percentiles
+//                     of the depth, as Auto Range
+//   --colormap <map>  classic, gray, inverted, turbo or viridis (default
+//                     classic)
+//   --gradient <file> Custom colormap, a line per stop of position r g b [a]
+
+#include "stdafx.h"
+#include "DepthPipeline.h"
+#include "DepthRecording.h"
+#include "DepthRowKernels.h"
+#include "FileIo.h"
+#include "WorkerPool.h"
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct BatchOptions
+{
+	std::string		input;
+	std::string		output;
+	DepthSettings	settings;
+	unsigned		numThreads = 0;
+	std::string		floorPath;
+	bool			calibrateFloor = false;
+	std::string		gradientPath;
+	bool			bench = false;
+};
+
+static void
+printUsage()
+{
+	printf("Usage: Cpp_Acquisition_Batch <input.adr> <output.adr | pattern_%%05d.tif> [options]\n"
+		"       Cpp_Acquisition_Batch <input.adr> --bench\n"
+		"  --near <mm>       Near distance (default 0)\n"
+		"  --far <mm>        Far distance (default 6000)\n"
+		"  --threads <n>     Worker threads (default: all cores)\n"
+		"  --temporal <mode> off, average or median (default off)\n"
+		"  --weight <w>      Moving average weight (default 0.3)\n"
+		"  --reset <mm>      Moving average reset threshold (default 100)\n"
+		"  --median <n>      Median frames, 3 or 5 (default 3)\n"
+		"  --intensity <n>   Minimum intensity (default 0)\n"
+		"  --flying <mm>     Flying pixel threshold (default 0, off)\n"
+		"  --holes <mode>    off, nearest or pushpull (default off)\n"
+		"  --holesize <px>   Largest hole to fill (default 16)\n"
+		"  --spatial <mode>  off, median3, median5 or bilateral (default off)\n"
+		"  --range <mm>      Bilateral range (default 50)\n"
+		"  --output <mode>   color, mask, foreground, heightmap or points (default color)\n"
+		"  --resolution <r>  camera, half or quarter (default camera)\n"
+		"  --size <w> <h>    Custom output resolution, after any rotation\n"
+		"  --resample <f>    box, bilinear or nearest (default box)\n"
+		"  --mapres <w> <h>  Heightmap resolution (default 512 512)\n"
+		"  --mapcenter <x> <y> Heightmap center on the floor in mm (default 0 2000)\n"
+		"  --mapsize <x> <y> Heightmap size on the floor in mm (default 4000 4000)\n"
+		"  --orientation <mode> none, rotate90, rotate180, rotate270, fliph or flipv\n"
+		"  --cornerpin <8 values> u v of the bottom left, bottom right, top left and\n"
+		"                    top right corners (default 0 0 1 0 0 1 1 1)\n"
+		"  --lens <9 values> Undistort with fx fy cx cy k1 k2 k3 p1 p2\n"
+		"  --learnrate <r>   Background learn rate (default 0.01)\n"
+		"  --learnframes <n> Frames averaged into the first background (default 30)\n"
+		"  --fgdist <mm>     Minimum distance in front of the background (default 50)\n"
+		"  --fgnoise <n>     Background deviations for foreground (default 3)\n"
+		"  --floor <file>    Output heights above the floor plane saved in the file\n"
+		"  --calibrate <file> Fit the floor to the first frame and save it to the file\n"
+		"  --stats           Print each frame's depth statistics\n"
+		"  --autorange <near%%> <far%%> Pick Near and Far from percentiles of the depth\n"
+		"  --colormap <map>  classic, gray, inverted, turbo or viridis (default classic)\n"
+		"  --gradient <file> Custom colormap, a line per stop of position r g b [a]\n");
+}
+
+static bool
+parseArguments(int argc, char* argv[], BatchOptions* options)
+{
+	std::vector<std::string> positional;
+
+	for (int i = 1; i < argc; i++)
+	{
+		const std::string arg = argv[i];
+		const bool hasValue = i + 1 < argc;
+
+		if (arg == "--near" && hasValue)
+			options->settings.startDistance = atof(argv[++i]);
+		else if (arg == "--far" && hasValue)
+			options->settings.endDistance = atof(argv[++i]);
+		else if (arg == "--threads" && hasValue)
+			options->numThreads = (unsigned)atoi(argv[++i]);
+		else if (arg == "--temporal" && hasValue)
+		{
+			const std::string mode = argv[++i];
+			if (mode == "off")
+				options->settings.temporal.mode = TemporalFilterMode::Off;
+			else if (mode == "average")
+				options->settings.temporal.mode = TemporalFilterMode::Average;
+			else if (mode == "median")
+				options->settings.temporal.mode = TemporalFilterMode::Median;
+			else
+				return false;
+		}
+		else if (arg == "--intensity" && hasValue)
+			options->settings.validity.minIntensity = atoi(argv[++i]);
+		else if (arg == "--flying" && hasValue)
+			options->settings.validity.flyingThreshold = atoi(argv[++i]);
+		else if (arg == "--holes" && hasValue)
+		{
+			const std::string mode = argv[++i];
+			if (mode == "off")
+				options->settings.holes.mode = HoleFillMode::Off;
+			else if (mode == "nearest")
+				options->settings.holes.mode = HoleFillMode::Nearest;
+			else if (mode == "pushpull")
+				options->settings.holes.mode = HoleFillMode::PushPull;
+			else
+				return false;
+		}
+		else if (arg == "--holesize" && hasValue)
+			options->settings.holes.maxSize = atoi(argv[++i]);
+		else if (arg == "--spatial" && hasValue)
+		{
+			const std::string mode = argv[++i];
+			if (mode == "off")
+				options->settings.spatial.mode = SpatialFilterMode::Off;
+			else if (mode == "median3")
+				options->settings.spatial.mode = SpatialFilterMode::Median3x3;
+			else if (mode == "median5")
+				options->settings.spatial.mode = SpatialFilterMode::Median5x5;
+			else if (mode == "bilateral")
+				options->settings.spatial.mode = SpatialFilterMode::Bilateral;
+			else
+				return false;
+		}
+		else if (arg == "--range" && hasValue)
+			options->settings.spatial.rangeSigma = atof(argv[++i]);
+		else if (arg == "--output" && hasValue)
+		{
+			const std::string mode = argv[++i];
+			if (mode == "color")
+				options->settings.output = DepthOutputMode::Color;
+			else if (mode == "mask")
+				options->settings.output = DepthOutputMode::ForegroundMask;
+			else if (mode == "foreground")
+				options->settings.output = DepthOutputMode::ForegroundDepth;
+			else if (mode == "heightmap")
+				options->settings.output = DepthOutputMode::Heightmap;
+			else if (mode == "points")
+				options->settings.output = DepthOutputMode::PointCloud;
+			else
+				return false;
+		}
+		else if (arg == "--resolution" && hasValue)
+		{
+			const std::string mode = argv[++i];
+			if (mode == "camera")
+				options->settings.resample.resolution = OutputResolution::Camera;
+			else if (mode == "half")
+				options->settings.resample.resolution = OutputResolution::Half;
+			else if (mode == "quarter")
+				options->settings.resample.resolution = OutputResolution::Quarter;
+			else
+				return false;
+		}
+		else if (arg == "--size" && i + 2 < argc)
+		{
+			options->settings.resample.resolution = OutputResolution::Custom;
+			options->settings.resample.width = atoi(argv[++i]);
+			options->settings.resample.height = atoi(argv[++i]);
+			if (options->settings.resample.width <= 0 || options->settings.resample.height <= 0)
+				return false;
+		}
+		else if (arg == "--resample" && hasValue)
+		{
+			const std::string filter = argv[++i];
+			if (filter == "box")
+				options->settings.resample.filter = ResampleFilter::Box;
+			else if (filter == "bilinear")
+				options->settings.resample.filter = ResampleFilter::Bilinear;
+			else if (filter == "nearest")
+				options->settings.resample.filter = ResampleFilter::Nearest;
+			else
+				return false;
+		}
+		else if (arg == "--mapres" && i + 2 < argc)
+		{
+			options->settings.heightmap.width = atoi(argv[++i]);
+			options->settings.heightmap.height = atoi(argv[++i]);
+			if (options->settings.heightmap.width <= 0 || options->settings.heightmap.height <= 0)
+				return false;
+		}
+		else if (arg == "--mapcenter" && i + 2 < argc)
+		{
+			options->settings.heightmap.centerX = atof(argv[++i]);
+			options->settings.heightmap.centerY = atof(argv[++i]);
+		}
+		else if (arg == "--mapsize" && i + 2 < argc)
+		{
+			options->settings.heightmap.sizeX = atof(argv[++i]);
+			options->settings.heightmap.sizeY = atof(argv[++i]);
+		}
+		else if (arg == "--orientation" && hasValue)
+		{
+			const std::string mode = argv[++i];
+			RemapOrientation& orientation = options->settings.remap.orientation;
+			if (mode == "none")
+				orientation = RemapOrientation::None;
+			else if (mode == "rotate90")
+				orientation = RemapOrientation::Rotate90;
+			else if (mode == "rotate180")
+				orientation = RemapOrientation::Rotate180;
+			else if (mode == "rotate270")
+				orientation = RemapOrientation::Rotate270;
+			else if (mode == "fliph")
+				orientation = RemapOrientation::FlipHorizontal;
+			else if (mode == "flipv")
+				orientation = RemapOrientation::FlipVertical;
+			else
+				return false;
+		}
+		else if (arg == "--cornerpin" && i + 8 < argc)
+		{
+			for (int c = 0; c < 8; c++)
+				options->settings.remap.corners[c] = atof(argv[++i]);
+		}
+		else if (arg == "--lens" && i + 9 < argc)
+		{
+			RemapSettings& remap = options->settings.remap;
+			remap.undistort = true;
+			remap.focalX = atof(argv[++i]);
+			remap.focalY = atof(argv[++i]);
+			remap.centerX = atof(argv[++i]);
+			remap.centerY = atof(argv[++i]);
+			for (int c = 0; c < 3; c++)
+				remap.radial[c] = atof(argv[++i]);
+			for (int c = 0; c < 2; c++)
+				remap.tangential[c] = atof(argv[++i]);
+		}
+		else if (arg == "--learnrate" && hasValue)
+			options->settings.background.learnRate = atof(argv[++i]);
+		else if (arg == "--learnframes" && hasValue)
+			options->settings.background.learnFrames = atoi(argv[++i]);
+		else if (arg == "--fgdist" && hasValue)
+			options->settings.background.minDistance = atoi(argv[++i]);
+		else if (arg == "--fgnoise" && hasValue)
+			options->settings.background.deviations = atof(argv[++i]);
+		else if (arg == "--floor" && hasValue)
+		{
+			options->floorPath = argv[++i];
+			options->settings.heightAboveFloor = true;
+		}
+		else if (arg == "--calibrate" && hasValue)
+		{
+			options->floorPath = argv[++i];
+			options->calibrateFloor = true;
+			options->settings.heightAboveFloor = true;
+		}
+		else if (arg == "--colormap" && hasValue)
+		{
+			const std::string map = argv[++i];
+			if (map == "classic")
+				options->settings.colormap.type = ColormapType::Classic;
+			else if (map == "gray")
+				options->settings.colormap.type = ColormapType::Grayscale;
+			else if (map == "inverted")
+				options->settings.colormap.type = ColormapType::InvertedGrayscale;
+			else if (map == "turbo")
+				options->settings.colormap.type = ColormapType::Turbo;
+			else if (map == "viridis")
+				options->settings.colormap.type = ColormapType::Viridis;
+			else
+				return false;
+		}
+		else if (arg == "--gradient" && hasValue)
+		{
+			options->settings.colormap.type = ColormapType::Custom;
+			options->gradientPath = argv[++i];
+		}
+		else if (arg == "--bench")
+			options->bench = true;
+		else if (arg == "--stats")
+			options->settings.stats = true;
+		else if (arg == "--autorange" && i + 2 < argc)
+		{
+			options->settings.autoRange.enabled = true;
+			options->settings.autoRange.nearPercentile = atof(argv[++i]);
+			options->settings.autoRange.farPercentile = atof(argv[++i]);
+		}
+		else if (arg == "--weight" && hasValue)
+			options->settings.temporal.alpha = atof(argv[++i]);
+		else if (arg == "--reset" && hasValue)
+			options->settings.temporal.resetThreshold = atoi(argv[++i]);
+		else if (arg == "--median" && hasValue)
+			options->settings.temporal.medianFrames = atoi(argv[++i]);
+		else if (arg.compare(0, 2, "--") == 0)
+			return false;
+		else
+			positional.push_back(arg);
+	}
+
+	if (positional.size() != (options->bench ? 1 : 2))
+		return false;
+
+	options->input = positional[0];
+	if (!options->bench)
+		options->output = positional[1];
+	return true;
+}
+
+static bool
+endsWith(const std::string& str, const char* suffix)
+{
+	const size_t len = strlen(suffix);
+	return str.size() >= len && str.compare(str.size() - len, len, suffix) == 0;
+}
+
+// The output pattern goes to snprintf as the format, so it may hold a
+// single integer conversion for the frame number, such as %05d, and no
+// other % than %%.
+static bool
+isFramePattern(const std::string& pattern)
+{
+	int numConversions = 0;
+	for (size_t i = 0; i < pattern.size(); i++)
+	{
+		if (pattern[i] != '%')
+			continue;
+		if (++i < pattern.size() && pattern[i] == '%')
+			continue;
+		while (i < pattern.size() && strchr("-+ #0", pattern[i]))
+			i++;
+		while (i < pattern.size() && isdigit((unsigned char)pattern[i]))
+			i++;
+		if (i < pattern.size() && pattern[i] == '.')
+		{
+			i++;
+			while (i < pattern.size() && isdigit((unsigned char)pattern[i]))
+				i++;
+		}
+		if (i >= pattern.size() || pattern[i] != 'd')
+			return false;
+		numConversions++;
+	}
+	return numConversions == 1;
+}
+
+static void
+putShort(std::vector<uint8_t>& out, uint16_t v)
+{
+	out.push_back(uint8_t(v & 0xff));
+	out.push_back(uint8_t(v >> 8));
+}
+
+static void
+putLong(std::vector<uint8_t>& out, uint32_t v)
+{
+	for (int i = 0; i < 4; i++)
+		out.push_back(uint8_t((v >> (8 * i)) & 0xff));
+}
+
+static void
+putEntry(std::vector<uint8_t>& out, uint16_t tag, uint16_t type, uint32_t count, uint32_t value)
+{
+	putShort(out, tag);
+	putShort(out, type);
+	putLong(out, count);
+	if (type == 3 && count == 1)
+	{
+		putShort(out, uint16_t(value));
+		putShort(out, 0);
+	}
+	else
+	{
+		putLong(out, value);
+	}
+}
+
+// Writes an uncompressed 32 bit float RGBA TIFF, which TouchDesigner's
+// Movie File In TOP reads without any loss. The kernels write rows bottom-up
+// for TouchDesigner, so they're flipped back here to keep the file upright.
+static bool
+writeFloatTiff(const char* path, const float* pixels, uint32_t width, uint32_t height)
+{
+	const uint32_t ShortType = 3;
+	const uint32_t LongType = 4;
+	const uint32_t NumEntries = 12;
+	const uint32_t rowBytes = width * 4 * sizeof(float);
+
+	// Header, then the IFD, then the two 4-value arrays the IFD points at,
+	// then the pixel data.
+	const uint32_t ifdOffset = 8;
+	const uint32_t bitsOffset = ifdOffset + 2 + NumEntries * 12 + 4;
+	const uint32_t formatOffset = bitsOffset + 8;
+	const uint32_t dataOffset = formatOffset + 8;
+
+	std::vector<uint8_t> head;
+	head.push_back('I');
+	head.push_back('I');
+	putShort(head, 42);
+	putLong(head, ifdOffset);
+
+	putShort(head, uint16_t(NumEntries));
+	putEntry(head, 256, LongType, 1, width);				// ImageWidth
+	putEntry(head, 257, LongType, 1, height);				// ImageLength
+	putEntry(head, 258, ShortType, 4, bitsOffset);			// BitsPerSample
+	putEntry(head, 259, ShortType, 1, 1);					// Compression: none
+	putEntry(head, 262, ShortType, 1, 2);					// Photometric: RGB
+	putEntry(head, 273, LongType, 1, dataOffset);			// StripOffsets
+	putEntry(head, 277, ShortType, 1, 4);					// SamplesPerPixel
+	putEntry(head, 278, LongType, 1, height);				// RowsPerStrip
+	putEntry(head, 279, LongType, 1, rowBytes * height);	// StripByteCounts
+	putEntry(head, 284, ShortType, 1, 1);					// PlanarConfiguration: chunky
+	putEntry(head, 338, ShortType, 1, 2);					// ExtraSamples: unassociated alpha
+	putEntry(head, 339, ShortType, 4, formatOffset);		// SampleFormat
+	putLong(head, 0);
+
+	for (int i = 0; i < 4; i++)
+		putShort(head, 32);
+	for (int i = 0; i < 4; i++)
+		putShort(head, 3);	// IEEE floating point
+
+	FILE* file = openFile(path, "wb");
+	if (!file)
+		return false;
+
+	bool ok = fwrite(head.data(), head.size(), 1, file) == 1;
+	for (uint32_t y = 0; ok && y < height; y++)
+	{
+		const float* row = pixels + (size_t)(height - y - 1) * width * 4;
+		ok = fwrite(row, rowBytes, 1, file) == 1;
+	}
+	fclose(file);
+	return ok;
+}
+
+// Times one row kernel over a whole frame, returning ms per frame
+static double
+timeRowKernel(DepthRowKernel kernel, const uint8_t* raw, uint32_t width, uint32_t height, size_t srcPixelSize,
+	const DepthRowParams& params, int16_t* pOut)
+{
+	const int Iterations = 200;
+	const auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < Iterations; i++)
+	{
+		for (uint32_t y = 0; y < height; y++)
+			kernel(raw + (size_t)y * width * srcPixelSize, width, srcPixelSize, params, pOut + (size_t)y * width);
+	}
+	const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	return seconds * 1000.0 / Iterations;
+}
+
+// Times writing the color (or, without a colormap, the mask) output of a
+// frame with the given stores, returning ms per frame
+static double
+timeOutput(const int16_t* pDepth, const uint8_t* pMask, const DepthColormap* colormap, uint32_t width,
+	uint32_t height, OutputStores stores, float* pOut)
+{
+	const int Iterations = 200;
+	const auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < Iterations; i++)
+	{
+		if (colormap)
+			depthToColor(pDepth, *colormap, width, height, pOut, stores);
+		else
+			maskToColor(pMask, width, height, pOut, stores);
+	}
+	const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	return seconds * 1000.0 / Iterations;
+}
+
+// Times resampling a frame's depth, returning ms per frame
+static double
+timeResample(const Resampler& resampler, const int16_t* pDepth, ResampleFilter filter, int16_t* pOut)
+{
+	const int Iterations = 200;
+	const auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < Iterations; i++)
+		resampler.depth(pDepth, filter, pOut, nullptr);
+	const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	return seconds * 1000.0 / Iterations;
+}
+
+static int
+runBenchmark(DepthRecordingReader& reader, const BatchOptions& options)
+{
+	const DepthRecordingHeader& header = reader.header();
+	const uint32_t width = header.width;
+	const uint32_t height = header.height;
+	const size_t srcPixelSize = header.bitsPerPixel / 8;
+
+	std::vector<uint8_t> raw(reader.frameSize());
+	if (header.frameCount == 0 || !reader.readFrame(0, raw.data(), nullptr))
+	{
+		fprintf(stderr, "Unable to read the first frame\n");
+		return 1;
+	}
+
+	// The floor and intensity given, or something that makes the kernels
+	// do their work: a floor 1.5 m below a camera tilted down by 30 degrees
+	DepthRowParams params;
+	params.coordinates = scanCoordinates(header);
+	params.minIntensity = options.settings.validity.minIntensity > 0 ? options.settings.validity.minIntensity : 100;
+	if (options.settings.floor.valid)
+	{
+		params.floor = options.settings.floor;
+	}
+	else
+	{
+		params.floor.valid = true;
+		params.floor.normal[0] = 0.0f;
+		params.floor.normal[1] = -0.866f;
+		params.floor.normal[2] = 0.5f;
+		params.floor.distance = 1500.0f;
+	}
+
+	const SimdLevel detected = detectSimdLevel();
+	printf("%ux%u, CPU supports %s\n", width, height, simdLevelName(detected));
+	printf("%-8s %-7s %-10s %10s %10s  %s\n", "simd", "output", "intensity", "ms/frame", "Mpixel/s", "result");
+
+	std::vector<int16_t> reference((size_t)width * height);
+	std::vector<int16_t> result((size_t)width * height);
+	bool allOk = true;
+	for (int height16 = 0; height16 < 2; height16++)
+	{
+		for (int intensity = 0; intensity < 2; intensity++)
+		{
+			DepthRowKernelKey key;
+			key.height = height16 != 0;
+			key.intensity = intensity != 0;
+
+			for (int level = 0; level < int(SimdLevel::Count); level++)
+			{
+				key.simd = SimdLevel(level);
+				const char* output = key.height ? "height" : "depth";
+				const char* check = key.intensity ? "on" : "off";
+				const DepthRowKernel kernel = depthRowKernel(key);
+				if (!kernel || key.simd > detected || (key.simd != SimdLevel::Scalar && srcPixelSize != 8))
+				{
+					printf("%-8s %-7s %-10s %10s %10s  not available\n", simdLevelName(key.simd), output, check, "-", "-");
+					continue;
+				}
+
+				int16_t* pOut = key.simd == SimdLevel::Scalar ? reference.data() : result.data();
+				const double ms = timeRowKernel(kernel, raw.data(), width, height, srcPixelSize, params, pOut);
+				const bool ok = key.simd == SimdLevel::Scalar || result == reference;
+				allOk = allOk && ok;
+				printf("%-8s %-7s %-10s %10.3f %10.1f  %s\n", simdLevelName(key.simd), output, check, ms,
+					double(width) * height / (ms * 1000.0), key.simd == SimdLevel::Scalar ? "reference" : ok ? "matches" : "DIFFERS");
+			}
+		}
+	}
+
+	// The output stores, on the depth and slice of the same frame
+	DepthValiditySettings validity;
+	extractDepth(raw.data(), width, height, 0, height, header.bitsPerPixel, params.coordinates, validity,
+		nullptr, reference.data());
+	std::vector<uint8_t> mask((size_t)width * height);
+	depthSliceMask(reference.data(), mask.size(), 500.0, 3000.0, mask.data());
+
+	DepthColormap colormap;
+	colormap.update(ColormapSettings(), 0.0, 6000.0);
+
+	AlignedBuffer<float> cached;
+	AlignedBuffer<float> streamed;
+	cached.resize((size_t)width * height * 4);
+	streamed.resize((size_t)width * height * 4);
+
+	printf("\n%-8s %10s %10s %10s  %s\n", "output", "cached", "streaming", "speedup", "result");
+	for (int output = 0; output < 2; output++)
+	{
+		const DepthColormap* map = output == 0 ? &colormap : nullptr;
+		const double cachedMs = timeOutput(reference.data(), mask.data(), map, width, height,
+			OutputStores::Cached, cached.data());
+		const double streamedMs = timeOutput(reference.data(), mask.data(), map, width, height,
+			OutputStores::Streaming, streamed.data());
+		const bool ok = memcmp(cached.data(), streamed.data(), cached.size() * sizeof(float)) == 0;
+		allOk = allOk && ok;
+		printf("%-8s %10.3f %10.3f %9.2fx  %s\n", output == 0 ? "color" : "mask", cachedMs, streamedMs,
+			cachedMs / streamedMs, ok ? "matches" : "DIFFERS");
+	}
+
+	// Resampling the same depth to the previews
+	printf("\n%-8s %-10s %-9s %10s\n", "preview", "size", "filter", "ms/frame");
+	const char* filterNames[] = { "box", "bilinear", "nearest" };
+	for (int preview = 0; preview < 2; preview++)
+	{
+		ResampleSettings resample;
+		resample.resolution = preview == 0 ? OutputResolution::Half : OutputResolution::Quarter;
+		size_t previewWidth;
+		size_t previewHeight;
+		resample.imageSize(width, height, false, &previewWidth, &previewHeight);
+
+		Resampler resampler;
+		resampler.update(width, height, previewWidth, previewHeight);
+		char size[32];
+		snprintf(size, sizeof(size), "%zux%zu", previewWidth, previewHeight);
+		for (int filter = 0; filter < 3; filter++)
+		{
+			const double ms = timeResample(resampler, reference.data(), ResampleFilter(filter), result.data());
+			printf("%-8s %-10s %-9s %10.3f\n", preview == 0 ? "half" : "quarter", size, filterNames[filter], ms);
+		}
+	}
+	return allOk ? 0 : 1;
+}
+
+int
+main(int argc, char* argv[])
+{
+	BatchOptions options;
+	if (!parseArguments(argc, argv, &options))
+	{
+		printUsage();
+		return 1;
+	}
+
+	DepthRecordingReader reader;
+	if (!reader.open(options.input.c_str()))
+	{
+		fprintf(stderr, "Unable to open recording %s\n", options.input.c_str());
+		return 1;
+	}
+
+	const DepthRecordingHeader& header = reader.header();
+	if (header.format != DepthRecordingFormat::ABCY16)
+	{
+		fprintf(stderr, "%s does not contain raw ABCY16 frames\n", options.input.c_str());
+		return 1;
+	}
+
+	if (options.bench)
+		return runBenchmark(reader, options);
+
+	const uint32_t width = header.width;
+	const uint32_t height = header.height;
+	const uint32_t numFrames = header.frameCount;
+
+	size_t outSize[2];
+	options.settings.outputSize(width, height, &outSize[0], &outSize[1]);
+	const uint32_t outWidth = uint32_t(outSize[0]);
+	const uint32_t outHeight = uint32_t(outSize[1]);
+
+	if (options.calibrateFloor)
+	{
+		std::vector<uint8_t> raw(reader.frameSize());
+		std::vector<float> points;
+		if (numFrames == 0 || !reader.readFrame(0, raw.data(), nullptr))
+		{
+			fprintf(stderr, "Unable to read the first frame for the floor\n");
+			return 1;
+		}
+		extractPoints(raw.data(), width, height, header.bitsPerPixel, scanCoordinates(header), 4, points);
+		options.settings.floor = FloorCalibrator::fit(points);
+		if (!options.settings.floor.valid)
+		{
+			fprintf(stderr, "Unable to find the floor plane\n");
+			return 1;
+		}
+		if (!saveFloorPlane(options.floorPath.c_str(), options.settings.floor))
+			fprintf(stderr, "Unable to save the floor plane to %s\n", options.floorPath.c_str());
+	}
+	else if (!options.floorPath.empty() &&
+		!loadFloorPlane(options.floorPath.c_str(), &options.settings.floor))
+	{
+		fprintf(stderr, "Unable to read the floor plane from %s\n", options.floorPath.c_str());
+		return 1;
+	}
+
+	if (!options.gradientPath.empty() &&
+		!loadColorStops(options.gradientPath.c_str(), &options.settings.colormap.stops))
+	{
+		fprintf(stderr, "Unable to read the gradient from %s\n", options.gradientPath.c_str());
+		return 1;
+	}
+
+	const bool toContainer = endsWith(options.output, ".adr");
+	DepthRecordingWriter writer;
+	if (toContainer)
+	{
+		DepthRecordingHeader outHeader;
+		initDepthRecordingHeader(&outHeader, DepthRecordingFormat::RGBA32Float,
+			outWidth, outHeight, 4 * 32, scanCoordinates(header));
+		if (!writer.open(options.output.c_str(), outHeader))
+		{
+			fprintf(stderr, "Unable to create %s\n", options.output.c_str());
+			return 1;
+		}
+	}
+	else if (!isFramePattern(options.output))
+	{
+		fprintf(stderr, "Output must be a .adr file or contain one frame number pattern such as %%05d\n");
+		return 1;
+	}
+
+	unsigned numThreads = options.numThreads;
+	if (numThreads == 0)
+		numThreads = std::max(1u, std::thread::hardware_concurrency());
+	numThreads = std::min(numThreads, std::max(1u, numFrames));
+	// Frames that must go in order get the cores through the pipeline's pool
+	const bool inOrder = options.settings.isStateful();
+	WorkerPool pool(inOrder ? int(numThreads) - 1 : 0);
+	if (inOrder)
+		numThreads = 1;
+
+	printf("%u frames of %ux%u, %u threads\n", numFrames, width, height, numThreads);
+
+	std::atomic<uint32_t>	nextFrame(0);
+	std::atomic<uint32_t>	numFailed(0);
+	uint64_t				firstTimestamp = 0;
+	uint64_t				lastTimestamp = 0;
+
+	const auto start = std::chrono::steady_clock::now();
+
+	std::vector<std::thread> workers;
+	for (unsigned t = 0; t < numThreads; t++)
+	{
+		workers.emplace_back([&]()
+		{
+			DepthPipeline pipeline;
+			pipeline.setWorkerPool(&pool);
+			std::vector<uint8_t> raw(reader.frameSize());
+			std::vector<float> rgba((size_t)outWidth * outHeight * 4);
+
+			for (uint32_t i = nextFrame++; i < numFrames; i = nextFrame++)
+			{
+				uint64_t timestamp = 0;
+				if (!reader.readFrame(i, raw.data(), &timestamp))
+				{
+					numFailed++;
+					continue;
+				}
+
+				if (i == 0)
+					firstTimestamp = timestamp;
+				if (i == numFrames - 1)
+					lastTimestamp = timestamp;
+
+				pipeline.process(raw.data(), width, height, header.bitsPerPixel,
+					scanCoordinates(header), options.settings, rgba.data(), outWidth, outHeight);
+
+				if (options.settings.stats)
+				{
+					const DepthStats& stats = pipeline.stats();
+					printf("Frame %u: %zu valid, %d to %d mm, mean %.1f mm, nearest at %d,%d, colored %.0f to %.0f mm\n", i,
+						stats.validCount, stats.minDepth, stats.maxDepth, stats.mean(), stats.nearestX, stats.nearestY,
+						pipeline.startDistance(), pipeline.endDistance());
+				}
+
+				bool ok;
+				if (toContainer)
+				{
+					ok = writer.writeFrame(i, rgba.data(), timestamp);
+				}
+				else
+				{
+					char path[4096];
+					snprintf(path, sizeof(path), options.output.c_str(), int(i));
+					ok = writeFloatTiff(path, rgba.data(), outWidth, outHeight);
+				}
+
+				if (!ok)
+					numFailed++;
+			}
+		});
+	}
+
+	for (auto& worker : workers)
+		worker.join();
+
+	const bool closed = writer.close();
+
+	const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	printf("Converted %u frames in %.3f s (%.1f fps)", numFrames - numFailed.load(), seconds,
+		seconds > 0.0 ? numFrames / seconds : 0.0);
+
+	// Device timestamps are in nanoseconds, so this tells how much faster
+	// than the camera delivered them the frames were processed.
+	if (lastTimestamp > firstTimestamp && seconds > 0.0)
+		printf(", %.1fx real time", (lastTimestamp - firstTimestamp) * 1e-9 / seconds);
+	printf("\n");
+
+	if (!closed)
+	{
+		fprintf(stderr, "Unable to finish writing %s\n", options.output.c_str());
+		return 1;
+	}
+	if (numFailed > 0)
+	{
+		fprintf(stderr, "%u frames failed\n", numFailed.load());
+		return 1;
+	}
+	return 0;
+}
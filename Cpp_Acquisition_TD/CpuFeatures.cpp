@@ -0,0 +1,85 @@
+#include "stdafx.h"
+#include "CpuFeatures.h"
+#include "Simd.h"
+
+#ifdef DEPTH_SSE2
+#ifdef _WIN32
+#include <intrin.h>
+#else // macOS
+#include <cpuid.h>
+#endif
+#endif
+
+const char*
+simdLevelName(SimdLevel level)
+{
+	switch (level)
+	{
+		case SimdLevel::Scalar: return "scalar";
+		case SimdLevel::SSE2: return "sse2";
+		case SimdLevel::AVX2: return "avx2";
+		default: return "unknown";
+	}
+}
+
+#ifdef DEPTH_SSE2
+static void
+cpuid(int leaf, int subleaf, unsigned regs[4])
+{
+#ifdef _WIN32
+	int r[4];
+	__cpuidex(r, leaf, subleaf);
+	for (int i = 0; i < 4; i++)
+		regs[i] = unsigned(r[i]);
+#else // macOS
+	__cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+}
+
+// Which register states the OS saves on a context switch
+static uint64_t
+xgetbv0()
+{
+#ifdef _WIN32
+	return _xgetbv(0);
+#else // macOS
+	unsigned lo, hi;
+	__asm__ volatile("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+	return (uint64_t(hi) << 32) | lo;
+#endif
+}
+
+static SimdLevel
+querySimdLevel()
+{
+	unsigned regs[4];
+	cpuid(0, 0, regs);
+	const unsigned maxLeaf = regs[0];
+
+	cpuid(1, 0, regs);
+	const bool osxsave = (regs[2] & (1u << 27)) != 0;
+	const bool avx = (regs[2] & (1u << 28)) != 0;
+	const bool fma = (regs[2] & (1u << 12)) != 0;
+	// Both the SSE and the AVX halves of the registers
+	const bool osAvx = osxsave && (xgetbv0() & 0x6) == 0x6;
+
+	if (maxLeaf >= 7 && avx && fma && osAvx)
+	{
+		cpuid(7, 0, regs);
+		if (regs[1] & (1u << 5))
+			return SimdLevel::AVX2;
+	}
+	return SimdLevel::SSE2;
+}
+#endif
+
+SimdLevel
+detectSimdLevel()
+{
+#ifdef DEPTH_SSE2
+	static const SimdLevel level = querySimdLevel();
+	return level;
+#else
+	return SimdLevel::Scalar;
+#endif
+}
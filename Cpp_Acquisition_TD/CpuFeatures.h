@@ -0,0 +1,19 @@
+#pragma once
+
+#include <stdint.h>
+
+// Instruction sets the kernels come in, each level implying the ones
+// before it
+enum class SimdLevel : int32_t
+{
+	Scalar = 0,
+	SSE2,
+	AVX2,
+	Count,
+};
+
+const char*	simdLevelName(SimdLevel level);
+
+// The best level both this CPU and the OS (for the AVX registers) support,
+// looked up once
+SimdLevel	detectSimdLevel();
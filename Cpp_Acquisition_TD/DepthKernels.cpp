@@ -0,0 +1,275 @@
+#include "stdafx.h"
+#include "DepthKernels.h"
+#include "DepthRowKernels.h"
+#include "Simd.h"
+#include <algorithm>
+#include <cmath>
+#include <stdlib.h>
+#include <vector>
+
+static inline bool
+differs(int16_t neighbor, int16_t z, int32_t threshold)
+{
+	return neighbor != 0 && std::abs(int32_t(neighbor) - int32_t(z)) > threshold;
+}
+
+// A flying pixel sits in between the two surfaces of an edge, so it differs
+// from the neighbors on both sides of it. A real edge pixel matches at least
+// one side, which keeps the silhouettes from eroding.
+static void
+removeFlyingPixels(const int16_t* above, const int16_t* center, const int16_t* below,
+	size_t width, int32_t threshold, int16_t* pOut)
+{
+	for (size_t x = 0; x < width; x++)
+	{
+		const int16_t z = center[x];
+
+		const bool horizontal = x > 0 && x + 1 < width &&
+			differs(center[x - 1], z, threshold) && differs(center[x + 1], z, threshold);
+		const bool vertical = above && below &&
+			differs(above[x], z, threshold) && differs(below[x], z, threshold);
+
+		pOut[x] = (horizontal || vertical) ? 0 : z;
+	}
+}
+
+void
+DepthStats::merge(const DepthStats& other)
+{
+	if (other.validCount == 0)
+		return;
+
+	if (validCount == 0 || other.minDepth < minDepth)
+	{
+		minDepth = other.minDepth;
+		nearestX = other.nearestX;
+		nearestY = other.nearestY;
+	}
+	if (validCount == 0 || other.maxDepth > maxDepth)
+		maxDepth = other.maxDepth;
+
+	validCount += other.validCount;
+	sum += other.sum;
+	for (int i = 0; i < NumBins; i++)
+		histogram[i] += other.histogram[i];
+}
+
+// Adds one finished row of the depth plane to the statistics
+static void
+accumulateStats(const int16_t* pRow, size_t width, size_t y, DepthStats& stats)
+{
+	size_t count = 0;
+	int64_t sum = 0;
+	int32_t lo = 32767;
+	int32_t hi = -32768;
+	int32_t nearest = -1;
+
+	for (size_t x = 0; x < width; x++)
+	{
+		const int32_t z = pRow[x];
+		if (z == 0)
+			continue;
+
+		count++;
+		sum += z;
+		if (z < lo)
+		{
+			lo = z;
+			nearest = int32_t(x);
+		}
+		hi = std::max(hi, z);
+		stats.histogram[std::min(std::max(z, 0) >> DepthStats::BinShift, DepthStats::NumBins - 1)]++;
+	}
+
+	if (count == 0)
+		return;
+
+	if (stats.validCount == 0 || lo < stats.minDepth)
+	{
+		stats.minDepth = int16_t(lo);
+		stats.nearestX = nearest;
+		stats.nearestY = int32_t(y);
+	}
+	if (stats.validCount == 0 || hi > stats.maxDepth)
+		stats.maxDepth = int16_t(hi);
+	stats.validCount += count;
+	stats.sum += sum;
+}
+
+void
+extractDepth(const uint8_t* pInput, size_t width, size_t height, size_t y0, size_t y1,
+	size_t srcBpp, const ScanCoordinates& coordinates, const DepthValiditySettings& validity,
+	const FloorPlane* floor, int16_t* pDepth, DepthStats* stats)
+{
+	size_t srcPixelSize = srcBpp / 8; // divide by the number of bits in a byte
+	const size_t srcRowSize = width * srcPixelSize;
+
+	DepthRowParams params;
+	params.coordinates = coordinates;
+	params.minIntensity = validity.minIntensity;
+
+	DepthRowKernelKey key;
+	key.simd = detectSimdLevel();
+	key.height = floor && floor->valid;
+	key.intensity = validity.minIntensity > 0;
+	if (key.height)
+		params.floor = *floor;
+	const DepthRowKernel kernel = selectDepthRowKernel(key, srcPixelSize);
+
+	auto convert = [&](size_t y, int16_t* pOut)
+	{
+		kernel(pInput + y * srcRowSize, width, srcPixelSize, params, pOut);
+	};
+
+	if (validity.flyingThreshold <= 0)
+	{
+		for (size_t y = y0; y < y1; y++)
+		{
+			convert(y, pDepth + y * width);
+			if (stats)
+				accumulateStats(pDepth + y * width, width, y, *stats);
+		}
+		return;
+	}
+
+	// Keep the converted rows above and below the current one in a small
+	// rolling window, so every source row is still only read and converted
+	// once (plus one row either side of the band).
+	std::vector<int16_t> window(3 * width);
+	int16_t* rows[3] = { window.data(), window.data() + width, window.data() + 2 * width };
+
+	bool hasAbove = y0 > 0;
+	if (hasAbove)
+		convert(y0 - 1, rows[0]);
+	convert(y0, rows[1]);
+
+	for (size_t y = y0; y < y1; y++)
+	{
+		const bool hasBelow = y + 1 < height;
+		if (hasBelow)
+			convert(y + 1, rows[2]);
+
+		removeFlyingPixels(hasAbove ? rows[0] : nullptr, rows[1], hasBelow ? rows[2] : nullptr,
+			width, validity.flyingThreshold, pDepth + y * width);
+		if (stats)
+			accumulateStats(pDepth + y * width, width, y, *stats);
+
+		int16_t* oldAbove = rows[0];
+		rows[0] = rows[1];
+		rows[1] = rows[2];
+		rows[2] = oldAbove;
+		hasAbove = true;
+	}
+}
+
+void
+extractPoints(const uint8_t* pInput, size_t width, size_t height, size_t srcBpp,
+	const ScanCoordinates& coordinates, size_t step, std::vector<float>& xyz)
+{
+	const size_t srcPixelSize = srcBpp / 8;
+	for (size_t y = 0; y < height; y += step)
+	{
+		const uint8_t* pIn = pInput + y * width * srcPixelSize;
+		for (size_t x = 0; x < width; x += step)
+		{
+			const uint8_t* p = pIn + x * srcPixelSize;
+			const int16_t z = *reinterpret_cast<const int16_t*>(p + 4);
+			if (z == 0)
+				continue;
+
+			xyz.push_back(float(*reinterpret_cast<const uint16_t*>(p)) * coordinates.scale + coordinates.offsetA);
+			xyz.push_back(float(*reinterpret_cast<const uint16_t*>(p + 2)) * coordinates.scale + coordinates.offsetB);
+			xyz.push_back(float(z) * coordinates.scale);
+		}
+	}
+}
+
+// Both go through the output in increasing address order, from its first
+// row (the bottom one, TouchDesigner's rows go up) to the last
+template <bool Stream>
+static void
+depthToColorRows(const int16_t* pDepth, const DepthColormap& colormap, size_t width, size_t height, float* pOut)
+{
+	float* pixel = pOut;
+	for (size_t row = 0; row < height; row++)
+	{
+		const int16_t* pRow = pDepth + (height - row - 1) * width;
+		for (size_t x = 0; x < width; x++, pixel += 4)
+			writePixel<Stream>(pixel, colormap.lookup(pRow[x]));
+	}
+}
+
+template <bool Stream>
+static void
+maskToColorRows(const uint8_t* pMask, size_t width, size_t height, float* pOut)
+{
+	float* pixel = pOut;
+	for (size_t row = 0; row < height; row++)
+	{
+		const uint8_t* pRow = pMask + (height - row - 1) * width;
+		for (size_t x = 0; x < width; x++, pixel += 4)
+		{
+			const float v = pRow[x] ? 1.0f : 0.0f;
+			writePixel<Stream>(pixel, v, v, v, 1.0f);
+		}
+	}
+}
+
+void
+depthToColor(const int16_t* pDepth, const DepthColormap& colormap, size_t width, size_t height, float* pOut,
+	OutputStores stores)
+{
+	if (canStream(pOut, stores))
+	{
+		depthToColorRows<true>(pDepth, colormap, width, height, pOut);
+		writeFence();
+	}
+	else
+	{
+		depthToColorRows<false>(pDepth, colormap, width, height, pOut);
+	}
+}
+
+void
+maskToColor(const uint8_t* pMask, size_t width, size_t height, float* pOut, OutputStores stores)
+{
+	if (canStream(pOut, stores))
+	{
+		maskToColorRows<true>(pMask, width, height, pOut);
+		writeFence();
+	}
+	else
+	{
+		maskToColorRows<false>(pMask, width, height, pOut);
+	}
+}
+
+void
+depthSliceMask(const int16_t* pDepth, size_t count, double startDistance, double endDistance,
+	uint8_t* pMask)
+{
+	// Invalid pixels (0) are never in the slice
+	const int16_t lo = int16_t(std::min(32767.0, std::max(1.0, std::ceil(startDistance))));
+	const int16_t hi = int16_t(std::min(32767.0, std::max(0.0, std::floor(endDistance))));
+
+	size_t i = 0;
+#ifdef DEPTH_SSE2
+	const __m128i below = _mm_set1_epi16(int16_t(lo - 1));
+	const __m128i above = _mm_set1_epi16(hi == 32767 ? 32767 : int16_t(hi + 1));
+	const __m128i inclusive = hi == 32767 ? _mm_set1_epi16(-1) : _mm_setzero_si128();
+	for (; i + 16 <= count; i += 16)
+	{
+		const __m128i z0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pDepth + i));
+		const __m128i z1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pDepth + i + 8));
+
+		const __m128i in0 = _mm_and_si128(_mm_cmpgt_epi16(z0, below),
+			_mm_or_si128(_mm_cmplt_epi16(z0, above), inclusive));
+		const __m128i in1 = _mm_and_si128(_mm_cmpgt_epi16(z1, below),
+			_mm_or_si128(_mm_cmplt_epi16(z1, above), inclusive));
+
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(pMask + i), _mm_packs_epi16(in0, in1));
+	}
+#endif
+	for (; i < count; i++)
+		pMask[i] = (pDepth[i] >= lo && pDepth[i] <= hi) ? 255 : 0;
+}
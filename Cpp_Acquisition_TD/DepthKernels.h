@@ -0,0 +1,86 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+#include "Colormap.h"
+#include "DepthRowTypes.h"
+#include "OutputWriter.h"
+
+// The conversion kernels used by the TOP. They don't depend on Arena or on
+// TouchDesigner, so the offline batch tool (Cpp_Acquisition_Batch) runs the
+// exact same code on recorded frames as the TOP does on live ones.
+
+struct DepthValiditySettings
+{
+	// Pixels with a Y (intensity) value below this are dropped, 0 keeps all
+	int32_t		minIntensity = 0;
+	// Pixels that differ by more than this (mm) from the neighbors on both
+	// sides, horizontally or vertically, are dropped as flying pixels.
+	// 0 turns the check off.
+	int32_t		flyingThreshold = 0;
+};
+
+// Statistics of the valid (non-zero) pixels of a depth plane
+struct DepthStats
+{
+	// 32 mm bins from 0 to 8192 mm, the Helios' whole range. The last bin
+	// also takes anything beyond.
+	static const int	NumBins = 256;
+	static const int	BinShift = 5;
+
+	size_t		validCount = 0;
+	int16_t		minDepth = 0;
+	int16_t		maxDepth = 0;
+	int64_t		sum = 0;
+	// Pixel where minDepth was found, -1 if there's no valid pixel
+	int32_t		nearestX = -1;
+	int32_t		nearestY = -1;
+	uint32_t	histogram[NumBins] = {};
+	// Size of the plane, for nearestU() and nearestV()
+	int32_t		width = 0;
+	int32_t		height = 0;
+
+	double		mean() const { return validCount ? double(sum) / double(validCount) : 0.0; }
+
+	// The nearest pixel in the TOP's texture coordinates, like the blobs
+	float		nearestU() const { return width > 0 ? (nearestX + 0.5f) / width : 0.0f; }
+	float		nearestV() const { return height > 0 ? (height - nearestY - 0.5f) / height : 0.0f; }
+
+	// Adds the statistics of another part of the same plane. Ties on the
+	// nearest pixel go to the one merged first.
+	void		merge(const DepthStats& other);
+};
+
+// Pulls the C (z) channel out of rows [y0, y1) of a Coord3D_ABCY16 image and
+// converts it to millimeters using the Scan3dCoordinateScale. 0 means no
+// depth was measured, or the pixel was dropped by the validity checks,
+// which are done in this same pass.
+// With a floor plane the height of each point above it is written instead,
+// clamped to at least 1 mm so 0 still means no depth.
+// With stats, the statistics of the rows written are added to it while
+// each row is still in cache.
+// The rows are converted by the fastest DepthRowKernel this CPU runs for
+// these options.
+void	extractDepth(const uint8_t* pInput, size_t width, size_t height, size_t y0, size_t y1,
+			size_t srcBpp, const ScanCoordinates& coordinates, const DepthValiditySettings& validity,
+			const FloorPlane* floor, int16_t* pDepth, DepthStats* stats = nullptr);
+
+// Appends x, y, z (mm) of every step'th valid pixel in both directions
+void	extractPoints(const uint8_t* pInput, size_t width, size_t height, size_t srcBpp,
+			const ScanCoordinates& coordinates, size_t step, std::vector<float>& xyz);
+
+// Converts a depth plane (mm) into RGBA32Float pixels through a colormap.
+// The output is vertically flipped to match TouchDesigner's bottom-up rows.
+void	depthToColor(const int16_t* pDepth, const DepthColormap& colormap,
+			size_t width, size_t height, float* pOut, OutputStores stores = OutputStores::Streaming);
+
+// Writes white for the non-zero entries of an 8 bit mask and black for the
+// rest, flipped the same way as depthToColor.
+void	maskToColor(const uint8_t* pMask, size_t width, size_t height, float* pOut,
+			OutputStores stores = OutputStores::Streaming);
+
+// Sets the mask to 255 where the depth is between startDistance and
+// endDistance (in mm, inclusive) and to 0 elsewhere.
+void	depthSliceMask(const int16_t* pDepth, size_t count, double startDistance, double endDistance,
+			uint8_t* pMask);
@@ -0,0 +1,233 @@
+#include "stdafx.h"
+#include "DepthPipeline.h"
+#include "DepthKernels.h"
+#include "WorkerPool.h"
+#include <algorithm>
+#include <string.h>
+
+void
+DepthSettings::outputSize(size_t cameraWidth, size_t cameraHeight, size_t* width, size_t* height) const
+{
+	if (output == DepthOutputMode::Heightmap || output == DepthOutputMode::Fused)
+	{
+		*width = size_t(heightmap.width);
+		*height = size_t(heightmap.height);
+		return;
+	}
+
+	// Every point needs a pixel of its own, and the point cloud isn't an
+	// image to rotate
+	if (output == DepthOutputMode::PointCloud)
+	{
+		*width = cameraWidth;
+		*height = cameraHeight;
+		return;
+	}
+
+	resample.imageSize(cameraWidth, cameraHeight, remap.swapsAxes(), width, height);
+	if (remap.swapsAxes())
+		std::swap(*width, *height);
+}
+
+DepthPipeline::DepthPipeline() :
+	myPool(nullptr),
+	myCalibrateFloor(false),
+	myStartDistance(0.0),
+	myEndDistance(0.0),
+	myPointCount(0)
+{
+}
+
+void
+DepthPipeline::reset()
+{
+	myTemporalFilter.reset();
+	myTracker.reset();
+	myAutoRange.reset();
+}
+
+void
+DepthPipeline::process(const uint8_t* pInput, size_t width, size_t height, size_t srcBpp,
+	const ScanCoordinates& coordinates, const DepthSettings& settings,
+	float* pOut, size_t outWidth, size_t outHeight)
+{
+	const size_t count = width * height;
+	myDepth.resize(count);
+
+	if (myCalibrateFloor)
+	{
+		// Every 4th pixel both ways is plenty for a plane, and keeps the fit
+		// in the tens of milliseconds
+		myFloorPoints.clear();
+		extractPoints(pInput, width, height, srcBpp, coordinates, 4, myFloorPoints);
+		if (myFloorCalibrator.start(myFloorPoints))
+			myCalibrateFloor = false;
+	}
+
+	const FloorPlane* floor = settings.heightAboveFloor ? &settings.floor : nullptr;
+
+	// Split into bands of rows, each band converts one extra row either side
+	// for the flying pixel check
+	const size_t BandHeight = 32;
+	const size_t numBands = (height + BandHeight - 1) / BandHeight;
+	DepthStats* bandStats = nullptr;
+	if (settings.usesStats())
+	{
+		myBandStats.assign(numBands, DepthStats());
+		bandStats = myBandStats.data();
+	}
+
+	int16_t* depth = myDepth.data();
+	auto extractBands = [&](size_t begin, size_t end)
+	{
+		for (size_t band = begin; band < end; band++)
+		{
+			const size_t y0 = band * BandHeight;
+			const size_t y1 = std::min(y0 + BandHeight, height);
+			extractDepth(pInput, width, height, y0, y1, srcBpp, coordinates, settings.validity, floor, depth,
+				bandStats ? &bandStats[band] : nullptr);
+		}
+	};
+
+	if (myPool)
+		myPool->parallelFor(numBands, extractBands);
+	else
+		extractBands(0, numBands);
+
+	// Merged in band order, so the nearest pixel is the first one from the
+	// top whatever the pool did
+	myStats = DepthStats();
+	if (bandStats)
+	{
+		for (size_t band = 0; band < numBands; band++)
+			myStats.merge(bandStats[band]);
+		myStats.width = int32_t(width);
+		myStats.height = int32_t(height);
+	}
+
+	myStartDistance = settings.startDistance;
+	myEndDistance = settings.endDistance;
+	if (settings.autoRange.enabled)
+	{
+		myAutoRange.apply(myStats, settings.autoRange, settings.startDistance, settings.endDistance);
+		myStartDistance = myAutoRange.startDistance();
+		myEndDistance = myAutoRange.endDistance();
+	}
+
+	myHoleFilter.apply(myDepth.data(), width, height, settings.holes, myPool);
+
+	if (settings.spatial.mode != SpatialFilterMode::Off)
+	{
+		myScratch.resize(count);
+		mySpatialFilter.apply(myDepth.data(), myScratch.data(), width, height, settings.spatial, myPool);
+		myDepth.swap(myScratch);
+	}
+
+	myTemporalFilter.apply(myDepth.data(), count, settings.temporal);
+
+	if (settings.usesBackground())
+	{
+		myMask.resize(count);
+		myBackground.apply(myDepth.data(), myMask.data(), count, settings.background,
+			settings.output == DepthOutputMode::ForegroundDepth);
+	}
+
+	if (settings.blobs.source == BlobSource::Off)
+	{
+		myBlobs.clear();
+	}
+	else
+	{
+		const uint8_t* mask = myMask.data();
+		if (settings.blobs.source == BlobSource::DepthSlice)
+		{
+			mySliceMask.resize(count);
+			depthSliceMask(myDepth.data(), count, settings.startDistance, settings.endDistance, mySliceMask.data());
+			mask = mySliceMask.data();
+		}
+		myBlobDetector.apply(mask, myDepth.data(), width, height, settings.blobs, myBlobs);
+		if (settings.tracking.enabled)
+			myTracker.apply(myBlobs, settings.tracking);
+	}
+
+	myPointCount = 0;
+	if (settings.output == DepthOutputMode::Fused)
+		return;
+
+	if (settings.output == DepthOutputMode::PointCloud)
+	{
+		if (outWidth == width && outHeight == height)
+		{
+			myPointCloud.apply(pInput, myDepth.data(), width, height, srcBpp, coordinates, myPool, pOut);
+			myPointCount = myPointCloud.pointCount();
+			return;
+		}
+	}
+	else if (settings.output == DepthOutputMode::Heightmap)
+	{
+		if (outWidth == size_t(settings.heightmap.width) && outHeight == size_t(settings.heightmap.height))
+		{
+			myHeightmap.apply(pInput, myDepth.data(), width, height, srcBpp, coordinates, settings.floor,
+				settings.endDistance, settings.heightmap, myPool, pOut);
+			return;
+		}
+	}
+	else
+	{
+		size_t imageWidth;
+		size_t imageHeight;
+		settings.resample.imageSize(width, height, settings.remap.swapsAxes(), &imageWidth, &imageHeight);
+
+		// Only rebuilds the table when the remap settings or the sizes change
+		const RemapSettings remap = settings.remap.scaled(double(imageWidth) / width, double(imageHeight) / height);
+		myRemap.update(remap, imageWidth, imageHeight, myPool);
+		if (outWidth == myRemap.width() && outHeight == myRemap.height())
+		{
+			const bool mask = settings.output == DepthOutputMode::ForegroundMask;
+			const int16_t* depth = myDepth.data();
+			const uint8_t* foreground = myMask.data();
+
+			// Down to the output's resolution first, so only its pixels get
+			// remapped and colored
+			if (imageWidth != width || imageHeight != height)
+			{
+				myResampler.update(width, height, imageWidth, imageHeight);
+				if (mask)
+				{
+					myResampledMask.resize(imageWidth * imageHeight);
+					myResampler.mask(myMask.data(), settings.resample.filter, myResampledMask.data(), myPool);
+					foreground = myResampledMask.data();
+				}
+				else
+				{
+					myResampledDepth.resize(imageWidth * imageHeight);
+					myResampler.depth(myDepth.data(), settings.resample.filter, myResampledDepth.data(), myPool);
+					depth = myResampledDepth.data();
+				}
+			}
+
+			// Only recompiles the table when the colormap or the range change
+			if (!mask)
+				myColormap.update(settings.colormap, myStartDistance, myEndDistance);
+			if (!myRemap.isIdentity())
+			{
+				if (mask)
+					myRemap.maskToColor(foreground, pOut, myPool);
+				else
+					myRemap.depthToColor(depth, myColormap, pOut, myPool);
+			}
+			else if (mask)
+			{
+				maskToColor(foreground, imageWidth, imageHeight, pOut);
+			}
+			else
+			{
+				depthToColor(depth, myColormap, imageWidth, imageHeight, pOut);
+			}
+			return;
+		}
+	}
+
+	// The output size hasn't caught up with a change of Output yet
+	memset(pOut, 0, outWidth * outHeight * 4 * sizeof(float));
+}
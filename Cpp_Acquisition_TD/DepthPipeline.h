@@ -0,0 +1,195 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+#include "AlignedBuffer.h"
+#include "AutoRange.h"
+#include "BackgroundModel.h"
+#include "BlobDetector.h"
+#include "BlobTracker.h"
+#include "Colormap.h"
+#include "DepthKernels.h"
+#include "FloorCalibrator.h"
+#include "HeightmapProjector.h"
+#include "HoleFilter.h"
+#include "PointCloud.h"
+#include "RemapTable.h"
+#include "Resampler.h"
+#include "SpatialFilter.h"
+#include "TemporalFilter.h"
+
+class WorkerPool;
+
+enum class DepthOutputMode : int32_t
+{
+	// The depth, colored from Near to Far
+	Color = 0,
+	// White where the background model sees foreground
+	ForegroundMask,
+	// The colored depth of the foreground only
+	ForegroundDepth,
+	// Top-down heightmap in mm, at its own resolution
+	Heightmap,
+	// The heightmaps of all cameras merged in world space. The TOP builds
+	// it with a FusionGrid, the pipeline itself outputs nothing.
+	Fused,
+	// The valid points packed to the front, x, y, z (mm) and intensity
+	PointCloud,
+};
+
+// Everything the pipeline needs from the TOP's parameters. execute() fills
+// one of these under mySettingsLock and the acquisition thread works from a
+// copy, so a frame is always processed with one consistent set of values.
+struct DepthSettings
+{
+	double					startDistance = 0.0;
+	double					endDistance = 6000.0;
+	// Picks the Near and Far the colors use, the ones above still apply
+	// to the depth slice blobs and the heightmap
+	AutoRangeSettings		autoRange;
+	ColormapSettings		colormap;
+
+	DepthValiditySettings	validity;
+	// Output heights above the floor plane instead of depth, if it's valid
+	bool					heightAboveFloor = false;
+	FloorPlane				floor;
+	HoleFillSettings		holes;
+	SpatialFilterSettings	spatial;
+	TemporalFilterSettings	temporal;
+	BackgroundSettings		background;
+	BlobSettings			blobs;
+	HeightmapSettings		heightmap;
+	TrackerSettings			tracking;
+	// Only apply to the image outputs, not the heightmaps. The image is
+	// resampled to the output's resolution before it's remapped.
+	ResampleSettings		resample;
+	RemapSettings			remap;
+
+	DepthOutputMode			output = DepthOutputMode::Color;
+
+	// Gather DepthStats while extracting the depth
+	bool					stats = false;
+
+	bool		usesStats() const { return stats || autoRange.enabled; }
+
+	bool		usesBackground() const
+				{
+					return output == DepthOutputMode::ForegroundMask || output == DepthOutputMode::ForegroundDepth ||
+						blobs.source == BlobSource::Foreground;
+				}
+
+	// The outputs that show the camera image, which the remap applies to
+	bool		isImageOutput() const
+				{
+					return output == DepthOutputMode::Color || output == DepthOutputMode::ForegroundMask ||
+						output == DepthOutputMode::ForegroundDepth;
+				}
+
+	// Size of the output for a camera image of cameraWidth x cameraHeight
+	void		outputSize(size_t cameraWidth, size_t cameraHeight, size_t* width, size_t* height) const;
+
+	// True if a frame's result depends on the frames before it, in which
+	// case frames have to be processed in order.
+	bool		isStateful() const
+				{
+					return temporal.mode != TemporalFilterMode::Off || usesBackground() || autoRange.enabled ||
+						(blobs.source != BlobSource::Off && tracking.enabled);
+				}
+};
+
+// Runs one camera's frames from the raw Coord3D_ABCY16 image to the
+// RGBA32Float output. The stages work on an int16 depth (or height above
+// the floor) plane in mm:
+//
+//   extractDepth (+ stats -> auto range) -> hole fill -> spatial filter
+//     -> temporal filter -> background model -> blobs -> tracker -> resample
+//     -> depthToColor / maskToColor (through the remap table, if any) / heightmap
+//
+// Both the TOP and Cpp_Acquisition_Batch go through this class, so offline
+// renders match what the TOP outputs for the same frames and settings.
+class DepthPipeline
+{
+public:
+	DepthPipeline();
+
+	// Pool used to split the per-frame stages, nullptr runs them on the
+	// calling thread
+	void		setWorkerPool(WorkerPool* pool) { myPool = pool; }
+
+	// width x height is the camera image. pOut holds outWidth x outHeight
+	// pixels, as given by the settings' outputSize(). pOut is not touched
+	// for the Fused output, and may be nullptr then.
+	void		process(const uint8_t* pInput, size_t width, size_t height, size_t srcBpp,
+					const ScanCoordinates& coordinates, const DepthSettings& settings,
+					float* pOut, size_t outWidth, size_t outHeight);
+
+	// Forget any history kept between frames
+	void		reset();
+
+	// Start learning the background again from the next frames
+	void		learnBackground() { myBackground.learn(); }
+
+	// Learn the background on a thread of its own. Keeps the acquisition
+	// thread free, at the cost of the model lagging a frame or so behind.
+	void		setLearnInBackground(bool background) { myBackground.setLearnInBackground(background); }
+
+	// Fit the floor plane to the points of the next frame. The fit runs in
+	// the background, takeFloorPlane() returns it once it's done.
+	void		calibrateFloor() { myCalibrateFloor = true; }
+	bool		takeFloorPlane(FloorPlane* plane) { return myFloorCalibrator.takeResult(plane); }
+
+	// The filtered depth plane of the last processed frame
+	const int16_t*	depth() const { return myDepth.data(); }
+	// 255 where the last frame had foreground, if anything used it
+	const uint8_t*	mask() const { return myMask.data(); }
+
+	// The blobs found in the last frame, empty if they're turned off. With
+	// tracking on their IDs carry over from frame to frame.
+	const std::vector<Blob>&	blobs() const { return myBlobs; }
+
+	// Points in the last frame's PointCloud output, 0 for the others
+	size_t		pointCount() const { return myPointCount; }
+
+	// The last frame's depth statistics, before the filters, if the
+	// settings asked for them or the auto range needed them
+	const DepthStats&	stats() const { return myStats; }
+
+	// The Near and Far the last frame was colored with, the settings' own
+	// unless the auto range picked them
+	double		startDistance() const { return myStartDistance; }
+	double		endDistance() const { return myEndDistance; }
+
+private:
+	WorkerPool*				myPool;
+
+	bool					myCalibrateFloor;
+	FloorCalibrator			myFloorCalibrator;
+	std::vector<float>		myFloorPoints;
+
+	AlignedBuffer<int16_t>	myDepth;
+	// Each band of extractDepth gathers its own, they're merged after
+	std::vector<DepthStats>	myBandStats;
+	DepthStats				myStats;
+	AutoRange				myAutoRange;
+	double					myStartDistance;
+	double					myEndDistance;
+	AlignedBuffer<int16_t>	myScratch;
+	HoleFilter				myHoleFilter;
+	SpatialFilter			mySpatialFilter;
+	TemporalFilter			myTemporalFilter;
+	BackgroundModel			myBackground;
+	AlignedBuffer<uint8_t>	myMask;
+	AlignedBuffer<uint8_t>	mySliceMask;
+	BlobDetector			myBlobDetector;
+	BlobTracker				myTracker;
+	HeightmapProjector		myHeightmap;
+	Resampler				myResampler;
+	AlignedBuffer<int16_t>	myResampledDepth;
+	AlignedBuffer<uint8_t>	myResampledMask;
+	RemapTable				myRemap;
+	DepthColormap			myColormap;
+	PointCloudCompactor		myPointCloud;
+	size_t					myPointCount;
+	std::vector<Blob>		myBlobs;
+};
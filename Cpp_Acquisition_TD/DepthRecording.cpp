@@ -0,0 +1,353 @@
+#include "stdafx.h"
+#include "DepthRecording.h"
+#include "FileIo.h"
+#include <string.h>
+#include <algorithm>
+
+static const char		RecordingMagic[4] = { 'A', 'D', 'R', 'C' };
+static const uint32_t	RecordingVersion = 1;
+
+// 64 bit seeks, recordings easily grow past 2GB
+static int
+seekFile(FILE* file, uint64_t offset)
+{
+#ifdef _WIN32
+	return _fseeki64(file, (__int64)offset, SEEK_SET);
+#else
+	return fseeko(file, (off_t)offset, SEEK_SET);
+#endif
+}
+
+static uint64_t
+fileSize(FILE* file)
+{
+#ifdef _WIN32
+	if (_fseeki64(file, 0, SEEK_END) != 0)
+		return 0;
+	return (uint64_t)_ftelli64(file);
+#else
+	if (fseeko(file, 0, SEEK_END) != 0)
+		return 0;
+	return (uint64_t)ftello(file);
+#endif
+}
+
+static uint64_t
+frameOffset(uint32_t index, size_t frameSize)
+{
+	return sizeof(DepthRecordingHeader) + (uint64_t)index * (sizeof(uint64_t) + frameSize);
+}
+
+static size_t
+payloadSize(const DepthRecordingHeader& header)
+{
+	return (size_t)header.width * header.height * (header.bitsPerPixel / 8);
+}
+
+void
+initDepthRecordingHeader(DepthRecordingHeader* header, DepthRecordingFormat format,
+	uint32_t width, uint32_t height, uint32_t bitsPerPixel, const ScanCoordinates& coordinates)
+{
+	memset(header, 0, sizeof(DepthRecordingHeader));
+	memcpy(header->magic, RecordingMagic, sizeof(RecordingMagic));
+	header->version = RecordingVersion;
+	header->format = format;
+	header->width = width;
+	header->height = height;
+	header->bitsPerPixel = bitsPerPixel;
+	header->coordinateScale = coordinates.scale;
+	header->coordinateOffsetA = coordinates.offsetA;
+	header->coordinateOffsetB = coordinates.offsetB;
+}
+
+ScanCoordinates
+scanCoordinates(const DepthRecordingHeader& header)
+{
+	ScanCoordinates coordinates;
+	coordinates.scale = header.coordinateScale;
+	coordinates.offsetA = header.coordinateOffsetA;
+	coordinates.offsetB = header.coordinateOffsetB;
+	return coordinates;
+}
+
+DepthRecordingWriter::DepthRecordingWriter() :
+	myFile(nullptr)
+{
+	memset(&myHeader, 0, sizeof(myHeader));
+}
+
+DepthRecordingWriter::~DepthRecordingWriter()
+{
+	close();
+}
+
+bool
+DepthRecordingWriter::open(const char* path, const DepthRecordingHeader& header)
+{
+	close();
+
+	myFile = openFile(path, "wb");
+	if (!myFile)
+		return false;
+
+	myPath = path;
+	myHeader = header;
+	myHeader.frameCount = 0;
+	if (fwrite(&myHeader, sizeof(myHeader), 1, myFile) != 1)
+	{
+		close();
+		return false;
+	}
+	return true;
+}
+
+size_t
+DepthRecordingWriter::frameSize() const
+{
+	return payloadSize(myHeader);
+}
+
+bool
+DepthRecordingWriter::writeFrame(const void* data, uint64_t timestamp)
+{
+	return writeFrame(myHeader.frameCount, data, timestamp);
+}
+
+bool
+DepthRecordingWriter::writeFrame(uint32_t index, const void* data, uint64_t timestamp)
+{
+	std::lock_guard<std::mutex> lock(myLock);
+
+	if (!myFile)
+		return false;
+
+	const size_t size = frameSize();
+	if (seekFile(myFile, frameOffset(index, size)) != 0)
+		return false;
+
+	if (fwrite(&timestamp, sizeof(timestamp), 1, myFile) != 1 ||
+		fwrite(data, size, 1, myFile) != 1)
+	{
+		return false;
+	}
+
+	if (index >= myHeader.frameCount)
+		myHeader.frameCount = index + 1;
+	return true;
+}
+
+bool
+DepthRecordingWriter::close()
+{
+	std::lock_guard<std::mutex> lock(myLock);
+
+	if (!myFile)
+		return true;
+
+	bool ok = seekFile(myFile, 0) == 0 && fwrite(&myHeader, sizeof(myHeader), 1, myFile) == 1;
+	if (fclose(myFile) != 0)
+		ok = false;
+	myFile = nullptr;
+	return ok;
+}
+
+DepthRecordingQueue::DepthRecordingQueue(size_t numBuffers) :
+	myNumBuffers(numBuffers),
+	myShouldExit(false),
+	myFailed(false),
+	myDropped(0)
+{
+}
+
+DepthRecordingQueue::~DepthRecordingQueue()
+{
+	close();
+}
+
+bool
+DepthRecordingQueue::open(const char* path, const DepthRecordingHeader& header)
+{
+	close();
+
+	if (!myWriter.open(path, header))
+		return false;
+
+	myFrames.resize(myNumBuffers);
+	myFree.clear();
+	for (auto& frame : myFrames)
+	{
+		frame.data.resize(myWriter.frameSize());
+		myFree.push_back(&frame);
+	}
+	myPending.clear();
+	myShouldExit = false;
+	myFailed = false;
+	myDropped = 0;
+	myThread = std::thread(&DepthRecordingQueue::threadMain, this);
+	return true;
+}
+
+bool
+DepthRecordingQueue::push(const void* data, uint64_t timestamp)
+{
+	Frame* frame = nullptr;
+	{
+		std::lock_guard<std::mutex> lock(myLock);
+		if (!myWriter.isOpen() || myFailed)
+			return false;
+		if (myFree.empty())
+		{
+			myDropped++;
+			return false;
+		}
+		frame = myFree.back();
+		myFree.pop_back();
+	}
+
+	// The buffer is ours until it is queued, the copy doesn't need the lock
+	memcpy(frame->data.data(), data, frame->data.size());
+	frame->timestamp = timestamp;
+
+	{
+		std::lock_guard<std::mutex> lock(myLock);
+		myPending.push_back(frame);
+	}
+	myWake.notify_one();
+	return true;
+}
+
+bool
+DepthRecordingQueue::close()
+{
+	if (!myThread.joinable())
+		return true;
+
+	{
+		std::lock_guard<std::mutex> lock(myLock);
+		myShouldExit = true;
+	}
+	myWake.notify_one();
+	myThread.join();
+
+	const bool closed = myWriter.close();
+	myFrames.clear();
+	myFree.clear();
+	return closed && !myFailed;
+}
+
+bool
+DepthRecordingQueue::failed()
+{
+	std::lock_guard<std::mutex> lock(myLock);
+	return myFailed;
+}
+
+uint32_t
+DepthRecordingQueue::dropped()
+{
+	std::lock_guard<std::mutex> lock(myLock);
+	return myDropped;
+}
+
+void
+DepthRecordingQueue::threadMain()
+{
+	std::unique_lock<std::mutex> lock(myLock);
+	for (;;)
+	{
+		myWake.wait(lock, [this]() { return myShouldExit || !myPending.empty(); });
+		if (myPending.empty())
+			return;
+
+		Frame* frame = myPending.front();
+		myPending.pop_front();
+
+		// A failed recording only hands its buffers back
+		if (!myFailed)
+		{
+			lock.unlock();
+			const bool written = myWriter.writeFrame(frame->data.data(), frame->timestamp);
+			lock.lock();
+			if (!written)
+				myFailed = true;
+		}
+		myFree.push_back(frame);
+	}
+}
+
+DepthRecordingReader::DepthRecordingReader() :
+	myFile(nullptr)
+{
+	memset(&myHeader, 0, sizeof(myHeader));
+}
+
+DepthRecordingReader::~DepthRecordingReader()
+{
+	close();
+}
+
+bool
+DepthRecordingReader::open(const char* path)
+{
+	close();
+
+	myFile = openFile(path, "rb");
+	if (!myFile)
+		return false;
+
+	if (fread(&myHeader, sizeof(myHeader), 1, myFile) != 1 ||
+		memcmp(myHeader.magic, RecordingMagic, sizeof(RecordingMagic)) != 0 ||
+		myHeader.version != RecordingVersion)
+	{
+		close();
+		return false;
+	}
+
+	// A recording that was never closed, because the process died while it
+	// was being written, still says it has no frames. Every record has the
+	// same size, so the ones that made it to disk can be counted instead.
+	const uint64_t size = fileSize(myFile);
+	const uint64_t recordSize = sizeof(uint64_t) + frameSize();
+	const uint64_t onDisk = size > sizeof(myHeader) ? (size - sizeof(myHeader)) / recordSize : 0;
+	if (myHeader.frameCount == 0 || myHeader.frameCount > onDisk)
+		myHeader.frameCount = (uint32_t)std::min<uint64_t>(onDisk, UINT32_MAX);
+	return true;
+}
+
+void
+DepthRecordingReader::close()
+{
+	if (myFile)
+	{
+		fclose(myFile);
+		myFile = nullptr;
+	}
+}
+
+size_t
+DepthRecordingReader::frameSize() const
+{
+	return payloadSize(myHeader);
+}
+
+bool
+DepthRecordingReader::readFrame(uint32_t index, void* data, uint64_t* timestamp)
+{
+	std::lock_guard<std::mutex> lock(myLock);
+
+	if (!myFile || index >= myHeader.frameCount)
+		return false;
+
+	const size_t size = frameSize();
+	uint64_t ts = 0;
+	if (seekFile(myFile, frameOffset(index, size)) != 0 ||
+		fread(&ts, sizeof(ts), 1, myFile) != 1 ||
+		fread(data, size, 1, myFile) != 1)
+	{
+		return false;
+	}
+
+	if (timestamp)
+		*timestamp = ts;
+	return true;
+}
@@ -0,0 +1,164 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "DepthKernels.h"
+
+// A minimal raw container for depth captures. It is a fixed size header
+// followed by frameCount fixed size frame records, each of which is an
+// 8 byte device timestamp followed by the raw pixel payload. Since every
+// record has the same size, any frame can be read directly by index, which
+// is what lets the batch tool hand frames out to its workers in any order.
+
+enum class DepthRecordingFormat : uint32_t
+{
+	// Raw Coord3D_ABCY16 images as they come out of Arena::IImage::GetData()
+	ABCY16 = 0,
+	// Converted RGBA32Float pixels as they are written into cpuPixelData
+	RGBA32Float,
+};
+
+struct DepthRecordingHeader
+{
+	char					magic[4];
+	uint32_t				version;
+	DepthRecordingFormat	format;
+	uint32_t				width;
+	uint32_t				height;
+	uint32_t				bitsPerPixel;
+	// Scan3dCoordinateScale of the camera the frames were recorded from,
+	// needed to turn the raw C channel into millimeters.
+	float					coordinateScale;
+	uint32_t				frameCount;
+	// Scan3dCoordinateOffset of the A and B channels. These were reserved
+	// (and so 0) in older recordings.
+	float					coordinateOffsetA;
+	float					coordinateOffsetB;
+	uint32_t				reserved[6];
+};
+
+class DepthRecordingWriter
+{
+public:
+	DepthRecordingWriter();
+	~DepthRecordingWriter();
+
+	// Creates (or truncates) the file and writes the header. frameCount in
+	// the given header is ignored, it gets filled in by close().
+	bool				open(const char* path, const DepthRecordingHeader& header);
+
+	// Appends one frame. The payload must be frameSize() bytes.
+	bool				writeFrame(const void* data, uint64_t timestamp);
+
+	// Writes the frame at the given index. Used when frames finish out of
+	// order, such as in the batch tool. Safe to call from several threads.
+	bool				writeFrame(uint32_t index, const void* data, uint64_t timestamp);
+
+	// Patches the frame count into the header and closes the file. Returns
+	// false if the header couldn't be written, the frames are still there.
+	bool				close();
+
+	bool				isOpen() const { return myFile != nullptr; }
+	size_t				frameSize() const;
+	const std::string&	path() const { return myPath; }
+	const DepthRecordingHeader&	header() const { return myHeader; }
+
+private:
+	FILE*				myFile;
+	std::mutex			myLock;
+	std::string			myPath;
+	DepthRecordingHeader	myHeader;
+};
+
+// Records frames as they come in, from a thread of its own, so a slow disk
+// doesn't hold up the frame that is being written. Frames are copied into a
+// few buffers on the way, when all of them are still waiting to be written
+// the frame is dropped.
+class DepthRecordingQueue
+{
+public:
+	explicit DepthRecordingQueue(size_t numBuffers = 4);
+	~DepthRecordingQueue();
+
+	DepthRecordingQueue(const DepthRecordingQueue&) = delete;
+	DepthRecordingQueue& operator=(const DepthRecordingQueue&) = delete;
+
+	bool				open(const char* path, const DepthRecordingHeader& header);
+
+	// Copies the frame, frameSize() bytes, and queues it to be written.
+	// Returns false if it was dropped or the recording has failed().
+	bool				push(const void* data, uint64_t timestamp);
+
+	// Writes out what is still queued and closes the file. Returns false if
+	// any of it couldn't be written.
+	bool				close();
+
+	// True once a write has failed. Nothing more is written after that.
+	bool				failed();
+	// Frames dropped because the disk didn't keep up
+	uint32_t			dropped();
+
+	bool				isOpen() const { return myWriter.isOpen(); }
+	size_t				frameSize() const { return myWriter.frameSize(); }
+	const std::string&	path() const { return myWriter.path(); }
+	const DepthRecordingHeader&	header() const { return myWriter.header(); }
+
+private:
+	struct Frame
+	{
+		std::vector<uint8_t>	data;
+		uint64_t				timestamp;
+	};
+
+	void				threadMain();
+
+	DepthRecordingWriter	myWriter;
+	std::thread				myThread;
+	size_t					myNumBuffers;
+
+	std::mutex				myLock;
+	std::condition_variable	myWake;
+	std::vector<Frame*>		myFree;
+	std::deque<Frame*>		myPending;
+	std::vector<Frame>		myFrames;
+	bool					myShouldExit;
+	bool					myFailed;
+	uint32_t				myDropped;
+};
+
+class DepthRecordingReader
+{
+public:
+	DepthRecordingReader();
+	~DepthRecordingReader();
+
+	// Opens a recording. If it was never closed, the frame count is taken
+	// from the records that are in the file.
+	bool				open(const char* path);
+	void				close();
+
+	const DepthRecordingHeader&	header() const { return myHeader; }
+	size_t				frameSize() const;
+
+	// Reads the frame at the given index into data, which must hold
+	// frameSize() bytes. Safe to call from several threads.
+	bool				readFrame(uint32_t index, void* data, uint64_t* timestamp);
+
+private:
+	FILE*				myFile;
+	std::mutex			myLock;
+	DepthRecordingHeader	myHeader;
+};
+
+// Fills in the header fields that don't depend on the recording
+void	initDepthRecordingHeader(DepthRecordingHeader* header, DepthRecordingFormat format,
+			uint32_t width, uint32_t height, uint32_t bitsPerPixel, const ScanCoordinates& coordinates);
+
+// The coordinate scale and offsets the frames were recorded with
+ScanCoordinates	scanCoordinates(const DepthRecordingHeader& header);
@@ -0,0 +1,178 @@
+#include "stdafx.h"
+#include "DepthRowKernels.h"
+#include "Simd.h"
+#include <algorithm>
+
+template <bool Intensity>
+static void
+depthRowScalar(const uint8_t* pRow, size_t width, size_t srcPixelSize, const DepthRowParams& params, int16_t* pOut)
+{
+	const uint8_t* pIn = pRow;
+	for (size_t x = 0; x < width; x++, pIn += srcPixelSize)
+		pOut[x] = depthAt<Intensity>(pIn, params.coordinates.scale, params.minIntensity);
+}
+
+template <bool Intensity>
+static void
+heightRowScalar(const uint8_t* pRow, size_t width, size_t srcPixelSize, const DepthRowParams& params, int16_t* pOut)
+{
+	const uint8_t* pIn = pRow;
+	for (size_t x = 0; x < width; x++, pIn += srcPixelSize)
+		pOut[x] = heightAt<Intensity>(pIn, params.coordinates, params.floor, params.minIntensity);
+}
+
+#ifdef DEPTH_SSE2
+// Four pixels from two loads, deinterleaved into A0..A3 B0..B3 and
+// C0..C3 Y0..Y3
+static inline void
+deinterleave4(const uint8_t* pIn, __m128i& ab, __m128i& cy)
+{
+	const __m128i p01 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pIn));
+	const __m128i p23 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pIn + 16));
+	const __m128i t0 = _mm_unpacklo_epi16(p01, p23);
+	const __m128i t1 = _mm_unpackhi_epi16(p01, p23);
+	ab = _mm_unpacklo_epi16(t0, t1);
+	cy = _mm_unpackhi_epi16(t0, t1);
+}
+
+template <bool Intensity>
+static void
+depthRowSse2(const uint8_t* pRow, size_t width, size_t /*srcPixelSize*/, const DepthRowParams& params, int16_t* pOut)
+{
+	const uint8_t* pIn = pRow;
+	size_t x = 0;
+
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i minY = _mm_set1_epi32(params.minIntensity);
+	const __m128 scale = _mm_set1_ps(params.coordinates.scale);
+
+	auto depth4 = [&](const uint8_t* p)
+	{
+		__m128i ab, cy;
+		deinterleave4(p, ab, cy);
+		const __m128i z = _mm_srai_epi32(_mm_unpacklo_epi16(cy, cy), 16);
+		__m128i mm = _mm_cvttps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(z), scale));
+		if (Intensity)
+			mm = _mm_andnot_si128(_mm_cmplt_epi32(_mm_unpackhi_epi16(cy, zero), minY), mm);
+		return mm;
+	};
+
+	for (; x + 8 <= width; x += 8)
+	{
+		const __m128i lo = depth4(pIn);
+		const __m128i hi = depth4(pIn + 32);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(pOut + x), _mm_packs_epi32(lo, hi));
+		pIn += 8 * 8;
+	}
+
+	for (; x < width; x++, pIn += 8)
+		pOut[x] = depthAt<Intensity>(pIn, params.coordinates.scale, params.minIntensity);
+}
+
+template <bool Intensity>
+static void
+heightRowSse2(const uint8_t* pRow, size_t width, size_t /*srcPixelSize*/, const DepthRowParams& params, int16_t* pOut)
+{
+	const ScanCoordinates& c = params.coordinates;
+	const FloorPlane& floor = params.floor;
+	const uint8_t* pIn = pRow;
+	size_t x = 0;
+
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i one = _mm_set1_epi32(1);
+	const __m128i minY = _mm_set1_epi32(params.minIntensity);
+	const __m128 scale = _mm_set1_ps(c.scale);
+	const __m128 offsetA = _mm_set1_ps(c.offsetA);
+	const __m128 offsetB = _mm_set1_ps(c.offsetB);
+	const __m128 nx = _mm_set1_ps(floor.normal[0]);
+	const __m128 ny = _mm_set1_ps(floor.normal[1]);
+	const __m128 nz = _mm_set1_ps(floor.normal[2]);
+	const __m128 d = _mm_set1_ps(floor.distance);
+
+	for (; x + 4 <= width; x += 4)
+	{
+		__m128i ab, cy;
+		deinterleave4(pIn, ab, cy);
+
+		const __m128i a = _mm_unpacklo_epi16(ab, zero);
+		const __m128i b = _mm_unpackhi_epi16(ab, zero);
+		const __m128i z = _mm_srai_epi32(_mm_unpacklo_epi16(cy, cy), 16);
+
+		const __m128 px = _mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(a), scale), offsetA);
+		const __m128 py = _mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(b), scale), offsetB);
+		const __m128 pz = _mm_mul_ps(_mm_cvtepi32_ps(z), scale);
+		const __m128 h = _mm_add_ps(_mm_add_ps(_mm_add_ps(
+			_mm_mul_ps(nx, px), _mm_mul_ps(ny, py)), _mm_mul_ps(nz, pz)), d);
+
+		// Clamp to [1, 32767]: the pack saturates the top, the bottom
+		// is a compare since SSE2 has no 32 bit max
+		__m128i rounded = _mm_cvtps_epi32(h);
+		const __m128i low = _mm_cmplt_epi32(rounded, one);
+		rounded = _mm_or_si128(_mm_and_si128(low, one), _mm_andnot_si128(low, rounded));
+
+		// Invalid where z is 0 or the intensity is too low
+		__m128i invalid = _mm_cmpeq_epi32(z, zero);
+		if (Intensity)
+			invalid = _mm_or_si128(invalid, _mm_cmplt_epi32(_mm_unpackhi_epi16(cy, zero), minY));
+		rounded = _mm_andnot_si128(invalid, rounded);
+
+		const __m128i packed = _mm_packs_epi32(rounded, rounded);
+		_mm_storel_epi64(reinterpret_cast<__m128i*>(pOut + x), packed);
+
+		pIn += 4 * 8;
+	}
+
+	for (; x < width; x++, pIn += 8)
+		pOut[x] = heightAt<Intensity>(pIn, c, floor, params.minIntensity);
+}
+#endif
+
+// Indexed by [height][intensity]
+static const DepthRowKernel ScalarKernels[2][2] =
+{
+	{ depthRowScalar<false>, depthRowScalar<true> },
+	{ heightRowScalar<false>, heightRowScalar<true> },
+};
+
+#ifdef DEPTH_SSE2
+static const DepthRowKernel Sse2Kernels[2][2] =
+{
+	{ depthRowSse2<false>, depthRowSse2<true> },
+	{ heightRowSse2<false>, heightRowSse2<true> },
+};
+#endif
+
+DepthRowKernel
+depthRowKernel(const DepthRowKernelKey& key)
+{
+	switch (key.simd)
+	{
+		case SimdLevel::Scalar:
+			return ScalarKernels[key.height][key.intensity];
+#ifdef DEPTH_SSE2
+		case SimdLevel::SSE2:
+			return Sse2Kernels[key.height][key.intensity];
+		case SimdLevel::AVX2:
+			return depthRowKernelAvx2(key.height, key.intensity);
+#endif
+		default:
+			return nullptr;
+	}
+}
+
+DepthRowKernel
+selectDepthRowKernel(const DepthRowKernelKey& key, size_t srcPixelSize)
+{
+	DepthRowKernelKey k = key;
+	if (srcPixelSize != 8)
+		k.simd = SimdLevel::Scalar;
+	k.simd = std::min(k.simd, detectSimdLevel());
+
+	// Scalar is always there
+	for (;; k.simd = SimdLevel(int32_t(k.simd) - 1))
+	{
+		const DepthRowKernel kernel = depthRowKernel(k);
+		if (kernel)
+			return kernel;
+	}
+}
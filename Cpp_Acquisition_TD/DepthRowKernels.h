@@ -0,0 +1,77 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <algorithm>
+#include <cmath>
+#include "CpuFeatures.h"
+#include "DepthKernels.h"
+#include "DepthRowTypes.h"
+
+// The row conversions behind extractDepth, from Coord3D_ABCY16 to the int16
+// depth or height plane. Each combination of options is its own template
+// instance with the choices made at compile time, so the inner loops have
+// no branches on them, and extractDepth picks one per call from a table.
+
+// The scalar kernels are these two in a loop, the SSE2 kernels use them
+// for the pixels left over at the end of a row. The AVX2 kernels have
+// copies of their own, see DepthRowTypes.h.
+
+// Isolates the z data of one pixel and converts it to millimeters.
+//    The first channel is the x coordinate, second channel is the y coordinate,
+//    the third channel is the z coordinate and the fourth channel is intensity.
+//    The z data converts at a specified ratio to mm, the Scan3dCoordinateScale
+//    for CoordinateC. Pixels whose intensity is too low to trust are dropped.
+template <bool Intensity>
+inline int16_t
+depthAt(const uint8_t* pIn, float scale, int32_t minIntensity)
+{
+	const int16_t z = *reinterpret_cast<const int16_t*>(pIn + 4);
+	const uint16_t intensity = *reinterpret_cast<const uint16_t*>(pIn + 6);
+	if (Intensity && intensity < minIntensity)
+		return 0;
+	// Truncated like _mm_cvttps_epi32
+	return int16_t(float(z) * scale);
+}
+
+// Height above the floor plane. The Helios A and B channels are unsigned,
+// C is read signed like everywhere else.
+template <bool Intensity>
+inline int16_t
+heightAt(const uint8_t* pIn, const ScanCoordinates& c, const FloorPlane& floor, int32_t minIntensity)
+{
+	const uint16_t a = *reinterpret_cast<const uint16_t*>(pIn);
+	const uint16_t b = *reinterpret_cast<const uint16_t*>(pIn + 2);
+	const int16_t z = *reinterpret_cast<const int16_t*>(pIn + 4);
+	const uint16_t intensity = *reinterpret_cast<const uint16_t*>(pIn + 6);
+
+	if (z == 0 || (Intensity && intensity < minIntensity))
+		return 0;
+
+	const float px = float(int32_t(a)) * c.scale + c.offsetA;
+	const float py = float(int32_t(b)) * c.scale + c.offsetB;
+	const float pz = float(int32_t(z)) * c.scale;
+	const float h = floor.normal[0] * px + floor.normal[1] * py + floor.normal[2] * pz + floor.distance;
+
+	// Same rounding as _mm_cvtps_epi32
+	const int32_t rounded = int32_t(std::nearbyint(h));
+	return int16_t(std::min(32767, std::max(1, rounded)));
+}
+
+struct DepthRowKernelKey
+{
+	SimdLevel	simd = SimdLevel::Scalar;
+	// Heights above the floor plane instead of depth
+	bool		height = false;
+	// Drop the pixels below minIntensity, otherwise it isn't looked at
+	bool		intensity = false;
+};
+
+// The kernel for exactly this key, nullptr if that instruction set wasn't
+// compiled in. The SIMD kernels only take 8 byte (ABCY16) pixels.
+DepthRowKernel	depthRowKernel(const DepthRowKernelKey& key);
+
+// The fastest kernel for the key that runs on this CPU and takes pixels of
+// srcPixelSize bytes, going down to scalar if need be
+DepthRowKernel	selectDepthRowKernel(const DepthRowKernelKey& key, size_t srcPixelSize);
+
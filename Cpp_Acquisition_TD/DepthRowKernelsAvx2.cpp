@@ -0,0 +1,172 @@
+#include "DepthRowTypes.h"
+
+// The project builds this file, and only this one, with /arch:AVX2. The
+// kernels here are only handed out once detectSimdLevel() found AVX2, so
+// the rest of the plugin still runs on any x64 CPU. That only holds as long
+// as nothing here is shared with the other files: an inline function or
+// template instantiated here comes out as AVX2 code, and the linker keeps
+// one copy of it for the whole DLL. So this file skips the precompiled
+// header and the standard library, and has its own static copies of
+// depthAt and heightAt for the ends of the rows.
+#ifdef __AVX2__
+#include <immintrin.h>
+
+template <bool Intensity>
+static inline int16_t
+depthTail(const uint8_t* pIn, float scale, int32_t minIntensity)
+{
+	const int16_t z = *reinterpret_cast<const int16_t*>(pIn + 4);
+	const uint16_t intensity = *reinterpret_cast<const uint16_t*>(pIn + 6);
+	if (Intensity && intensity < minIntensity)
+		return 0;
+	return int16_t(float(z) * scale);
+}
+
+template <bool Intensity>
+static inline int16_t
+heightTail(const uint8_t* pIn, const ScanCoordinates& c, const FloorPlane& floor, int32_t minIntensity)
+{
+	const uint16_t a = *reinterpret_cast<const uint16_t*>(pIn);
+	const uint16_t b = *reinterpret_cast<const uint16_t*>(pIn + 2);
+	const int16_t z = *reinterpret_cast<const int16_t*>(pIn + 4);
+	const uint16_t intensity = *reinterpret_cast<const uint16_t*>(pIn + 6);
+
+	if (z == 0 || (Intensity && intensity < minIntensity))
+		return 0;
+
+	const float px = float(int32_t(a)) * c.scale + c.offsetA;
+	const float py = float(int32_t(b)) * c.scale + c.offsetB;
+	const float pz = float(int32_t(z)) * c.scale;
+	const float h = floor.normal[0] * px + floor.normal[1] * py + floor.normal[2] * pz + floor.distance;
+
+	// Rounds to nearest even like std::nearbyint does in heightAt
+	const int32_t rounded = _mm_cvtss_si32(_mm_set_ss(h));
+	return int16_t(rounded < 1 ? 1 : rounded > 32767 ? 32767 : rounded);
+}
+
+// Eight pixels from two loads. The unpacks stay within each 128 bit half,
+// so both come out in the pixel order 0 1 4 5 2 3 6 7: ab holds the A and
+// B of that order, cy the C and Y.
+static inline void
+deinterleave8(const uint8_t* pIn, __m256i& ab, __m256i& cy)
+{
+	const __m256i p0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pIn));
+	const __m256i p1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pIn + 32));
+	const __m256i t0 = _mm256_unpacklo_epi16(p0, p1);
+	const __m256i t1 = _mm256_unpackhi_epi16(p0, p1);
+	ab = _mm256_unpacklo_epi16(t0, t1);
+	cy = _mm256_unpackhi_epi16(t0, t1);
+}
+
+// Puts eight int32 in the 0 1 4 5 2 3 6 7 order back in pixel order and
+// saturates them to int16
+static inline __m128i
+packInOrder(__m256i v)
+{
+	const __m256i order = _mm256_setr_epi32(0, 1, 4, 5, 2, 3, 6, 7);
+	v = _mm256_permutevar8x32_epi32(v, order);
+	return _mm_packs_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+}
+
+template <bool Intensity>
+static void
+depthRowAvx2(const uint8_t* pRow, size_t width, size_t /*srcPixelSize*/, const DepthRowParams& params, int16_t* pOut)
+{
+	const uint8_t* pIn = pRow;
+	size_t x = 0;
+
+	const __m256i zero = _mm256_setzero_si256();
+	const __m256i minY = _mm256_set1_epi32(params.minIntensity);
+	const __m256 scale = _mm256_set1_ps(params.coordinates.scale);
+
+	for (; x + 8 <= width; x += 8)
+	{
+		__m256i ab, cy;
+		deinterleave8(pIn, ab, cy);
+		const __m256i z = _mm256_srai_epi32(_mm256_unpacklo_epi16(cy, cy), 16);
+		__m256i mm = _mm256_cvttps_epi32(_mm256_mul_ps(_mm256_cvtepi32_ps(z), scale));
+		if (Intensity)
+			mm = _mm256_andnot_si256(_mm256_cmpgt_epi32(minY, _mm256_unpackhi_epi16(cy, zero)), mm);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(pOut + x), packInOrder(mm));
+		pIn += 8 * 8;
+	}
+
+	for (; x < width; x++, pIn += 8)
+		pOut[x] = depthTail<Intensity>(pIn, params.coordinates.scale, params.minIntensity);
+}
+
+template <bool Intensity>
+static void
+heightRowAvx2(const uint8_t* pRow, size_t width, size_t /*srcPixelSize*/, const DepthRowParams& params, int16_t* pOut)
+{
+	const ScanCoordinates& c = params.coordinates;
+	const FloorPlane& floor = params.floor;
+	const uint8_t* pIn = pRow;
+	size_t x = 0;
+
+	const __m256i zero = _mm256_setzero_si256();
+	const __m256i one = _mm256_set1_epi32(1);
+	const __m256i minY = _mm256_set1_epi32(params.minIntensity);
+	const __m256 scale = _mm256_set1_ps(c.scale);
+	const __m256 offsetA = _mm256_set1_ps(c.offsetA);
+	const __m256 offsetB = _mm256_set1_ps(c.offsetB);
+	const __m256 nx = _mm256_set1_ps(floor.normal[0]);
+	const __m256 ny = _mm256_set1_ps(floor.normal[1]);
+	const __m256 nz = _mm256_set1_ps(floor.normal[2]);
+	const __m256 d = _mm256_set1_ps(floor.distance);
+
+	for (; x + 8 <= width; x += 8)
+	{
+		__m256i ab, cy;
+		deinterleave8(pIn, ab, cy);
+
+		const __m256i a = _mm256_unpacklo_epi16(ab, zero);
+		const __m256i b = _mm256_unpackhi_epi16(ab, zero);
+		const __m256i z = _mm256_srai_epi32(_mm256_unpacklo_epi16(cy, cy), 16);
+
+		// Multiplies and adds kept apart rather than fused, so the heights
+		// round exactly like the SSE2 and scalar kernels'
+		const __m256 px = _mm256_add_ps(_mm256_mul_ps(_mm256_cvtepi32_ps(a), scale), offsetA);
+		const __m256 py = _mm256_add_ps(_mm256_mul_ps(_mm256_cvtepi32_ps(b), scale), offsetB);
+		const __m256 pz = _mm256_mul_ps(_mm256_cvtepi32_ps(z), scale);
+		const __m256 h = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(
+			_mm256_mul_ps(nx, px), _mm256_mul_ps(ny, py)), _mm256_mul_ps(nz, pz)), d);
+
+		// At least 1, the pack saturates the top
+		__m256i rounded = _mm256_max_epi32(_mm256_cvtps_epi32(h), one);
+
+		__m256i invalid = _mm256_cmpeq_epi32(z, zero);
+		if (Intensity)
+			invalid = _mm256_or_si256(invalid, _mm256_cmpgt_epi32(minY, _mm256_unpackhi_epi16(cy, zero)));
+		rounded = _mm256_andnot_si256(invalid, rounded);
+
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(pOut + x), packInOrder(rounded));
+		pIn += 8 * 8;
+	}
+
+	for (; x < width; x++, pIn += 8)
+		pOut[x] = heightTail<Intensity>(pIn, c, floor, params.minIntensity);
+}
+
+// Indexed by [height][intensity]
+static const DepthRowKernel Avx2Kernels[2][2] =
+{
+	{ depthRowAvx2<false>, depthRowAvx2<true> },
+	{ heightRowAvx2<false>, heightRowAvx2<true> },
+};
+
+DepthRowKernel
+depthRowKernelAvx2(bool height, bool intensity)
+{
+	return Avx2Kernels[height][intensity];
+}
+
+#else
+
+DepthRowKernel
+depthRowKernelAvx2(bool /*height*/, bool /*intensity*/)
+{
+	return nullptr;
+}
+
+#endif
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+// What the row conversion kernels take. Kept apart from DepthKernels.h and
+// DepthRowKernels.h, and free of inline code, because DepthRowKernelsAvx2.cpp
+// includes it: an inline function that file instantiated would be built
+// for AVX2, and the linker could pick that copy for every other file too.
+
+// How the raw A/B/C channels map to mm: value * scale + offset. The
+// Helios cameras share one Scan3dCoordinateScale between the channels, and
+// only A and B have an offset.
+struct ScanCoordinates
+{
+	float		scale = 1.0f;
+	float		offsetA = 0.0f;
+	float		offsetB = 0.0f;
+};
+
+// A plane in camera space (mm), with the normal pointing towards the
+// camera, so normal . p + distance is the height of p above it.
+struct FloorPlane
+{
+	bool		valid = false;
+	float		normal[3] = { 0.0f, 0.0f, 1.0f };
+	float		distance = 0.0f;
+};
+
+struct DepthRowParams
+{
+	ScanCoordinates		coordinates;
+	// Only read by the height kernels
+	FloorPlane			floor;
+	int32_t				minIntensity = 0;
+};
+
+// Converts width pixels of srcPixelSize bytes each
+typedef void (*DepthRowKernel)(const uint8_t* pRow, size_t width, size_t srcPixelSize,
+	const DepthRowParams& params, int16_t* pOut);
+
+// Defined in DepthRowKernelsAvx2.cpp, which is the only file built with
+// AVX2 enabled. nullptr if the compiler didn't build it that way.
+DepthRowKernel	depthRowKernelAvx2(bool height, bool intensity);
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <stdio.h>
+
+// fopen, without MSVC's deprecation warning. Returns nullptr if the file
+// can't be opened.
+inline FILE*
+openFile(const char* path, const char* mode)
+{
+#ifdef _WIN32
+	FILE* file = nullptr;
+	if (fopen_s(&file, path, mode) != 0)
+		return nullptr;
+	return file;
+#else
+	return fopen(path, mode);
+#endif
+}
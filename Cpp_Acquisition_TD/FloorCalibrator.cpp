@@ -0,0 +1,266 @@
+#include "stdafx.h"
+#include "FloorCalibrator.h"
+#include "FileIo.h"
+#include <cmath>
+#include <random>
+#include <stdio.h>
+
+static const int Iterations = 400;
+// Points closer than this (mm) to a candidate plane count as on it
+static const float InlierDistance = 20.0f;
+
+bool
+saveFloorPlane(const char* path, const FloorPlane& plane)
+{
+	FILE* file = openFile(path, "w");
+	if (!file)
+		return false;
+
+	fprintf(file, "%.9g %.9g %.9g %.9g\n", plane.normal[0], plane.normal[1], plane.normal[2], plane.distance);
+	return fclose(file) == 0;
+}
+
+bool
+loadFloorPlane(const char* path, FloorPlane* plane)
+{
+	FILE* file = openFile(path, "r");
+	if (!file)
+		return false;
+
+	FloorPlane p;
+#ifdef _WIN32
+	const int n = fscanf_s(file, "%f %f %f %f", &p.normal[0], &p.normal[1], &p.normal[2], &p.distance);
+#else
+	const int n = fscanf(file, "%f %f %f %f", &p.normal[0], &p.normal[1], &p.normal[2], &p.distance);
+#endif
+	fclose(file);
+	if (n != 4)
+		return false;
+
+	const float length = std::sqrt(p.normal[0] * p.normal[0] + p.normal[1] * p.normal[1] + p.normal[2] * p.normal[2]);
+	if (!(length > 0.0f))
+		return false;
+
+	p.normal[0] /= length;
+	p.normal[1] /= length;
+	p.normal[2] /= length;
+	p.distance /= length;
+	p.valid = true;
+	*plane = p;
+	return true;
+}
+
+FloorCalibrator::FloorCalibrator() :
+	myThread(nullptr),
+	myRunning(false),
+	myHasResult(false)
+{
+}
+
+FloorCalibrator::~FloorCalibrator()
+{
+	if (myThread)
+	{
+		myThread->join();
+		delete myThread;
+	}
+}
+
+bool
+FloorCalibrator::start(std::vector<float>& xyz)
+{
+	{
+		std::lock_guard<std::mutex> lock(myLock);
+		if (myRunning)
+			return false;
+		myRunning = true;
+	}
+
+	if (myThread)
+	{
+		myThread->join();
+		delete myThread;
+	}
+
+	myPoints.swap(xyz);
+	myThread = new std::thread([this]()
+	{
+		const FloorPlane plane = fit(myPoints);
+
+		std::lock_guard<std::mutex> lock(myLock);
+		myResult = plane;
+		myHasResult = true;
+		myRunning = false;
+	});
+	return true;
+}
+
+bool
+FloorCalibrator::takeResult(FloorPlane* plane)
+{
+	std::lock_guard<std::mutex> lock(myLock);
+	if (!myHasResult)
+		return false;
+
+	*plane = myResult;
+	myHasResult = false;
+	return true;
+}
+
+// Plane through three points, false if they're (nearly) on a line
+static bool
+planeThrough(const float* a, const float* b, const float* c, FloorPlane* plane)
+{
+	const float u[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+	const float v[3] = { c[0] - a[0], c[1] - a[1], c[2] - a[2] };
+	float n[3] =
+	{
+		u[1] * v[2] - u[2] * v[1],
+		u[2] * v[0] - u[0] * v[2],
+		u[0] * v[1] - u[1] * v[0]
+	};
+
+	const float length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+	if (length < 1e-3f)
+		return false;
+
+	plane->normal[0] = n[0] / length;
+	plane->normal[1] = n[1] / length;
+	plane->normal[2] = n[2] / length;
+	plane->distance = -(plane->normal[0] * a[0] + plane->normal[1] * a[1] + plane->normal[2] * a[2]);
+	plane->valid = true;
+	return true;
+}
+
+static inline float
+distanceTo(const FloorPlane& plane, const float* p)
+{
+	return plane.normal[0] * p[0] + plane.normal[1] * p[1] + plane.normal[2] * p[2] + plane.distance;
+}
+
+// Least squares plane through the inliers of the given plane: the normal
+// is the eigenvector of the smallest eigenvalue of their covariance, which
+// is found with a few rounds of inverse iteration starting from the
+// RANSAC normal.
+static FloorPlane
+refine(const std::vector<float>& xyz, const FloorPlane& plane)
+{
+	const size_t count = xyz.size() / 3;
+
+	double mean[3] = { 0.0, 0.0, 0.0 };
+	size_t n = 0;
+	for (size_t i = 0; i < count; i++)
+	{
+		const float* p = &xyz[3 * i];
+		if (std::fabs(distanceTo(plane, p)) > InlierDistance)
+			continue;
+		mean[0] += p[0];
+		mean[1] += p[1];
+		mean[2] += p[2];
+		n++;
+	}
+	if (n < 3)
+		return plane;
+	for (int k = 0; k < 3; k++)
+		mean[k] /= double(n);
+
+	double c[3][3] = { { 0.0 } };
+	for (size_t i = 0; i < count; i++)
+	{
+		const float* p = &xyz[3 * i];
+		if (std::fabs(distanceTo(plane, p)) > InlierDistance)
+			continue;
+		const double d[3] = { p[0] - mean[0], p[1] - mean[1], p[2] - mean[2] };
+		for (int r = 0; r < 3; r++)
+			for (int k = 0; k < 3; k++)
+				c[r][k] += d[r] * d[k];
+	}
+
+	// Inverse of the covariance, through its adjugate
+	const double det =
+		c[0][0] * (c[1][1] * c[2][2] - c[1][2] * c[2][1]) -
+		c[0][1] * (c[1][0] * c[2][2] - c[1][2] * c[2][0]) +
+		c[0][2] * (c[1][0] * c[2][1] - c[1][1] * c[2][0]);
+	if (std::fabs(det) < 1e-12)
+		return plane;
+
+	double inv[3][3];
+	inv[0][0] = (c[1][1] * c[2][2] - c[1][2] * c[2][1]) / det;
+	inv[0][1] = (c[0][2] * c[2][1] - c[0][1] * c[2][2]) / det;
+	inv[0][2] = (c[0][1] * c[1][2] - c[0][2] * c[1][1]) / det;
+	inv[1][0] = (c[1][2] * c[2][0] - c[1][0] * c[2][2]) / det;
+	inv[1][1] = (c[0][0] * c[2][2] - c[0][2] * c[2][0]) / det;
+	inv[1][2] = (c[0][2] * c[1][0] - c[0][0] * c[1][2]) / det;
+	inv[2][0] = (c[1][0] * c[2][1] - c[1][1] * c[2][0]) / det;
+	inv[2][1] = (c[0][1] * c[2][0] - c[0][0] * c[2][1]) / det;
+	inv[2][2] = (c[0][0] * c[1][1] - c[0][1] * c[1][0]) / det;
+
+	double normal[3] = { plane.normal[0], plane.normal[1], plane.normal[2] };
+	for (int iteration = 0; iteration < 8; iteration++)
+	{
+		double next[3];
+		for (int r = 0; r < 3; r++)
+			next[r] = inv[r][0] * normal[0] + inv[r][1] * normal[1] + inv[r][2] * normal[2];
+		const double length = std::sqrt(next[0] * next[0] + next[1] * next[1] + next[2] * next[2]);
+		if (!(length > 0.0))
+			return plane;
+		for (int r = 0; r < 3; r++)
+			normal[r] = next[r] / length;
+	}
+
+	FloorPlane refined;
+	refined.valid = true;
+	for (int k = 0; k < 3; k++)
+		refined.normal[k] = float(normal[k]);
+	refined.distance = float(-(normal[0] * mean[0] + normal[1] * mean[1] + normal[2] * mean[2]));
+	return refined;
+}
+
+FloorPlane
+FloorCalibrator::fit(const std::vector<float>& xyz)
+{
+	FloorPlane best;
+	const size_t count = xyz.size() / 3;
+	if (count < 3)
+		return best;
+
+	// Fixed seed, so the same points always give the same plane
+	std::mt19937 random(12345);
+	std::uniform_int_distribution<size_t> pick(0, count - 1);
+
+	size_t bestInliers = 0;
+	for (int iteration = 0; iteration < Iterations; iteration++)
+	{
+		FloorPlane candidate;
+		if (!planeThrough(&xyz[3 * pick(random)], &xyz[3 * pick(random)], &xyz[3 * pick(random)], &candidate))
+			continue;
+
+		size_t inliers = 0;
+		for (size_t i = 0; i < count; i++)
+		{
+			if (std::fabs(distanceTo(candidate, &xyz[3 * i])) <= InlierDistance)
+				inliers++;
+		}
+
+		if (inliers > bestInliers)
+		{
+			bestInliers = inliers;
+			best = candidate;
+		}
+	}
+
+	if (!best.valid)
+		return best;
+
+	best = refine(xyz, best);
+
+	// The camera, at the origin, is above the floor
+	if (best.distance < 0.0f)
+	{
+		best.normal[0] = -best.normal[0];
+		best.normal[1] = -best.normal[1];
+		best.normal[2] = -best.normal[2];
+		best.distance = -best.distance;
+	}
+	return best;
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "DepthKernels.h"
+
+// Plain text "nx ny nz distance", so the plane can also be typed in
+bool	saveFloorPlane(const char* path, const FloorPlane& plane);
+bool	loadFloorPlane(const char* path, FloorPlane* plane);
+
+// Fits the dominant plane through a set of points with RANSAC and refines
+// it with a least squares fit over the inliers. The fit runs on a thread of
+// its own, it takes a few tens of milliseconds which is more than a frame.
+class FloorCalibrator
+{
+public:
+	FloorCalibrator();
+	~FloorCalibrator();
+
+	FloorCalibrator(const FloorCalibrator&) = delete;
+	FloorCalibrator& operator=(const FloorCalibrator&) = delete;
+
+	// Starts a fit on x, y, z triplets (mm). Returns false, and leaves the
+	// points alone, if the last fit is still running.
+	bool		start(std::vector<float>& xyz);
+
+	// True once, when a fit has finished. plane->valid is false if no
+	// plane could be found.
+	bool		takeResult(FloorPlane* plane);
+
+	// Runs the fit on the calling thread
+	static FloorPlane	fit(const std::vector<float>& xyz);
+
+private:
+	std::thread*		myThread;
+	std::vector<float>	myPoints;
+
+	std::mutex			myLock;
+	bool				myRunning;
+	bool				myHasResult;
+	FloorPlane			myResult;
+};
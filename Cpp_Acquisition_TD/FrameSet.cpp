@@ -0,0 +1,107 @@
+#include "stdafx.h"
+#include "FrameSet.h"
+#include <algorithm>
+#include <chrono>
+
+typedef std::chrono::steady_clock Clock;
+
+// Takes the device's next frame, or nullptr if none came within the time
+static Arena::IImage*
+takeImage(Arena::IDevice* device, Clock::time_point deadline)
+{
+	const int64_t ms = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - Clock::now()).count();
+	try
+	{
+		// 0 would only take a frame that's already there
+		return device->GetImage(uint64_t(std::max<int64_t>(ms, 1)));
+	}
+	catch (GenICam::GenericException&)
+	{
+		return nullptr;
+	}
+}
+
+FrameSetAssembler::FrameSetAssembler() :
+	mySpread(0.0),
+	myDropped(0)
+{
+}
+
+void
+FrameSetAssembler::assemble(const std::vector<Arena::IDevice*>& devices, const FrameSetSettings& settings,
+	uint64_t timeout, std::vector<Arena::IImage*>* images)
+{
+	const size_t count = devices.size();
+	images->assign(count, nullptr);
+	myOffsets.assign(count, 0.0);
+	mySpread = 0.0;
+	myDropped = 0;
+	if (count == 0)
+		return;
+
+	// The primary camera paces the output like it does without alignment,
+	// the others get maxWait from when its frame is in
+	(*images)[0] = takeImage(devices[0], Clock::now() + std::chrono::milliseconds(timeout));
+	if (!(*images)[0])
+	{
+		myDropped = count;
+		return;
+	}
+	const Clock::time_point deadline = Clock::now() +
+		std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(settings.maxWait));
+	for (size_t i = 1; i < count; i++)
+		(*images)[i] = takeImage(devices[i], deadline);
+
+	const uint64_t tolerance = uint64_t(settings.tolerance * 1e9);
+	auto newest = [&]()
+	{
+		uint64_t t = 0;
+		for (Arena::IImage* image : *images)
+		{
+			if (image)
+				t = std::max(t, image->GetTimestampNs());
+		}
+		return t;
+	};
+
+	// Frames from before the newest one, by more than the tolerance, are
+	// replaced by the camera's next one. A newer frame can move the newest
+	// on, which makes others too old in turn, so it goes round until
+	// nothing changes or the time is up.
+	bool changed = true;
+	while (changed && Clock::now() < deadline)
+	{
+		changed = false;
+		const uint64_t reference = newest();
+		for (size_t i = 0; i < count; i++)
+		{
+			Arena::IImage*& image = (*images)[i];
+			if (!image || image->GetTimestampNs() + tolerance >= reference)
+				continue;
+			devices[i]->RequeueBuffer(image);
+			image = takeImage(devices[i], deadline);
+			changed = true;
+		}
+	}
+
+	// Whatever still doesn't line up is left out
+	const uint64_t reference = newest();
+	uint64_t oldest = reference;
+	for (size_t i = 0; i < count; i++)
+	{
+		Arena::IImage*& image = (*images)[i];
+		if (image && image->GetTimestampNs() + tolerance < reference)
+		{
+			devices[i]->RequeueBuffer(image);
+			image = nullptr;
+		}
+		if (!image)
+		{
+			myDropped++;
+			continue;
+		}
+		oldest = std::min(oldest, image->GetTimestampNs());
+		myOffsets[i] = -double(reference - image->GetTimestampNs()) * 1e-9;
+	}
+	mySpread = double(reference - oldest) * 1e-9;
+}
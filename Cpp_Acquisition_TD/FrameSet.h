@@ -0,0 +1,47 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+#include "ArenaApi.h"
+
+// How closely the frames of the cameras have to line up to be fused as one
+// set. Their timestamps only share a clock when the cameras are PTP synced.
+struct FrameSetSettings
+{
+	// Off takes whatever frame each camera has next
+	bool		align = false;
+	// Most seconds apart the frames of a set may be. Multiplexed cameras
+	// are a slot apart, so it has to cover the trigger cycle.
+	double		tolerance = 0.002;
+	// Most seconds to wait for the other cameras to catch up with the
+	// primary one. A camera that doesn't is left out of the set.
+	double		maxWait = 0.040;
+};
+
+// Gathers a frame from every camera, taken within the tolerance of each
+// other by their timestamps
+class FrameSetAssembler
+{
+public:
+	FrameSetAssembler();
+
+	// Waits up to timeout ms for the primary camera, devices[0], and then
+	// takes the others' frames, skipping the ones too old to match, until
+	// the set lines up or maxWait has passed. images[i] is the frame of
+	// devices[i], or nullptr if it was left out. Without a primary frame
+	// the set is empty. The caller requeues them.
+	void		assemble(const std::vector<Arena::IDevice*>& devices, const FrameSetSettings& settings,
+					uint64_t timeout, std::vector<Arena::IImage*>* images);
+
+	// Of the last set, seconds each frame was taken after the newest one
+	// (so 0 or less, and 0 for the ones left out), how far the first and
+	// last frame were apart, and how many cameras were left out
+	const std::vector<double>&	offsets() const { return myOffsets; }
+	double		spread() const { return mySpread; }
+	size_t		dropped() const { return myDropped; }
+
+private:
+	std::vector<double>	myOffsets;
+	double		mySpread;
+	size_t		myDropped;
+};
@@ -0,0 +1,178 @@
+#include "stdafx.h"
+#include "FusionGrid.h"
+#include "FileIo.h"
+#include "OutputWriter.h"
+#include "WorkerPool.h"
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <new>
+
+bool
+loadCameraPoses(const char* path, std::vector<CameraPose>* poses)
+{
+	FILE* file = openFile(path, "r");
+	if (!file)
+		return false;
+
+	std::vector<CameraPose> result;
+	bool ok = true;
+	char line[1024];
+	while (ok && fgets(line, sizeof(line), file))
+	{
+		const char* p = line;
+		while (*p == ' ' || *p == '\t')
+			p++;
+		if (*p == '#' || *p == '\n' || *p == '\r' || *p == '\0')
+			continue;
+
+		CameraPose pose;
+		char serial[64];
+		float* r = pose.rotation;
+		float* t = pose.translation;
+#ifdef _WIN32
+		const int n = sscanf_s(p, "%63s %f %f %f %f %f %f %f %f %f %f %f %f", serial, unsigned(sizeof(serial)),
+			&r[0], &r[1], &r[2], &r[3], &r[4], &r[5], &r[6], &r[7], &r[8], &t[0], &t[1], &t[2]);
+#else
+		const int n = sscanf(p, "%63s %f %f %f %f %f %f %f %f %f %f %f %f", serial,
+			&r[0], &r[1], &r[2], &r[3], &r[4], &r[5], &r[6], &r[7], &r[8], &t[0], &t[1], &t[2]);
+#endif
+		if (n != 13)
+		{
+			ok = false;
+			break;
+		}
+		pose.serial = serial;
+		result.push_back(pose);
+	}
+	fclose(file);
+
+	if (!ok)
+		return false;
+	poses->swap(result);
+	return true;
+}
+
+const CameraPose*
+findCameraPose(const std::vector<CameraPose>& poses, const std::string& serial)
+{
+	for (const CameraPose& pose : poses)
+	{
+		if (pose.serial == serial)
+			return &pose;
+	}
+	return nullptr;
+}
+
+FusionGrid::FusionGrid() :
+	myWidth(0),
+	myHeight(0)
+{
+}
+
+void
+FusionGrid::begin(const HeightmapSettings& settings)
+{
+	mySettings = settings;
+	myWidth = size_t(std::max(1, settings.width));
+	myHeight = size_t(std::max(1, settings.height));
+	const size_t count = myWidth * myHeight;
+	myCells.resize(count);
+
+	// AlignedBuffer hands out raw memory, the atomics only exist once
+	// they're constructed in it. They need no destructor, so the next
+	// begin() can construct over them again.
+	for (size_t i = 0; i < count; i++)
+		new (&myCells[i]) std::atomic<int32_t>(0);
+}
+
+void
+FusionGrid::add(const uint8_t* pInput, const int16_t* valid, size_t width, size_t height,
+	size_t srcBpp, const ScanCoordinates& coordinates, const CameraPose& pose)
+{
+	// Grid position = (world - (center - size / 2)) * cells / size
+	const float scaleX = float(myWidth / mySettings.sizeX);
+	const float scaleY = float(myHeight / mySettings.sizeY);
+	const float originX = float(mySettings.centerX - mySettings.sizeX / 2.0);
+	const float originY = float(mySettings.centerY - mySettings.sizeY / 2.0);
+
+	// Fold the grid mapping into the pose, so each point costs three dot
+	// products
+	const float* r = pose.rotation;
+	const float* t = pose.translation;
+	const float gx[4] = { r[0] * scaleX, r[1] * scaleX, r[2] * scaleX, (t[0] - originX) * scaleX };
+	const float gy[4] = { r[3] * scaleY, r[4] * scaleY, r[5] * scaleY, (t[1] - originY) * scaleY };
+	const float gz[4] = { r[6], r[7], r[8], t[2] };
+
+	const size_t srcPixelSize = srcBpp / 8;
+	const float s = coordinates.scale;
+	const float gridWidth = float(myWidth);
+	const float gridHeight = float(myHeight);
+	std::atomic<int32_t>* cells = myCells.data();
+
+	for (size_t y = 0; y < height; y++)
+	{
+		const uint8_t* pIn = pInput + y * width * srcPixelSize;
+		const int16_t* v = valid + y * width;
+		for (size_t x = 0; x < width; x++, pIn += srcPixelSize)
+		{
+			if (!v[x])
+				continue;
+
+			const float px = float(*reinterpret_cast<const uint16_t*>(pIn)) * s + coordinates.offsetA;
+			const float py = float(*reinterpret_cast<const uint16_t*>(pIn + 2)) * s + coordinates.offsetB;
+			const float pz = float(*reinterpret_cast<const int16_t*>(pIn + 4)) * s;
+
+			const float mx = gx[0] * px + gx[1] * py + gx[2] * pz + gx[3];
+			const float my = gy[0] * px + gy[1] * py + gy[2] * pz + gy[3];
+			if (!(mx >= 0.0f && my >= 0.0f && mx < gridWidth && my < gridHeight))
+				continue;
+
+			// 0 marks an empty cell, so anything at or below the floor is 1
+			const float h = gz[0] * px + gz[1] * py + gz[2] * pz + gz[3];
+			const int32_t value = int32_t(std::min(1e9f, std::max(1.0f, h)));
+
+			// Atomic max: retry only while another camera is writing a
+			// lower value to the same cell
+			std::atomic<int32_t>& cell = cells[size_t(my) * myWidth + size_t(mx)];
+			int32_t current = cell.load(std::memory_order_relaxed);
+			while (value > current &&
+				!cell.compare_exchange_weak(current, value, std::memory_order_relaxed))
+			{
+			}
+		}
+	}
+}
+
+void
+FusionGrid::resolve(float* pOut, WorkerPool* pool)
+{
+	const std::atomic<int32_t>* cells = myCells.data();
+	const bool stream = canStream(pOut, OutputStores::Streaming);
+
+	auto rows = [&](size_t begin, size_t end)
+	{
+		for (size_t row = begin; row < end; row++)
+		{
+			// TouchDesigner's rows go bottom-up, just like the world's y
+			float* pixel = pOut + 4 * row * myWidth;
+			const std::atomic<int32_t>* cell = cells + row * myWidth;
+			for (size_t x = 0; x < myWidth; x++, pixel += 4)
+			{
+				const int32_t value = cell[x].load(std::memory_order_relaxed);
+				const float v = float(value);
+				if (stream)
+					writePixel<true>(pixel, v, v, v, value ? 1.0f : 0.0f);
+				else
+					writePixel<false>(pixel, v, v, v, value ? 1.0f : 0.0f);
+			}
+		}
+		if (stream)
+			writeFence();
+	};
+
+	if (pool)
+		pool->parallelFor(myHeight, rows, 16);
+	else
+		rows(0, myHeight);
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+#include <string>
+#include <vector>
+#include "AlignedBuffer.h"
+#include "DepthKernels.h"
+#include "HeightmapProjector.h"
+
+class WorkerPool;
+
+// Where a camera sits in the world: world = rotation * camera + translation,
+// in mm, with the world's z axis pointing up from the floor.
+struct CameraPose
+{
+	std::string		serial;
+	// Row major
+	float			rotation[9] = { 1.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f };
+	float			translation[3] = { 0.0f, 0.0f, 0.0f };
+};
+
+// Plain text, one camera per line:
+//   serial r00 r01 r02 r10 r11 r12 r20 r21 r22 tx ty tz
+// Empty lines and lines starting with # are skipped.
+bool				loadCameraPoses(const char* path, std::vector<CameraPose>* poses);
+const CameraPose*	findCameraPose(const std::vector<CameraPose>& poses, const std::string& serial);
+
+// Merges the points of several cameras into one top-down heightmap of the
+// world, keeping the highest point per cell. Every camera adds its points
+// from a thread of its own, straight into the shared grid: each cell is an
+// atomic that only ever grows, so the merge needs no locks and no per
+// camera copies of the grid.
+//
+// The grid covers the same kind of area as the single camera heightmap,
+// with HeightmapSettings' center and size in world x/y instead.
+class FusionGrid
+{
+public:
+	FusionGrid();
+
+	// Sizes the grid and empties it, before the cameras add their frames
+	void		begin(const HeightmapSettings& settings);
+
+	// Adds the points of one camera's frame that are non-zero in valid.
+	// Safe to call for several cameras at once.
+	void		add(const uint8_t* pInput, const int16_t* valid, size_t width, size_t height,
+					size_t srcBpp, const ScanCoordinates& coordinates, const CameraPose& pose);
+
+	// Writes the grid as settings.width x settings.height RGBA32Float
+	// pixels, with the height in mm in RGB and alpha 1 where any camera
+	// saw a point.
+	void		resolve(float* pOut, WorkerPool* pool);
+
+private:
+	HeightmapSettings					mySettings;
+	size_t								myWidth;
+	size_t								myHeight;
+	// Constructed by begin()
+	AlignedBuffer<std::atomic<int32_t>>	myCells;
+};
@@ -0,0 +1,87 @@
+#include "stdafx.h"
+#include "GigeTransport.h"
+#include "CameraNodes.h"
+
+void
+applyTransport(Arena::IDevice* device, const TransportSettings& settings)
+{
+	GenApi::INodeMap* nodeMap = device->GetNodeMap();
+	GenApi::INodeMap* streamMap = device->GetTLStreamNodeMap();
+
+	setBooleanNode(streamMap, "StreamAutoNegotiatePacketSize", settings.autoPacketSize);
+	if (!settings.autoPacketSize)
+	{
+		// Older firmware only has the GigE Vision name for it
+		if (getIntegerNode(nodeMap, "DeviceStreamChannelPacketSize", 0) != 0)
+			setIntegerNode(nodeMap, "DeviceStreamChannelPacketSize", settings.packetSize, 0);
+		else
+			setIntegerNode(nodeMap, "GevSCPSPacketSize", settings.packetSize, 0);
+	}
+	setBooleanNode(streamMap, "StreamPacketResendEnable", settings.packetResend);
+	// Frames that aren't taken in time are replaced by the next one, rather
+	// than queued up. The cameras the output doesn't read keep streaming,
+	// and would otherwise hand out frames several buffers old once it does.
+	setEnumerationNode(streamMap, "StreamBufferHandlingMode", "NewestOnly");
+
+	// The delay is counted in ticks of the camera's timestamp clock
+	const double ticksPerSecond = double(getIntegerNode(nodeMap, "GevTimestampTickFrequency", 1000000000));
+	setIntegerNode(nodeMap, "GevSCPD", int64_t(settings.packetDelay * ticksPerSecond / 1e9 + 0.5), 0);
+
+	if (settings.bandwidthLimit > 0.0)
+	{
+		setEnumerationNode(nodeMap, "DeviceLinkThroughputLimitMode", "On");
+		// In bytes per second
+		setIntegerNode(nodeMap, "DeviceLinkThroughputLimit", int64_t(settings.bandwidthLimit * 1e6 / 8.0), 0);
+	}
+	else
+	{
+		setEnumerationNode(nodeMap, "DeviceLinkThroughputLimitMode", "Off");
+	}
+	setIntegerNode(nodeMap, "DeviceLinkThroughputReserve", settings.bandwidthReserve, 0);
+}
+
+TransportMonitor::TransportMonitor() :
+	myStart(std::chrono::steady_clock::now()),
+	myBytes(0),
+	myFrames(0)
+{
+}
+
+void
+TransportMonitor::reset()
+{
+	myStart = std::chrono::steady_clock::now();
+	myBytes = 0;
+	myFrames = 0;
+	myStats = TransportStats();
+}
+
+bool
+TransportMonitor::addFrame(Arena::IDevice* device, size_t bytes)
+{
+	myBytes += bytes;
+	myFrames++;
+
+	const auto now = std::chrono::steady_clock::now();
+	const double seconds = std::chrono::duration<double>(now - myStart).count();
+	if (seconds < 1.0)
+		return false;
+
+	myStats.megabitsPerSecond = myBytes * 8.0 / seconds / 1e6;
+	myStats.framesPerSecond = myFrames / seconds;
+	myStart = now;
+	myBytes = 0;
+	myFrames = 0;
+
+	// Reading nodes goes over the network, which is why it's only done
+	// once a second
+	GenApi::INodeMap* nodeMap = device->GetNodeMap();
+	GenApi::INodeMap* streamMap = device->GetTLStreamNodeMap();
+	myStats.packetSize = getIntegerNode(nodeMap, "DeviceStreamChannelPacketSize",
+		getIntegerNode(nodeMap, "GevSCPSPacketSize", 0));
+	myStats.missedPackets = getIntegerNode(streamMap, "StreamMissedPacketCount", 0);
+	myStats.resendRequests = getIntegerNode(streamMap, "StreamResendRequestCount", 0);
+	myStats.incompleteImages = getIntegerNode(streamMap, "StreamIncompleteImageCount", 0);
+	myStats.lostFrames = getIntegerNode(streamMap, "StreamLostFrameCount", 0);
+	return true;
+}
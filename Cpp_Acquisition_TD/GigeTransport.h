@@ -0,0 +1,79 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <chrono>
+#include "ArenaApi.h"
+
+// How a camera sends its images over GigE. The packet size is only
+// negotiated when the stream starts, so these are applied with it stopped.
+struct TransportSettings
+{
+	// Let Arena find the largest packet the path to the camera carries,
+	// jumbo frames if the network adapter has them on. Otherwise
+	// packetSize is used as is.
+	bool		autoPacketSize = true;
+	int32_t		packetSize = 1500;
+	// The gap between the packets of an image (ns), which spreads the
+	// bursts of cameras sharing a link over time
+	int32_t		packetDelay = 0;
+	// Ask the camera to send lost packets again
+	bool		packetResend = true;
+	// The most the camera may send (Mbit/s), 0 for as much as the link
+	// takes. The limits of the cameras on one adapter should add up to
+	// less than it carries.
+	double		bandwidthLimit = 0.0;
+	// The part of the bandwidth (%) kept free for resent packets
+	int32_t		bandwidthReserve = 10;
+
+	bool		operator==(const TransportSettings& other) const
+				{
+					return autoPacketSize == other.autoPacketSize && packetSize == other.packetSize &&
+						packetDelay == other.packetDelay && packetResend == other.packetResend &&
+						bandwidthLimit == other.bandwidthLimit && bandwidthReserve == other.bandwidthReserve;
+				}
+	bool		operator!=(const TransportSettings& other) const { return !(*this == other); }
+};
+
+// What a camera's stream did over the last second or so
+struct TransportStats
+{
+	int64_t		packetSize = 0;
+	double		megabitsPerSecond = 0.0;
+	double		framesPerSecond = 0.0;
+	// Counted by the stream since it started
+	int64_t		missedPackets = 0;
+	int64_t		resendRequests = 0;
+	int64_t		incompleteImages = 0;
+	int64_t		lostFrames = 0;
+};
+
+// Programs the settings into the camera and its stream, clamped to what
+// they allow, and has the stream keep only the newest frame. Features the
+// camera lacks are left out. The stream has to be
+// stopped around this. Throws GenICam::GenericException if the camera
+// refuses a value.
+void			applyTransport(Arena::IDevice* device, const TransportSettings& settings);
+
+// Works out a camera's throughput from the images it delivers, and reads
+// its stream's packet counters along with it
+class TransportMonitor
+{
+public:
+	TransportMonitor();
+
+	// Starts counting over, after the stream restarted
+	void		reset();
+
+	// Counts an image of the given size. About once a second the rates are
+	// worked out and the counters read, and true is returned then.
+	bool		addFrame(Arena::IDevice* device, size_t bytes);
+
+	const TransportStats&	stats() const { return myStats; }
+
+private:
+	std::chrono::steady_clock::time_point	myStart;
+	size_t		myBytes;
+	size_t		myFrames;
+	TransportStats	myStats;
+};
@@ -0,0 +1,159 @@
+#include "stdafx.h"
+#include "HeightmapProjector.h"
+#include "OutputWriter.h"
+#include "WorkerPool.h"
+#include <algorithm>
+#include <cmath>
+#include <string.h>
+
+HeightmapProjector::HeightmapProjector()
+{
+}
+
+void
+HeightmapProjector::apply(const uint8_t* pInput, const int16_t* valid, size_t width, size_t height,
+	size_t srcBpp, const ScanCoordinates& coordinates, const FloorPlane& floor,
+	double floorDistance, const HeightmapSettings& settings, WorkerPool* pool,
+	float* pOut)
+{
+	const size_t mapWidth = size_t(std::max(1, settings.width));
+	const size_t mapHeight = size_t(std::max(1, settings.height));
+	const size_t cells = mapWidth * mapHeight;
+
+	// Axes of the map: e1 and e2 along the floor, n up
+	float n[3];
+	float e1[3];
+	float e2[3];
+	float d;
+	if (floor.valid)
+	{
+		n[0] = floor.normal[0];
+		n[1] = floor.normal[1];
+		n[2] = floor.normal[2];
+		d = floor.distance;
+
+		// The camera's x axis laid flat on the floor
+		const float dot = n[0];
+		e1[0] = 1.0f - dot * n[0];
+		e1[1] = -dot * n[1];
+		e1[2] = -dot * n[2];
+		float length = std::sqrt(e1[0] * e1[0] + e1[1] * e1[1] + e1[2] * e1[2]);
+		if (length < 1e-3f)
+		{
+			// Camera x points straight up, use its y instead
+			e1[0] = -n[1] * n[0];
+			e1[1] = 1.0f - n[1] * n[1];
+			e1[2] = -n[1] * n[2];
+			length = std::sqrt(e1[0] * e1[0] + e1[1] * e1[1] + e1[2] * e1[2]);
+		}
+		for (int k = 0; k < 3; k++)
+			e1[k] /= length;
+
+		// e2 = n x e1, so e1, e2, n is right handed
+		e2[0] = n[1] * e1[2] - n[2] * e1[1];
+		e2[1] = n[2] * e1[0] - n[0] * e1[2];
+		e2[2] = n[0] * e1[1] - n[1] * e1[0];
+	}
+	else
+	{
+		// Looking straight down: up is towards the camera, and the image's
+		// y axis (down) becomes the map's -y
+		n[0] = 0.0f;
+		n[1] = 0.0f;
+		n[2] = -1.0f;
+		d = float(floorDistance);
+		e1[0] = 1.0f;
+		e1[1] = 0.0f;
+		e1[2] = 0.0f;
+		e2[0] = 0.0f;
+		e2[1] = -1.0f;
+		e2[2] = 0.0f;
+	}
+
+	// Map position = (world - (center - size / 2)) * cells / size
+	const float scaleX = float(mapWidth / settings.sizeX);
+	const float scaleY = float(mapHeight / settings.sizeY);
+	const float originX = float(settings.centerX - settings.sizeX / 2.0);
+	const float originY = float(settings.centerY - settings.sizeY / 2.0);
+
+	const size_t slices = pool ? pool->concurrency() : 1;
+	const size_t stride = (cells + 31) & ~size_t(31);
+	myBuffers.resize(slices * stride);
+
+	const size_t srcPixelSize = srcBpp / 8;
+	const float s = coordinates.scale;
+
+	auto scatter = [&](size_t begin, size_t end)
+	{
+		for (size_t slice = begin; slice < end; slice++)
+		{
+			int16_t* zbuffer = myBuffers.data() + slice * stride;
+			memset(zbuffer, 0, cells * sizeof(int16_t));
+
+			const size_t y0 = height * slice / slices;
+			const size_t y1 = height * (slice + 1) / slices;
+			for (size_t y = y0; y < y1; y++)
+			{
+				const uint8_t* pIn = pInput + y * width * srcPixelSize;
+				const int16_t* v = valid + y * width;
+				for (size_t x = 0; x < width; x++, pIn += srcPixelSize)
+				{
+					if (!v[x])
+						continue;
+
+					const float px = float(*reinterpret_cast<const uint16_t*>(pIn)) * s + coordinates.offsetA;
+					const float py = float(*reinterpret_cast<const uint16_t*>(pIn + 2)) * s + coordinates.offsetB;
+					const float pz = float(*reinterpret_cast<const int16_t*>(pIn + 4)) * s;
+
+					const float mx = ((e1[0] * px + e1[1] * py + e1[2] * pz) - originX) * scaleX;
+					const float my = ((e2[0] * px + e2[1] * py + e2[2] * pz) - originY) * scaleY;
+					if (!(mx >= 0.0f && my >= 0.0f && mx < float(mapWidth) && my < float(mapHeight)))
+						continue;
+
+					const float h = n[0] * px + n[1] * py + n[2] * pz + d;
+					const int16_t value = int16_t(std::min(32767.0f, std::max(1.0f, h)));
+
+					int16_t& cell = zbuffer[size_t(my) * mapWidth + size_t(mx)];
+					if (value > cell)
+						cell = value;
+				}
+			}
+		}
+	};
+
+	const bool stream = canStream(pOut, OutputStores::Streaming);
+	auto merge = [&](size_t begin, size_t end)
+	{
+		for (size_t row = begin; row < end; row++)
+		{
+			// TouchDesigner's rows go bottom-up, just like the map's y
+			float* pixel = pOut + 4 * row * mapWidth;
+			for (size_t x = 0; x < mapWidth; x++, pixel += 4)
+			{
+				const size_t cell = row * mapWidth + x;
+				int16_t value = myBuffers[cell];
+				for (size_t slice = 1; slice < slices; slice++)
+					value = std::max(value, myBuffers[slice * stride + cell]);
+
+				const float v = float(value);
+				if (stream)
+					writePixel<true>(pixel, v, v, v, value ? 1.0f : 0.0f);
+				else
+					writePixel<false>(pixel, v, v, v, value ? 1.0f : 0.0f);
+			}
+		}
+		if (stream)
+			writeFence();
+	};
+
+	if (pool)
+	{
+		pool->parallelFor(slices, scatter);
+		pool->parallelFor(mapHeight, merge, 16);
+	}
+	else
+	{
+		scatter(0, slices);
+		merge(0, mapHeight);
+	}
+}
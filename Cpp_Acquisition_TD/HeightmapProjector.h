@@ -0,0 +1,48 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "AlignedBuffer.h"
+#include "DepthKernels.h"
+
+class WorkerPool;
+
+struct HeightmapSettings
+{
+	// Output resolution
+	int32_t		width = 512;
+	int32_t		height = 512;
+	// The area covered, in mm on the floor. The origin is right below the
+	// camera.
+	double		centerX = 0.0;
+	double		centerY = 2000.0;
+	double		sizeX = 4000.0;
+	double		sizeY = 4000.0;
+};
+
+// Reprojects the camera's points into a top-down orthographic heightmap.
+// Each point is scattered into the cell below it, keeping the highest
+// point per cell. Every thread of the pool scatters a share of the rows
+// into a z-buffer of its own, so there are no atomics or locks in the
+// inner loop; the buffers are merged at the end.
+//
+// With a valid floor plane the map lies in that plane and holds heights
+// above it. Without one the camera is taken to look straight down, with
+// the floor at floorDistance.
+class HeightmapProjector
+{
+public:
+	HeightmapProjector();
+
+	// Only pixels that are non-zero in valid are projected. Writes
+	// settings.width x settings.height RGBA32Float pixels with the height
+	// in mm in RGB, and alpha 1 where any point landed.
+	void		apply(const uint8_t* pInput, const int16_t* valid, size_t width, size_t height,
+					size_t srcBpp, const ScanCoordinates& coordinates, const FloorPlane& floor,
+					double floorDistance, const HeightmapSettings& settings, WorkerPool* pool,
+					float* pOut);
+
+private:
+	// One z-buffer per slice, slice stride apart
+	AlignedBuffer<int16_t>	myBuffers;
+};
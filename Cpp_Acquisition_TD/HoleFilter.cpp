@@ -0,0 +1,193 @@
+#include "stdafx.h"
+#include "HoleFilter.h"
+#include "WorkerPool.h"
+#include <algorithm>
+
+static const size_t RowGrain = 16;
+static const size_t ColumnStrip = 64;
+
+static void
+forRange(WorkerPool* pool, size_t count, size_t grain, const std::function<void(size_t, size_t)>& fn)
+{
+	if (pool)
+		pool->parallelFor(count, fn, grain);
+	else
+		fn(0, count);
+}
+
+// Fills the runs of zeros along one row or column (stride apart) that are at
+// most maxSize long. Each pixel in a run takes the nearest valid end; where
+// both ends are as near, the farther depth wins so foreground objects don't
+// grow into the hole.
+static void
+fillRuns(int16_t* line, size_t length, size_t stride, size_t maxSize)
+{
+	size_t i = 0;
+	while (i < length)
+	{
+		if (line[i * stride] != 0)
+		{
+			i++;
+			continue;
+		}
+
+		const size_t begin = i;
+		while (i < length && line[i * stride] == 0)
+			i++;
+		const size_t end = i;
+
+		// A line with no depth at all has nothing to fill from
+		if (end - begin > maxSize || (begin == 0 && end == length))
+			continue;
+
+		const int16_t left = begin > 0 ? line[(begin - 1) * stride] : 0;
+		const int16_t right = end < length ? line[end * stride] : 0;
+
+		for (size_t j = begin; j < end; j++)
+		{
+			int16_t value;
+			if (!left)
+				value = right;
+			else if (!right)
+				value = left;
+			else
+			{
+				const size_t toLeft = j - begin;
+				const size_t toRight = end - 1 - j;
+				if (toLeft < toRight)
+					value = left;
+				else if (toRight < toLeft)
+					value = right;
+				else
+					value = std::max(left, right);
+			}
+			line[j * stride] = value;
+		}
+	}
+}
+
+HoleFilter::HoleFilter()
+{
+}
+
+void
+HoleFilter::apply(int16_t* depth, size_t width, size_t height,
+	const HoleFillSettings& settings, WorkerPool* pool)
+{
+	if (settings.maxSize <= 0 || width == 0 || height == 0)
+		return;
+
+	switch (settings.mode)
+	{
+		case HoleFillMode::Nearest:
+			applyNearest(depth, width, height, settings.maxSize, pool);
+			break;
+		case HoleFillMode::PushPull:
+			applyPushPull(depth, width, height, settings.maxSize, pool);
+			break;
+		default:
+			break;
+	}
+}
+
+void
+HoleFilter::applyNearest(int16_t* depth, size_t width, size_t height,
+	int32_t maxSize, WorkerPool* pool)
+{
+	// Rows first. The ends of every run are valid pixels that are never
+	// written, so both passes can fill in place.
+	forRange(pool, height, RowGrain, [&](size_t begin, size_t end)
+	{
+		for (size_t y = begin; y < end; y++)
+			fillRuns(depth + y * width, width, 1, size_t(maxSize));
+	});
+
+	// Then columns, handed out in strips so neighboring threads don't
+	// share cache lines
+	const size_t strips = (width + ColumnStrip - 1) / ColumnStrip;
+	forRange(pool, strips, 1, [&](size_t begin, size_t end)
+	{
+		for (size_t x = begin * ColumnStrip; x < std::min(end * ColumnStrip, width); x++)
+			fillRuns(depth + x, height, width, size_t(maxSize));
+	});
+}
+
+void
+HoleFilter::applyPushPull(int16_t* depth, size_t width, size_t height,
+	int32_t maxSize, WorkerPool* pool)
+{
+	// A hole of maxSize pixels is gone after log2(maxSize) halvings
+	int numLevels = 0;
+	while (numLevels < MaxLevels && (1 << numLevels) < maxSize)
+		numLevels++;
+
+	int16_t* levels[MaxLevels + 1];
+	size_t widths[MaxLevels + 1];
+	size_t heights[MaxLevels + 1];
+	levels[0] = depth;
+	widths[0] = width;
+	heights[0] = height;
+
+	// Push: each level holds the mean of the valid pixels under it
+	for (int l = 1; l <= numLevels; l++)
+	{
+		const size_t srcWidth = widths[l - 1];
+		const size_t srcHeight = heights[l - 1];
+		const size_t dstWidth = (srcWidth + 1) / 2;
+		const size_t dstHeight = (srcHeight + 1) / 2;
+
+		myLevels[l - 1].resize(dstWidth * dstHeight);
+		levels[l] = myLevels[l - 1].data();
+		widths[l] = dstWidth;
+		heights[l] = dstHeight;
+
+		const int16_t* src = levels[l - 1];
+		int16_t* dst = levels[l];
+		forRange(pool, dstHeight, RowGrain, [&](size_t begin, size_t end)
+		{
+			for (size_t y = begin; y < end; y++)
+			{
+				const int16_t* row0 = src + 2 * y * srcWidth;
+				const int16_t* row1 = 2 * y + 1 < srcHeight ? row0 + srcWidth : row0;
+				for (size_t x = 0; x < dstWidth; x++)
+				{
+					const size_t x0 = 2 * x;
+					const size_t x1 = std::min(x0 + 1, srcWidth - 1);
+					const int32_t v[4] = { row0[x0], row0[x1], row1[x0], row1[x1] };
+
+					int32_t sum = 0;
+					int32_t n = 0;
+					for (int i = 0; i < 4; i++)
+					{
+						sum += v[i];
+						n += v[i] != 0;
+					}
+					dst[y * dstWidth + x] = n ? int16_t(sum / n) : 0;
+				}
+			}
+		});
+	}
+
+	// Pull: from the top down, the holes in each level take the value of
+	// the pixel above them
+	for (int l = numLevels - 1; l >= 0; l--)
+	{
+		const int16_t* parent = levels[l + 1];
+		const size_t parentWidth = widths[l + 1];
+		int16_t* dst = levels[l];
+		const size_t dstWidth = widths[l];
+		forRange(pool, heights[l], RowGrain, [&](size_t begin, size_t end)
+		{
+			for (size_t y = begin; y < end; y++)
+			{
+				int16_t* row = dst + y * dstWidth;
+				const int16_t* parentRow = parent + (y / 2) * parentWidth;
+				for (size_t x = 0; x < dstWidth; x++)
+				{
+					if (row[x] == 0)
+						row[x] = parentRow[x / 2];
+				}
+			}
+		});
+	}
+}
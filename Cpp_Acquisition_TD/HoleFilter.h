@@ -0,0 +1,48 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "AlignedBuffer.h"
+
+class WorkerPool;
+
+enum class HoleFillMode : int32_t
+{
+	Off = 0,
+	// Each hole takes the nearest valid depth along its row, then its column
+	Nearest,
+	// Holes take the average of the valid depth around them, from a
+	// pyramid of half resolution levels
+	PushPull,
+};
+
+struct HoleFillSettings
+{
+	HoleFillMode	mode = HoleFillMode::Off;
+	// Holes wider than this (pixels) are left alone, so a missing wall
+	// doesn't get smeared out of the edges around it
+	int32_t			maxSize = 16;
+};
+
+// Fills invalid (0) pixels in the int16 depth plane, in place. Both modes
+// touch every pixel a fixed number of times, whatever the frame looks like,
+// so the cost per frame stays the same when the scene loses depth.
+class HoleFilter
+{
+public:
+	static const int	MaxLevels = 8;
+
+	HoleFilter();
+
+	void		apply(int16_t* depth, size_t width, size_t height,
+					const HoleFillSettings& settings, WorkerPool* pool);
+
+private:
+	void		applyNearest(int16_t* depth, size_t width, size_t height,
+					int32_t maxSize, WorkerPool* pool);
+	void		applyPushPull(int16_t* depth, size_t width, size_t height,
+					int32_t maxSize, WorkerPool* pool);
+
+	// Level 1 and up, level 0 is the depth plane itself
+	AlignedBuffer<int16_t>	myLevels[MaxLevels];
+};
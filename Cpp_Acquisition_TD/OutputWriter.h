@@ -0,0 +1,82 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "Simd.h"
+
+// How the kernels store their RGBA32Float pixels into the TOP's output.
+//
+// In CPUMemWriteOnly mode TouchDesigner's buffers are slow to read and
+// nothing on the CPU reads them again, so plain stores waste the time it
+// takes to read each cache line in before writing it (the read for
+// ownership), and push the kernels' own data out of the cache. Streaming
+// (non-temporal) stores skip the cache: consecutive pixels collect in a
+// write combining buffer, which goes out as one full 64 byte line every 4
+// pixels. That only works out if the pixels are written one after another
+// in increasing address order, a row or a run of a row at a time.
+//
+// Streaming stores aren't ordered with other stores, so every thread that
+// streamed calls writeFence() before it signals that it's done, and the
+// acquisition thread fences again before handing the buffer over.
+enum class OutputStores : int32_t
+{
+	// Plain stores, through the cache
+	Cached = 0,
+	// Non-temporal stores, when the buffer is aligned for them
+	Streaming,
+};
+
+// True if the kernels should stream into pOut
+inline bool
+canStream(const float* pOut, OutputStores stores)
+{
+#ifdef DEPTH_SSE2
+	return stores == OutputStores::Streaming && (reinterpret_cast<uintptr_t>(pOut) & 15) == 0;
+#else
+	return false;
+#endif
+}
+
+template <bool Stream>
+inline void
+writePixel(float* pixel, float r, float g, float b, float a)
+{
+#ifdef DEPTH_SSE2
+	if (Stream)
+	{
+		_mm_stream_ps(pixel, _mm_setr_ps(r, g, b, a));
+		return;
+	}
+#endif
+	pixel[0] = r;
+	pixel[1] = g;
+	pixel[2] = b;
+	pixel[3] = a;
+}
+
+template <bool Stream>
+inline void
+writePixel(float* pixel, const float* rgba)
+{
+#ifdef DEPTH_SSE2
+	if (Stream)
+	{
+		_mm_stream_ps(pixel, _mm_loadu_ps(rgba));
+		return;
+	}
+#endif
+	pixel[0] = rgba[0];
+	pixel[1] = rgba[1];
+	pixel[2] = rgba[2];
+	pixel[3] = rgba[3];
+}
+
+// Makes this thread's streaming stores visible before anything it stores
+// after
+inline void
+writeFence()
+{
+#ifdef DEPTH_SSE2
+	_mm_sfence();
+#endif
+}
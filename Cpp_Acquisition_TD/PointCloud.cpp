@@ -0,0 +1,101 @@
+#include "stdafx.h"
+#include "PointCloud.h"
+#include "OutputWriter.h"
+#include "WorkerPool.h"
+#include <algorithm>
+#include <string.h>
+
+// Small enough that every core gets a few bands, big enough that the
+// prefix sum over the bands is nothing
+static const size_t BandHeight = 16;
+
+static inline bool
+isPoint(const uint8_t* p, int16_t valid)
+{
+	return valid != 0 && *reinterpret_cast<const int16_t*>(p + 4) != 0;
+}
+
+PointCloudCompactor::PointCloudCompactor() :
+	myPointCount(0)
+{
+}
+
+void
+PointCloudCompactor::apply(const uint8_t* pInput, const int16_t* valid, size_t width, size_t height,
+	size_t srcBpp, const ScanCoordinates& coordinates, WorkerPool* pool, float* pOut)
+{
+	const size_t srcPixelSize = srcBpp / 8;
+	const size_t numBands = (height + BandHeight - 1) / BandHeight;
+	myOffsets.resize(numBands);
+	size_t* offsets = myOffsets.data();
+
+	auto count = [&](size_t begin, size_t end)
+	{
+		for (size_t band = begin; band < end; band++)
+		{
+			const size_t y0 = band * BandHeight;
+			const size_t y1 = std::min(y0 + BandHeight, height);
+			const uint8_t* pIn = pInput + y0 * width * srcPixelSize;
+			const int16_t* v = valid + y0 * width;
+
+			size_t n = 0;
+			for (size_t i = 0; i < (y1 - y0) * width; i++, pIn += srcPixelSize)
+				n += isPoint(pIn, v[i]) ? 1 : 0;
+			offsets[band] = n;
+		}
+	};
+
+	const bool stream = canStream(pOut, OutputStores::Streaming);
+	auto write = [&](size_t begin, size_t end)
+	{
+		const float s = coordinates.scale;
+		for (size_t band = begin; band < end; band++)
+		{
+			const size_t y0 = band * BandHeight;
+			const size_t y1 = std::min(y0 + BandHeight, height);
+			const uint8_t* pIn = pInput + y0 * width * srcPixelSize;
+			const int16_t* v = valid + y0 * width;
+
+			float* pixel = pOut + 4 * offsets[band];
+			for (size_t i = 0; i < (y1 - y0) * width; i++, pIn += srcPixelSize)
+			{
+				if (!isPoint(pIn, v[i]))
+					continue;
+
+				const float x = float(*reinterpret_cast<const uint16_t*>(pIn)) * s + coordinates.offsetA;
+				const float y = float(*reinterpret_cast<const uint16_t*>(pIn + 2)) * s + coordinates.offsetB;
+				const float z = float(*reinterpret_cast<const int16_t*>(pIn + 4)) * s;
+				const float intensity = float(*reinterpret_cast<const uint16_t*>(pIn + 6));
+				if (stream)
+					writePixel<true>(pixel, x, y, z, intensity);
+				else
+					writePixel<false>(pixel, x, y, z, intensity);
+				pixel += 4;
+			}
+		}
+		if (stream)
+			writeFence();
+	};
+
+	if (pool)
+		pool->parallelFor(numBands, count);
+	else
+		count(0, numBands);
+
+	// Exclusive prefix sum, turning the counts into offsets
+	size_t total = 0;
+	for (size_t band = 0; band < numBands; band++)
+	{
+		const size_t n = offsets[band];
+		offsets[band] = total;
+		total += n;
+	}
+	myPointCount = total;
+
+	if (pool)
+		pool->parallelFor(numBands, write);
+	else
+		write(0, numBands);
+
+	memset(pOut + 4 * total, 0, (width * height - total) * 4 * sizeof(float));
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+#include "DepthKernels.h"
+
+class WorkerPool;
+
+// Packs the camera's valid points into the front of an RGBA32Float image,
+// one pixel per point with x, y, z (mm) in RGB and the intensity in A, so a
+// Geometry COMP can instance the first pointCount() of them and skip the
+// dead pixels altogether. The rest of the image is zeroed.
+//
+// Stream compaction in two parallel passes over bands of rows: count the
+// points in each band, turn the counts into write offsets with a prefix
+// sum, then have every band write its points from its own offset.
+class PointCloudCompactor
+{
+public:
+	PointCloudCompactor();
+
+	// A point is kept where valid is non-zero and the camera measured a z.
+	// pOut holds width * height pixels, enough for every point.
+	void		apply(const uint8_t* pInput, const int16_t* valid, size_t width, size_t height,
+					size_t srcBpp, const ScanCoordinates& coordinates, WorkerPool* pool, float* pOut);
+
+	// Points written by the last apply()
+	size_t		pointCount() const { return myPointCount; }
+
+private:
+	// Per band, its point count and then its write offset
+	std::vector<size_t>	myOffsets;
+	size_t				myPointCount;
+};
@@ -0,0 +1,294 @@
+#include "stdafx.h"
+#include "RemapTable.h"
+#include "Colormap.h"
+#include "OutputWriter.h"
+#include "WorkerPool.h"
+#include <algorithm>
+#include <cmath>
+
+// The gather walks the output in tiles, so the camera pixels one tile reads
+// stay in cache even when a rotation turns output rows into image columns
+static const size_t TileRows = 16;
+static const size_t TileColumns = 64;
+
+bool
+RemapSettings::isIdentity() const
+{
+	static const RemapSettings identity;
+	for (int i = 0; i < 8; i++)
+	{
+		if (corners[i] != identity.corners[i])
+			return false;
+	}
+	return !undistort && orientation == RemapOrientation::None;
+}
+
+RemapSettings
+RemapSettings::scaled(double sx, double sy) const
+{
+	RemapSettings s = *this;
+	// Pixel centers stay put, as they do in the Resampler
+	s.focalX = focalX * sx;
+	s.focalY = focalY * sy;
+	s.centerX = (centerX + 0.5) * sx - 0.5;
+	s.centerY = (centerY + 0.5) * sy - 0.5;
+	return s;
+}
+
+RemapSettings
+RemapSettings::shifted(double x, double y) const
+{
+	RemapSettings s = *this;
+	s.centerX = centerX - x;
+	s.centerY = centerY - y;
+	return s;
+}
+
+bool
+RemapSettings::operator==(const RemapSettings& other) const
+{
+	for (int i = 0; i < 8; i++)
+	{
+		if (corners[i] != other.corners[i])
+			return false;
+	}
+	if (orientation != other.orientation || undistort != other.undistort)
+		return false;
+	// The lens only matters while it's in use
+	if (!undistort)
+		return true;
+	return focalX == other.focalX && focalY == other.focalY &&
+		centerX == other.centerX && centerY == other.centerY &&
+		radial[0] == other.radial[0] && radial[1] == other.radial[1] && radial[2] == other.radial[2] &&
+		tangential[0] == other.tangential[0] && tangential[1] == other.tangential[1];
+}
+
+// Finds h (with h[8] = 1) mapping each from[i] to to[i], for four u, v
+// pairs. Returns false, leaving h alone, if three of the points are on a
+// line.
+static bool
+solveHomography(const double* from, const double* to, double* h)
+{
+	// Two rows per point pair of
+	//   h0 x + h1 y + h2 - h6 x X - h7 y X = X
+	//   h3 x + h4 y + h5 - h6 x Y - h7 y Y = Y
+	double a[8][9];
+	for (int i = 0; i < 4; i++)
+	{
+		const double x = from[2 * i];
+		const double y = from[2 * i + 1];
+		const double X = to[2 * i];
+		const double Y = to[2 * i + 1];
+		const double rowX[9] = { x, y, 1.0, 0.0, 0.0, 0.0, -x * X, -y * X, X };
+		const double rowY[9] = { 0.0, 0.0, 0.0, x, y, 1.0, -x * Y, -y * Y, Y };
+		std::copy(rowX, rowX + 9, a[2 * i]);
+		std::copy(rowY, rowY + 9, a[2 * i + 1]);
+	}
+
+	// Gaussian elimination with partial pivoting
+	for (int col = 0; col < 8; col++)
+	{
+		int pivot = col;
+		for (int row = col + 1; row < 8; row++)
+		{
+			if (std::fabs(a[row][col]) > std::fabs(a[pivot][col]))
+				pivot = row;
+		}
+		if (std::fabs(a[pivot][col]) < 1e-12)
+			return false;
+		if (pivot != col)
+			std::swap_ranges(a[col], a[col] + 9, a[pivot]);
+
+		for (int row = 0; row < 8; row++)
+		{
+			if (row == col)
+				continue;
+			const double f = a[row][col] / a[col][col];
+			for (int k = col; k < 9; k++)
+				a[row][k] -= f * a[col][k];
+		}
+	}
+
+	for (int i = 0; i < 8; i++)
+		h[i] = a[i][8] / a[i][i];
+	h[8] = 1.0;
+	return true;
+}
+
+RemapTable::RemapTable() :
+	myWidth(0),
+	myHeight(0),
+	myOutWidth(0),
+	myOutHeight(0),
+	myIdentity(true),
+	myValid(false)
+{
+}
+
+void
+RemapTable::update(const RemapSettings& settings, size_t width, size_t height, WorkerPool* pool)
+{
+	if (myValid && settings == mySettings && width == myWidth && height == myHeight)
+		return;
+
+	mySettings = settings;
+	myWidth = width;
+	myHeight = height;
+	myOutWidth = settings.swapsAxes() ? height : width;
+	myOutHeight = settings.swapsAxes() ? width : height;
+	myIdentity = settings.isIdentity();
+	if (!myIdentity)
+		build(pool);
+	myValid = true;
+}
+
+void
+RemapTable::build(WorkerPool* pool)
+{
+	const RemapSettings& s = mySettings;
+
+	// Maps the corner pinned u, v back to the image's. A corner pin that
+	// folds the image onto a line leaves the image as it is.
+	static const double unitCorners[8] = { 0.0, 0.0, 1.0, 0.0, 0.0, 1.0, 1.0, 1.0 };
+	double h[9] = { 1.0, 0.0, 0.0, 0.0, 1.0, 0.0, 0.0, 0.0, 1.0 };
+	solveHomography(s.corners, unitCorners, h);
+
+	myTable.resize(myOutWidth * myOutHeight);
+	int32_t* table = myTable.data();
+
+	const double width = double(myWidth);
+	const double height = double(myHeight);
+
+	auto rows = [&](size_t begin, size_t end)
+	{
+		for (size_t oy = begin; oy < end; oy++)
+		{
+			int32_t* entry = table + oy * myOutWidth;
+			for (size_t ox = 0; ox < myOutWidth; ox++)
+			{
+				// Output u, v, with v going up like TouchDesigner's rows
+				const double u = (ox + 0.5) / myOutWidth;
+				const double v = (oy + 0.5) / myOutHeight;
+
+				// Undo the rotation or mirror
+				double wu = u;
+				double wv = v;
+				switch (s.orientation)
+				{
+					case RemapOrientation::None: break;
+					case RemapOrientation::Rotate90: wu = v; wv = 1.0 - u; break;
+					case RemapOrientation::Rotate180: wu = 1.0 - u; wv = 1.0 - v; break;
+					case RemapOrientation::Rotate270: wu = 1.0 - v; wv = u; break;
+					case RemapOrientation::FlipHorizontal: wu = 1.0 - u; break;
+					case RemapOrientation::FlipVertical: wv = 1.0 - v; break;
+				}
+
+				// Undo the corner pin
+				entry[ox] = -1;
+				const double w = h[6] * wu + h[7] * wv + h[8];
+				if (!(w > 0.0))
+					continue;
+				const double iu = (h[0] * wu + h[1] * wv + h[2]) / w;
+				const double iv = (h[3] * wu + h[4] * wv + h[5]) / w;
+
+				// Pixel in the undistorted image, with y going down
+				double px = iu * width - 0.5;
+				double py = (1.0 - iv) * height - 0.5;
+
+				// Where the lens puts that pixel on the sensor
+				if (s.undistort)
+				{
+					const double x = (px - s.centerX) / s.focalX;
+					const double y = (py - s.centerY) / s.focalY;
+					const double r2 = x * x + y * y;
+					const double radial = 1.0 + r2 * (s.radial[0] + r2 * (s.radial[1] + r2 * s.radial[2]));
+					const double xd = x * radial + 2.0 * s.tangential[0] * x * y + s.tangential[1] * (r2 + 2.0 * x * x);
+					const double yd = y * radial + s.tangential[0] * (r2 + 2.0 * y * y) + 2.0 * s.tangential[1] * x * y;
+					px = xd * s.focalX + s.centerX;
+					py = yd * s.focalY + s.centerY;
+				}
+
+				const double ix = std::floor(px + 0.5);
+				const double iy = std::floor(py + 0.5);
+				if (ix >= 0.0 && iy >= 0.0 && ix < width && iy < height)
+					entry[ox] = int32_t(size_t(iy) * myWidth + size_t(ix));
+			}
+		}
+	};
+
+	if (pool)
+		pool->parallelFor(myOutHeight, rows, 16);
+	else
+		rows(0, myOutHeight);
+}
+
+// Writes the RGBA pixelFn(entry) returns for every output pixel, a tile at
+// a time. Each row of a tile is a 1 KB run of the output, written in
+// address order, so streaming stores still fill whole cache lines.
+template <bool Stream, typename PixelFn>
+static void
+gatherTiles(const int32_t* table, size_t outWidth, size_t outHeight, float* pOut, WorkerPool* pool,
+	const PixelFn& pixelFn)
+{
+	const size_t tilesX = (outWidth + TileColumns - 1) / TileColumns;
+	const size_t tilesY = (outHeight + TileRows - 1) / TileRows;
+
+	auto tiles = [&](size_t begin, size_t end)
+	{
+		for (size_t tile = begin; tile < end; tile++)
+		{
+			const size_t x0 = (tile % tilesX) * TileColumns;
+			const size_t y0 = (tile / tilesX) * TileRows;
+			const size_t x1 = std::min(x0 + TileColumns, outWidth);
+			const size_t y1 = std::min(y0 + TileRows, outHeight);
+
+			for (size_t y = y0; y < y1; y++)
+			{
+				const int32_t* entry = table + y * outWidth;
+				float* pixel = pOut + 4 * (y * outWidth + x0);
+				for (size_t x = x0; x < x1; x++, pixel += 4)
+					writePixel<Stream>(pixel, pixelFn(entry[x]));
+			}
+		}
+		if (Stream)
+			writeFence();
+	};
+
+	if (pool)
+		pool->parallelFor(tilesX * tilesY, tiles, 4);
+	else
+		tiles(0, tilesX * tilesY);
+}
+
+template <typename PixelFn>
+static void
+gather(const int32_t* table, size_t outWidth, size_t outHeight, float* pOut, WorkerPool* pool,
+	const PixelFn& pixelFn)
+{
+	if (canStream(pOut, OutputStores::Streaming))
+		gatherTiles<true>(table, outWidth, outHeight, pOut, pool, pixelFn);
+	else
+		gatherTiles<false>(table, outWidth, outHeight, pOut, pool, pixelFn);
+}
+
+static const float Black[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
+static const float White[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+
+void
+RemapTable::depthToColor(const int16_t* pDepth, const DepthColormap& colormap,
+	float* pOut, WorkerPool* pool) const
+{
+	gather(myTable.data(), myOutWidth, myOutHeight, pOut, pool, [&](int32_t entry)
+	{
+		return entry >= 0 ? colormap.lookup(pDepth[entry]) : Black;
+	});
+}
+
+void
+RemapTable::maskToColor(const uint8_t* pMask, float* pOut, WorkerPool* pool) const
+{
+	gather(myTable.data(), myOutWidth, myOutHeight, pOut, pool, [&](int32_t entry)
+	{
+		return (entry >= 0 && pMask[entry]) ? White : Black;
+	});
+}
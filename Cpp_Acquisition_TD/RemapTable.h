@@ -0,0 +1,95 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "AlignedBuffer.h"
+
+class DepthColormap;
+class WorkerPool;
+
+enum class RemapOrientation : int32_t
+{
+	None = 0,
+	// Counter-clockwise
+	Rotate90,
+	Rotate180,
+	Rotate270,
+	FlipHorizontal,
+	FlipVertical,
+};
+
+// Geometry applied to the image outputs, in this order: lens undistortion,
+// a corner pin (homography) and a rotation or mirror.
+struct RemapSettings
+{
+	// Brown-Conrady lens model, in pixels of the camera image
+	bool				undistort = false;
+	double				focalX = 520.0;
+	double				focalY = 520.0;
+	double				centerX = 320.0;
+	double				centerY = 240.0;
+	double				radial[3] = { 0.0, 0.0, 0.0 };
+	double				tangential[2] = { 0.0, 0.0 };
+
+	// Where the bottom left, bottom right, top left and top right corners of
+	// the image land in the output, as u, v pairs from 0 to 1
+	double				corners[8] = { 0.0, 0.0, 1.0, 0.0, 0.0, 1.0, 1.0, 1.0 };
+
+	RemapOrientation	orientation = RemapOrientation::None;
+
+	// True if the output is the image as it is
+	bool		isIdentity() const;
+
+	// Rotating by 90 or 270 degrees swaps the output's width and height
+	bool		swapsAxes() const
+				{
+					return orientation == RemapOrientation::Rotate90 || orientation == RemapOrientation::Rotate270;
+				}
+
+	// The same settings for the camera image resampled by sx, sy, which
+	// only changes the lens
+	RemapSettings	scaled(double sx, double sy) const;
+	// The same settings for the part of the image from x, y on
+	RemapSettings	shifted(double x, double y) const;
+
+	bool		operator==(const RemapSettings& other) const;
+	bool		operator!=(const RemapSettings& other) const { return !(*this == other); }
+};
+
+// A lookup table holding, for every output pixel, the index of the camera
+// pixel it shows, or -1 if none. The table is only rebuilt when the settings
+// or the image size change, so per frame a remapped output costs one gather.
+// The table is laid out in the output's bottom-up row order, which folds
+// TouchDesigner's vertical flip into it as well.
+class RemapTable
+{
+public:
+	RemapTable();
+
+	// Rebuilds the table if anything changed since the last call
+	void		update(const RemapSettings& settings, size_t width, size_t height, WorkerPool* pool);
+
+	// Output size, the image's with the axes swapped by a 90 degree rotation
+	size_t		width() const { return myOutWidth; }
+	size_t		height() const { return myOutHeight; }
+	bool		isIdentity() const { return myIdentity; }
+
+	// The remapped counterparts of depthToColor and maskToColor. Pixels that
+	// fall outside the camera image are black.
+	void		depthToColor(const int16_t* pDepth, const DepthColormap& colormap,
+					float* pOut, WorkerPool* pool) const;
+	void		maskToColor(const uint8_t* pMask, float* pOut, WorkerPool* pool) const;
+
+private:
+	void		build(WorkerPool* pool);
+
+	RemapSettings			mySettings;
+	size_t					myWidth;
+	size_t					myHeight;
+	size_t					myOutWidth;
+	size_t					myOutHeight;
+	bool					myIdentity;
+	bool					myValid;
+
+	AlignedBuffer<int32_t>	myTable;
+};
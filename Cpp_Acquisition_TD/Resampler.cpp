@@ -0,0 +1,319 @@
+#include "stdafx.h"
+#include "Resampler.h"
+#include "Simd.h"
+#include "WorkerPool.h"
+#include <algorithm>
+#include <cmath>
+
+static const size_t RowGrain = 16;
+
+void
+ResampleSettings::imageSize(size_t cameraWidth, size_t cameraHeight, bool swapAxes,
+	size_t* w, size_t* h) const
+{
+	switch (resolution)
+	{
+		case OutputResolution::Camera:
+			*w = cameraWidth;
+			*h = cameraHeight;
+			break;
+		case OutputResolution::Half:
+			*w = (cameraWidth + 1) / 2;
+			*h = (cameraHeight + 1) / 2;
+			break;
+		case OutputResolution::Quarter:
+			*w = (cameraWidth + 3) / 4;
+			*h = (cameraHeight + 3) / 4;
+			break;
+		case OutputResolution::Custom:
+			*w = size_t(std::max(1, swapAxes ? height : width));
+			*h = size_t(std::max(1, swapAxes ? width : height));
+			break;
+	}
+}
+
+Resampler::Resampler() :
+	myWidth(0),
+	myHeight(0),
+	myOutWidth(0),
+	myOutHeight(0),
+	myFactor(0)
+{
+}
+
+void
+Resampler::buildFootprints(size_t size, size_t outSize, std::vector<Footprint>& footprints)
+{
+	footprints.resize(outSize);
+	const double scale = double(size) / double(outSize);
+	for (size_t o = 0; o < outSize; o++)
+	{
+		Footprint& f = footprints[o];
+
+		// The boxes split the source between them, scaling up every output
+		// pixel still covers one
+		f.begin = int32_t(o * size / outSize);
+		f.end = std::max(f.begin + 1, int32_t((o + 1) * size / outSize));
+
+		// Pixel centers line up, so the image doesn't shift as it's scaled
+		const double center = (o + 0.5) * scale;
+		f.nearest = std::min(int32_t(center), int32_t(size) - 1);
+
+		const double s = std::min(std::max(center - 0.5, 0.0), double(size - 1));
+		f.lower = int32_t(s);
+		f.upper = std::min(f.lower + 1, int32_t(size) - 1);
+		f.weight = float(s - f.lower);
+	}
+}
+
+void
+Resampler::update(size_t width, size_t height, size_t outWidth, size_t outHeight)
+{
+	if (width == myWidth && height == myHeight && outWidth == myOutWidth && outHeight == myOutHeight)
+		return;
+
+	myWidth = width;
+	myHeight = height;
+	myOutWidth = outWidth;
+	myOutHeight = outHeight;
+	buildFootprints(width, outWidth, myColumns);
+	buildFootprints(height, outHeight, myRows);
+
+	myFactor = 0;
+	for (size_t factor = 2; factor <= 4; factor *= 2)
+	{
+		if (width == outWidth * factor && height == outHeight * factor)
+			myFactor = factor;
+	}
+}
+
+// Rounds to nearest even like _mm_cvtps_epi32 does, so both box paths
+// agree to the bit. lrint would do too, but it's a call.
+static inline int16_t
+roundDepth(float z)
+{
+#ifdef DEPTH_SSE2
+	return int16_t(_mm_cvtss_si32(_mm_set_ss(z)));
+#else
+	return int16_t(std::lrint(z));
+#endif
+}
+
+static inline int16_t
+average(int32_t sum, int32_t count)
+{
+	return count ? roundDepth(float(sum) / float(count)) : 0;
+}
+
+static inline int16_t
+boxDepth(const int16_t* pDepth, size_t width, const Resampler::Footprint& column, const Resampler::Footprint& row)
+{
+	int32_t sum = 0;
+	int32_t count = 0;
+	for (int32_t y = row.begin; y < row.end; y++)
+	{
+		const int16_t* p = pDepth + y * width;
+		for (int32_t x = column.begin; x < column.end; x++)
+		{
+			sum += p[x];
+			count += p[x] != 0 ? 1 : 0;
+		}
+	}
+	return average(sum, count);
+}
+
+static inline int16_t
+bilinearDepth(const int16_t* pDepth, size_t width, const Resampler::Footprint& column, const Resampler::Footprint& row)
+{
+	const int16_t z[4] = {
+		pDepth[row.lower * width + column.lower], pDepth[row.lower * width + column.upper],
+		pDepth[row.upper * width + column.lower], pDepth[row.upper * width + column.upper] };
+	const float w[4] = {
+		(1.0f - column.weight) * (1.0f - row.weight), column.weight * (1.0f - row.weight),
+		(1.0f - column.weight) * row.weight, column.weight * row.weight };
+
+	// Invalid pixels add 0 to the sum, only their weight has to go
+	float sum = 0.0f;
+	float total = 0.0f;
+	for (int i = 0; i < 4; i++)
+	{
+		sum += w[i] * z[i];
+		total += z[i] != 0 ? w[i] : 0.0f;
+	}
+	return total > 0.0f ? roundDepth(sum / total) : 0;
+}
+
+#ifdef DEPTH_SSE2
+// Sums of two neighboring int32 lanes of a and of b, as a0+a1, a2+a3, b0+b1, b2+b3
+static inline __m128i
+addPairs(__m128i a, __m128i b)
+{
+	const __m128 pa = _mm_castsi128_ps(_mm_add_epi32(a, _mm_srli_epi64(a, 32)));
+	const __m128 pb = _mm_castsi128_ps(_mm_add_epi32(b, _mm_srli_epi64(b, 32)));
+	return _mm_castps_si128(_mm_shuffle_ps(pa, pb, _MM_SHUFFLE(2, 0, 2, 0)));
+}
+
+// The box average of 4 output pixels, from Factor x Factor blocks whose
+// rows start at rows[k] + Factor * x
+template <size_t Factor>
+static inline __m128i
+boxDepth4(const int16_t* const* rows, size_t x)
+{
+	const __m128i ones = _mm_set1_epi16(1);
+	const __m128i zero = _mm_setzero_si128();
+
+	// madd adds each neighboring pair of int16 into an int32, which is a
+	// whole block row for Factor 2 and half of one for Factor 4. The
+	// invalid pixels are counted as the -1s of the compare.
+	__m128i sum[Factor / 2];
+	__m128i invalid[Factor / 2];
+	for (size_t i = 0; i < Factor / 2; i++)
+	{
+		sum[i] = zero;
+		invalid[i] = zero;
+	}
+	for (size_t k = 0; k < Factor; k++)
+	{
+		for (size_t i = 0; i < Factor / 2; i++)
+		{
+			const __m128i z = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rows[k] + Factor * x + 8 * i));
+			sum[i] = _mm_add_epi32(sum[i], _mm_madd_epi16(z, ones));
+			invalid[i] = _mm_add_epi32(invalid[i], _mm_madd_epi16(_mm_cmpeq_epi16(z, zero), ones));
+		}
+	}
+
+	__m128i total = sum[0];
+	__m128i zeros = invalid[0];
+	if (Factor == 4)
+	{
+		total = addPairs(sum[0], sum[Factor / 2 - 1]);
+		zeros = addPairs(invalid[0], invalid[Factor / 2 - 1]);
+	}
+	__m128i count = _mm_add_epi32(_mm_set1_epi32(int32_t(Factor * Factor)), zeros);
+
+	// A block without any valid pixel divides 0 by 1 instead of by 0
+	count = _mm_sub_epi32(count, _mm_cmpeq_epi32(count, _mm_setzero_si128()));
+	return _mm_cvtps_epi32(_mm_div_ps(_mm_cvtepi32_ps(total), _mm_cvtepi32_ps(count)));
+}
+#endif
+
+template <size_t Factor>
+static void
+boxDepthRows(const int16_t* pDepth, size_t width, size_t outWidth, size_t y0, size_t y1,
+	const Resampler::Footprint* columns, const Resampler::Footprint* rows, int16_t* pOut)
+{
+	for (size_t oy = y0; oy < y1; oy++)
+	{
+		int16_t* out = pOut + oy * outWidth;
+		size_t ox = 0;
+#ifdef DEPTH_SSE2
+		const int16_t* block[Factor];
+		for (size_t k = 0; k < Factor; k++)
+			block[k] = pDepth + (oy * Factor + k) * width;
+		for (; ox + 8 <= outWidth; ox += 8)
+		{
+			const __m128i lo = boxDepth4<Factor>(block, ox);
+			const __m128i hi = boxDepth4<Factor>(block, ox + 4);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(out + ox), _mm_packs_epi32(lo, hi));
+		}
+#endif
+		for (; ox < outWidth; ox++)
+			out[ox] = boxDepth(pDepth, width, columns[ox], rows[oy]);
+	}
+}
+
+void
+Resampler::depth(const int16_t* pDepth, ResampleFilter filter, int16_t* pOut, WorkerPool* pool) const
+{
+	const Footprint* columns = myColumns.data();
+	const Footprint* rows = myRows.data();
+
+	auto resample = [&](size_t begin, size_t end)
+	{
+		if (filter == ResampleFilter::Box && myFactor == 2)
+		{
+			boxDepthRows<2>(pDepth, myWidth, myOutWidth, begin, end, columns, rows, pOut);
+			return;
+		}
+		if (filter == ResampleFilter::Box && myFactor == 4)
+		{
+			boxDepthRows<4>(pDepth, myWidth, myOutWidth, begin, end, columns, rows, pOut);
+			return;
+		}
+
+		for (size_t oy = begin; oy < end; oy++)
+		{
+			int16_t* out = pOut + oy * myOutWidth;
+			const int16_t* nearestRow = pDepth + rows[oy].nearest * myWidth;
+			switch (filter)
+			{
+				case ResampleFilter::Box:
+					for (size_t ox = 0; ox < myOutWidth; ox++)
+						out[ox] = boxDepth(pDepth, myWidth, columns[ox], rows[oy]);
+					break;
+				case ResampleFilter::Bilinear:
+					for (size_t ox = 0; ox < myOutWidth; ox++)
+						out[ox] = bilinearDepth(pDepth, myWidth, columns[ox], rows[oy]);
+					break;
+				case ResampleFilter::Nearest:
+					for (size_t ox = 0; ox < myOutWidth; ox++)
+						out[ox] = nearestRow[columns[ox].nearest];
+					break;
+			}
+		}
+	};
+
+	if (pool)
+		pool->parallelFor(myOutHeight, resample, RowGrain);
+	else
+		resample(0, myOutHeight);
+}
+
+void
+Resampler::mask(const uint8_t* pMask, ResampleFilter filter, uint8_t* pOut, WorkerPool* pool) const
+{
+	const Footprint* columns = myColumns.data();
+	const Footprint* rows = myRows.data();
+
+	auto resample = [&](size_t begin, size_t end)
+	{
+		for (size_t oy = begin; oy < end; oy++)
+		{
+			const Footprint& row = rows[oy];
+			uint8_t* out = pOut + oy * myOutWidth;
+			for (size_t ox = 0; ox < myOutWidth; ox++)
+			{
+				const Footprint& column = columns[ox];
+				bool on = false;
+				if (filter == ResampleFilter::Box)
+				{
+					int32_t count = 0;
+					for (int32_t y = row.begin; y < row.end; y++)
+					{
+						for (int32_t x = column.begin; x < column.end; x++)
+							count += pMask[y * myWidth + x] ? 1 : 0;
+					}
+					on = 2 * count >= (row.end - row.begin) * (column.end - column.begin);
+				}
+				else if (filter == ResampleFilter::Bilinear)
+				{
+					const float top = (pMask[row.lower * myWidth + column.lower] ? 1.0f - column.weight : 0.0f) +
+						(pMask[row.lower * myWidth + column.upper] ? column.weight : 0.0f);
+					const float bottom = (pMask[row.upper * myWidth + column.lower] ? 1.0f - column.weight : 0.0f) +
+						(pMask[row.upper * myWidth + column.upper] ? column.weight : 0.0f);
+					on = top + (bottom - top) * row.weight >= 0.5f;
+				}
+				else
+				{
+					on = pMask[row.nearest * myWidth + column.nearest] != 0;
+				}
+				out[ox] = on ? 255 : 0;
+			}
+		}
+	};
+
+	if (pool)
+		pool->parallelFor(myOutHeight, resample, RowGrain);
+	else
+		resample(0, myOutHeight);
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+class WorkerPool;
+
+enum class OutputResolution : int32_t
+{
+	// The camera's own Width and Height
+	Camera = 0,
+	// Previews, which also cut the coloring and the upload to a quarter
+	// or a sixteenth
+	Half,
+	Quarter,
+	// The width and height given in the settings
+	Custom,
+};
+
+enum class ResampleFilter : int32_t
+{
+	// Average of the valid pixels under each output pixel, the one to use
+	// for scaling down
+	Box = 0,
+	// Weighted average of the 4 nearest valid pixels
+	Bilinear,
+	Nearest,
+};
+
+struct ResampleSettings
+{
+	OutputResolution	resolution = OutputResolution::Camera;
+	// The output size for Custom, as it comes out after any rotation
+	int32_t				width = 640;
+	int32_t				height = 480;
+	ResampleFilter		filter = ResampleFilter::Box;
+
+	// Size the camera image is resampled to. It's the output size with
+	// the axes swapped back if the output turns the image on its side.
+	void		imageSize(size_t cameraWidth, size_t cameraHeight, bool swapAxes,
+					size_t* width, size_t* height) const;
+};
+
+// Scales the depth plane (or the foreground mask) of the camera image to
+// the resolution of the image outputs, ahead of the coloring, so that only
+// the output's pixels get colored, remapped and uploaded. Invalid (0)
+// pixels never count towards the average, the output is only invalid where
+// every pixel it covers is. The mask is resampled to a mask again, an
+// output pixel is foreground if at least half of what it covers is.
+//
+// The per column and per row footprints are kept, and only rebuilt when the
+// sizes change. Box filtering by exactly 2 or 4 both ways, the Half and
+// Quarter previews of the camera image, takes an SSE2 path.
+class Resampler
+{
+public:
+	Resampler();
+
+	// Rebuilds the footprints if the sizes changed since the last call
+	void		update(size_t width, size_t height, size_t outWidth, size_t outHeight);
+
+	void		depth(const int16_t* pDepth, ResampleFilter filter, int16_t* pOut, WorkerPool* pool) const;
+	void		mask(const uint8_t* pMask, ResampleFilter filter, uint8_t* pOut, WorkerPool* pool) const;
+
+	// What one output column (or row) takes from the source
+	struct Footprint
+	{
+		// Box: the source pixels [begin, end) it covers
+		int32_t		begin;
+		int32_t		end;
+		int32_t		nearest;
+		// Bilinear: lower and upper blended, weight being upper's share
+		int32_t		lower;
+		int32_t		upper;
+		float		weight;
+	};
+
+private:
+	static void	buildFootprints(size_t size, size_t outSize, std::vector<Footprint>& footprints);
+
+	size_t					myWidth;
+	size_t					myHeight;
+	size_t					myOutWidth;
+	size_t					myOutHeight;
+	// Box factor both ways, or 0 if the sizes aren't exactly 2 or 4 apart
+	size_t					myFactor;
+	std::vector<Footprint>	myColumns;
+	std::vector<Footprint>	myRows;
+};
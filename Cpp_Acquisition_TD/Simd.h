@@ -0,0 +1,8 @@
+#pragma once
+
+// SSE2 is part of x64, so every 64 bit build can use it. The kernels fall
+// back to plain C++ loops when it isn't available.
+#if defined(_M_X64) || defined(_M_AMD64) || defined(__SSE2__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define DEPTH_SSE2 1
+#include <emmintrin.h>
+#endif
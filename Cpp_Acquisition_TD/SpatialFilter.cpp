@@ -0,0 +1,319 @@
+#include "stdafx.h"
+#include "SpatialFilter.h"
+#include "Simd.h"
+#include "WorkerPool.h"
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+static const size_t TileWidth = 128;
+static const size_t TileHeight = 32;
+
+// A compare-exchange network that leaves the median of n values in slot
+// 'median'. It starts from a Batcher odd-even merge sort over the next
+// power of two and is then trimmed down:
+//  - the extra slots are treated as +infinity, so comparisons against them
+//    either do nothing or just move a value, which is folded into a slot
+//    renaming instead of being executed
+//  - comparators that can't influence the median slot are dropped
+// That leaves 113 min/max pairs for 25 values instead of 191, and 24 for 9.
+struct MedianNetwork
+{
+	std::vector<std::pair<int, int>>	comparators;
+	int									median;
+
+	explicit
+	MedianNetwork(int n)
+	{
+		int size = 1;
+		while (size < n)
+			size *= 2;
+
+		std::vector<std::pair<int, int>> sorter;
+		for (int p = 1; p < size; p *= 2)
+		{
+			for (int k = p; k >= 1; k /= 2)
+			{
+				for (int j = k % p; j + k < size; j += 2 * k)
+				{
+					for (int i = 0; i < std::min(k, size - j - k); i++)
+					{
+						if ((i + j) / (p * 2) == (i + j + k) / (p * 2))
+							sorter.push_back(std::make_pair(i + j, i + j + k));
+					}
+				}
+			}
+		}
+
+		// Forward pass: follow where the real values and the padding end up
+		std::vector<int> slot(size);
+		std::vector<bool> padding(size);
+		for (int i = 0; i < size; i++)
+		{
+			slot[i] = i;
+			padding[i] = i >= n;
+		}
+
+		std::vector<std::pair<int, int>> live;
+		for (const auto& c : sorter)
+		{
+			const int a = c.first;
+			const int b = c.second;
+			if (padding[b])
+				continue;
+			if (padding[a])
+			{
+				std::swap(slot[a], slot[b]);
+				padding[a] = false;
+				padding[b] = true;
+				continue;
+			}
+			live.push_back(std::make_pair(slot[a], slot[b]));
+		}
+
+		// Backward pass: keep only what feeds the median
+		median = slot[n / 2];
+		std::vector<bool> needed(size, false);
+		needed[median] = true;
+		for (auto it = live.rbegin(); it != live.rend(); ++it)
+		{
+			if (needed[it->first] || needed[it->second])
+			{
+				needed[it->first] = true;
+				needed[it->second] = true;
+				comparators.push_back(*it);
+			}
+		}
+		std::reverse(comparators.begin(), comparators.end());
+	}
+};
+
+static const MedianNetwork&
+medianNetwork(int radius)
+{
+	static const MedianNetwork network3(9);
+	static const MedianNetwork network5(25);
+	return radius == 1 ? network3 : network5;
+}
+
+static inline int16_t
+clampedAt(const int16_t* src, size_t width, size_t height, ptrdiff_t x, ptrdiff_t y)
+{
+	x = std::min(std::max<ptrdiff_t>(x, 0), ptrdiff_t(width) - 1);
+	y = std::min(std::max<ptrdiff_t>(y, 0), ptrdiff_t(height) - 1);
+	return src[y * width + x];
+}
+
+static int16_t
+medianPixel(const int16_t* src, size_t width, size_t height, size_t x, size_t y, int radius)
+{
+	const MedianNetwork& network = medianNetwork(radius);
+	int16_t v[32];
+
+	int n = 0;
+	for (int dy = -radius; dy <= radius; dy++)
+		for (int dx = -radius; dx <= radius; dx++)
+			v[n++] = clampedAt(src, width, height, ptrdiff_t(x) + dx, ptrdiff_t(y) + dy);
+
+	for (const auto& c : network.comparators)
+	{
+		const int16_t a = v[c.first];
+		const int16_t b = v[c.second];
+		v[c.first] = std::min(a, b);
+		v[c.second] = std::max(a, b);
+	}
+	return v[network.median];
+}
+
+static void
+medianTile(const int16_t* src, int16_t* dst, size_t width, size_t height, int radius,
+	size_t x0, size_t y0, size_t x1, size_t y1)
+{
+	const size_t r = size_t(radius);
+	const bool interiorRows = width > 2 * r;
+
+	for (size_t y = y0; y < y1; y++)
+	{
+		int16_t* out = dst + y * width;
+
+		if (!interiorRows || y < r || y + r >= height)
+		{
+			for (size_t x = x0; x < x1; x++)
+				out[x] = medianPixel(src, width, height, x, y, radius);
+			continue;
+		}
+
+		const size_t inner0 = std::max(x0, r);
+		const size_t inner1 = std::min(x1, width - r);
+
+		size_t x = x0;
+		for (; x < inner0; x++)
+			out[x] = medianPixel(src, width, height, x, y, radius);
+
+#ifdef DEPTH_SSE2
+		const MedianNetwork& network = medianNetwork(radius);
+		for (; x + 8 <= inner1; x += 8)
+		{
+			__m128i v[32];
+			int n = 0;
+			for (int dy = -radius; dy <= radius; dy++)
+			{
+				const int16_t* row = src + (y + dy) * width + x;
+				for (int dx = -radius; dx <= radius; dx++)
+					v[n++] = _mm_loadu_si128((const __m128i*)(row + dx));
+			}
+
+			for (const auto& c : network.comparators)
+			{
+				const __m128i a = v[c.first];
+				const __m128i b = v[c.second];
+				v[c.first] = _mm_min_epi16(a, b);
+				v[c.second] = _mm_max_epi16(a, b);
+			}
+			_mm_storeu_si128((__m128i*)(out + x), v[network.median]);
+		}
+#endif
+		for (; x < x1; x++)
+			out[x] = medianPixel(src, width, height, x, y, radius);
+	}
+}
+
+static const int BilateralRadius = 2;
+
+// Spatial weights for sigma = 1.5 px
+static const float BilateralSpatial[5] = { 0.411f, 0.800f, 1.000f, 0.800f, 0.411f };
+
+// Branch free: differences past the end of the table hit its last entry,
+// which is 0, and invalid neighbors are masked out by (z != 0)
+static inline void
+accumulateBilateral(int16_t center, int16_t z, float spatial, const float* rangeWeights, int maxDiff,
+	float& sum, float& weightSum)
+{
+	const int diff = std::min(std::abs(int(z) - int(center)), maxDiff);
+	const float w = spatial * rangeWeights[diff] * float(z != 0);
+	sum += w * z;
+	weightSum += w;
+}
+
+static void
+bilateralTile(const int16_t* src, int16_t* dst, size_t width, size_t height,
+	const std::vector<float>& rangeWeights, size_t x0, size_t y0, size_t x1, size_t y1)
+{
+	const ptrdiff_t r = BilateralRadius;
+	const int maxDiff = int(rangeWeights.size()) - 1;
+
+	float spatial[2 * BilateralRadius + 1][2 * BilateralRadius + 1];
+	for (int dy = -BilateralRadius; dy <= BilateralRadius; dy++)
+		for (int dx = -BilateralRadius; dx <= BilateralRadius; dx++)
+			spatial[dy + r][dx + r] = BilateralSpatial[dx + r] * BilateralSpatial[dy + r];
+
+	for (size_t y = y0; y < y1; y++)
+	{
+		const bool interiorRow = ptrdiff_t(y) >= r && ptrdiff_t(y) + r < ptrdiff_t(height);
+
+		for (size_t x = x0; x < x1; x++)
+		{
+			const int16_t center = src[y * width + x];
+			if (center == 0)
+			{
+				dst[y * width + x] = 0;
+				continue;
+			}
+
+			float sum = 0.0f;
+			float weightSum = 0.0f;
+
+			if (interiorRow && ptrdiff_t(x) >= r && ptrdiff_t(x) + r < ptrdiff_t(width))
+			{
+				for (ptrdiff_t dy = -r; dy <= r; dy++)
+				{
+					const int16_t* row = src + (y + dy) * width + x;
+					for (ptrdiff_t dx = -r; dx <= r; dx++)
+						accumulateBilateral(center, row[dx], spatial[dy + r][dx + r], rangeWeights.data(), maxDiff, sum, weightSum);
+				}
+			}
+			else
+			{
+				for (ptrdiff_t dy = -r; dy <= r; dy++)
+				{
+					for (ptrdiff_t dx = -r; dx <= r; dx++)
+					{
+						const ptrdiff_t sx = ptrdiff_t(x) + dx;
+						const ptrdiff_t sy = ptrdiff_t(y) + dy;
+						if (sx < 0 || sy < 0 || sx >= ptrdiff_t(width) || sy >= ptrdiff_t(height))
+							continue;
+
+						accumulateBilateral(center, src[sy * width + sx], spatial[dy + r][dx + r], rangeWeights.data(), maxDiff, sum, weightSum);
+					}
+				}
+			}
+
+			// The center always contributes, so weightSum > 0
+			dst[y * width + x] = int16_t(sum / weightSum + 0.5f);
+		}
+	}
+}
+
+SpatialFilter::SpatialFilter() :
+	myRangeSigma(-1.0)
+{
+}
+
+void
+SpatialFilter::updateBilateralWeights(double rangeSigma)
+{
+	rangeSigma = std::max(rangeSigma, 1.0);
+	if (rangeSigma == myRangeSigma)
+		return;
+
+	myRangeSigma = rangeSigma;
+	const size_t size = size_t(3.0 * rangeSigma) + 1;
+	myRangeWeights.resize(size + 1);
+	for (size_t i = 0; i < size; i++)
+		myRangeWeights[i] = float(std::exp(-0.5 * (i / rangeSigma) * (i / rangeSigma)));
+	myRangeWeights[size] = 0.0f;
+}
+
+void
+SpatialFilter::apply(const int16_t* src, int16_t* dst, size_t width, size_t height,
+	const SpatialFilterSettings& settings, WorkerPool* pool)
+{
+	if (settings.mode == SpatialFilterMode::Bilateral)
+		updateBilateralWeights(settings.rangeSigma);
+
+	const size_t tilesX = (width + TileWidth - 1) / TileWidth;
+	const size_t tilesY = (height + TileHeight - 1) / TileHeight;
+
+	auto filterTiles = [&](size_t begin, size_t end)
+	{
+		for (size_t t = begin; t < end; t++)
+		{
+			const size_t x0 = (t % tilesX) * TileWidth;
+			const size_t y0 = (t / tilesX) * TileHeight;
+			const size_t x1 = std::min(x0 + TileWidth, width);
+			const size_t y1 = std::min(y0 + TileHeight, height);
+
+			switch (settings.mode)
+			{
+				case SpatialFilterMode::Median3x3:
+					medianTile(src, dst, width, height, 1, x0, y0, x1, y1);
+					break;
+				case SpatialFilterMode::Median5x5:
+					medianTile(src, dst, width, height, 2, x0, y0, x1, y1);
+					break;
+				case SpatialFilterMode::Bilateral:
+					bilateralTile(src, dst, width, height, myRangeWeights, x0, y0, x1, y1);
+					break;
+				default:
+					for (size_t y = y0; y < y1; y++)
+						std::copy(src + y * width + x0, src + y * width + x1, dst + y * width + x0);
+					break;
+			}
+		}
+	};
+
+	if (pool)
+		pool->parallelFor(tilesX * tilesY, filterTiles);
+	else
+		filterTiles(0, tilesX * tilesY);
+}
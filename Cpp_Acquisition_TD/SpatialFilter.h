@@ -0,0 +1,45 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+class WorkerPool;
+
+enum class SpatialFilterMode : int32_t
+{
+	Off = 0,
+	Median3x3,
+	Median5x5,
+	// 5x5 bilateral, weights fall off with distance and depth difference
+	Bilateral,
+};
+
+struct SpatialFilterSettings
+{
+	SpatialFilterMode	mode = SpatialFilterMode::Off;
+	// Depth difference (mm) at which a neighbor's weight falls to ~60%.
+	// Neighbors more than 3 sigma away are ignored, which keeps edges sharp.
+	double				rangeSigma = 50.0;
+};
+
+// Edge preserving filters on the int16 depth plane (mm, 0 = invalid).
+// The frame is cut into tiles which are spread over the worker pool; each
+// tile only touches a few KB of input rows, so it stays in L1/L2 while it
+// is being filtered.
+class SpatialFilter
+{
+public:
+	SpatialFilter();
+
+	// Filters src into dst, which must not overlap
+	void		apply(const int16_t* src, int16_t* dst, size_t width, size_t height,
+					const SpatialFilterSettings& settings, WorkerPool* pool);
+
+private:
+	void		updateBilateralWeights(double rangeSigma);
+
+	// Indexed by the absolute depth difference in mm, ending in a 0 weight
+	std::vector<float>	myRangeWeights;
+	double				myRangeSigma;
+};
@@ -0,0 +1,198 @@
+#include "stdafx.h"
+#include "TemporalFilter.h"
+#include "Simd.h"
+#include <algorithm>
+#include <string.h>
+
+// The history planes start on cache line boundaries
+static size_t
+planeStride(size_t count)
+{
+	return (count + 31) & ~size_t(31);
+}
+
+static inline int16_t
+saturate16(int32_t v)
+{
+	return int16_t(std::min(32767, std::max(-32768, v)));
+}
+
+static inline int16_t
+median3(int16_t a, int16_t b, int16_t c)
+{
+	return std::max(std::min(a, b), std::min(std::max(a, b), c));
+}
+
+TemporalFilter::TemporalFilter() :
+	myMode(TemporalFilterMode::Off),
+	myMedianFrames(0),
+	myCount(0),
+	myPrimed(false),
+	myHistoryIndex(0)
+{
+}
+
+void
+TemporalFilter::reset()
+{
+	myPrimed = false;
+	myHistoryIndex = 0;
+}
+
+void
+TemporalFilter::apply(int16_t* depth, size_t count, const TemporalFilterSettings& settings)
+{
+	const int32_t medianFrames = settings.medianFrames >= 5 ? 5 : 3;
+
+	// Any change in layout invalidates the history
+	if (settings.mode != myMode || count != myCount ||
+		(settings.mode == TemporalFilterMode::Median && medianFrames != myMedianFrames))
+	{
+		myMode = settings.mode;
+		myCount = count;
+		myMedianFrames = medianFrames;
+		reset();
+	}
+
+	switch (myMode)
+	{
+		case TemporalFilterMode::Average:
+			applyAverage(depth, count, settings);
+			break;
+		case TemporalFilterMode::Median:
+			applyMedian(depth, count);
+			break;
+		default:
+			break;
+	}
+}
+
+void
+TemporalFilter::applyAverage(int16_t* depth, size_t count, const TemporalFilterSettings& settings)
+{
+	myState.resize(count);
+	int16_t* state = myState.data();
+
+	if (!myPrimed)
+	{
+		memcpy(state, depth, count * sizeof(int16_t));
+		myPrimed = true;
+		return;
+	}
+
+	// state += alpha * (depth - state), with alpha in Q15. The difference is
+	// doubled (saturating) before the high multiply so the result is
+	// diff * alpha15 / 32768. The SIMD and scalar paths are bit exact.
+	const int16_t alpha15 = int16_t(std::min(1.0, std::max(0.0, settings.alpha)) * 32767.0 + 0.5);
+	const int16_t threshold = saturate16(settings.resetThreshold);
+
+	size_t i = 0;
+#ifdef DEPTH_SSE2
+	const __m128i vAlpha = _mm_set1_epi16(alpha15);
+	const __m128i vThreshold = _mm_set1_epi16(threshold);
+	const __m128i vZero = _mm_setzero_si128();
+	for (; i + 8 <= count; i += 8)
+	{
+		const __m128i z = _mm_loadu_si128((const __m128i*)(depth + i));
+		const __m128i s = _mm_load_si128((const __m128i*)(state + i));
+
+		const __m128i diff = _mm_subs_epi16(z, s);
+		const __m128i absDiff = _mm_max_epi16(diff, _mm_subs_epi16(vZero, diff));
+		const __m128i step = _mm_mulhi_epi16(_mm_adds_epi16(diff, diff), vAlpha);
+		const __m128i averaged = _mm_adds_epi16(s, step);
+
+		// Restart where the pixel moved, or where either value is invalid
+		const __m128i restart = _mm_or_si128(_mm_cmpgt_epi16(absDiff, vThreshold),
+			_mm_or_si128(_mm_cmpeq_epi16(z, vZero), _mm_cmpeq_epi16(s, vZero)));
+		const __m128i result = _mm_or_si128(_mm_and_si128(restart, z), _mm_andnot_si128(restart, averaged));
+
+		_mm_store_si128((__m128i*)(state + i), result);
+		_mm_storeu_si128((__m128i*)(depth + i), result);
+	}
+#endif
+	for (; i < count; i++)
+	{
+		const int16_t z = depth[i];
+		const int16_t s = state[i];
+		const int16_t diff = saturate16(int32_t(z) - s);
+		const int16_t absDiff = std::max(diff, saturate16(-int32_t(diff)));
+		const int16_t step = int16_t((int32_t(saturate16(2 * int32_t(diff))) * alpha15) >> 16);
+		const int16_t averaged = saturate16(int32_t(s) + step);
+
+		const bool restart = absDiff > threshold || z == 0 || s == 0;
+		const int16_t result = restart ? z : averaged;
+
+		state[i] = result;
+		depth[i] = result;
+	}
+}
+
+void
+TemporalFilter::applyMedian(int16_t* depth, size_t count)
+{
+	const int32_t numFrames = myMedianFrames;
+	const size_t stride = planeStride(count);
+	myState.resize(stride * numFrames);
+	int16_t* history = myState.data();
+
+	// Start with every slot holding the first frame, so the output is
+	// valid right away rather than after numFrames frames.
+	if (!myPrimed)
+	{
+		for (int32_t f = 0; f < numFrames; f++)
+			memcpy(history + f * stride, depth, count * sizeof(int16_t));
+		myHistoryIndex = 0;
+		myPrimed = true;
+		return;
+	}
+
+	memcpy(history + myHistoryIndex * stride, depth, count * sizeof(int16_t));
+	myHistoryIndex = (myHistoryIndex + 1) % numFrames;
+
+	const int16_t* h0 = history;
+	const int16_t* h1 = history + stride;
+	const int16_t* h2 = history + 2 * stride;
+
+	size_t i = 0;
+	if (numFrames == 3)
+	{
+#ifdef DEPTH_SSE2
+		for (; i + 8 <= count; i += 8)
+		{
+			const __m128i a = _mm_load_si128((const __m128i*)(h0 + i));
+			const __m128i b = _mm_load_si128((const __m128i*)(h1 + i));
+			const __m128i c = _mm_load_si128((const __m128i*)(h2 + i));
+			const __m128i m = _mm_max_epi16(_mm_min_epi16(a, b), _mm_min_epi16(_mm_max_epi16(a, b), c));
+			_mm_storeu_si128((__m128i*)(depth + i), m);
+		}
+#endif
+		for (; i < count; i++)
+			depth[i] = median3(h0[i], h1[i], h2[i]);
+	}
+	else
+	{
+		// median5(a..e) = median3(max(min(a,b), min(c,d)), min(max(a,b), max(c,d)), e)
+		const int16_t* h3 = history + 3 * stride;
+		const int16_t* h4 = history + 4 * stride;
+#ifdef DEPTH_SSE2
+		for (; i + 8 <= count; i += 8)
+		{
+			const __m128i a = _mm_load_si128((const __m128i*)(h0 + i));
+			const __m128i b = _mm_load_si128((const __m128i*)(h1 + i));
+			const __m128i c = _mm_load_si128((const __m128i*)(h2 + i));
+			const __m128i d = _mm_load_si128((const __m128i*)(h3 + i));
+			const __m128i e = _mm_load_si128((const __m128i*)(h4 + i));
+			const __m128i p = _mm_max_epi16(_mm_min_epi16(a, b), _mm_min_epi16(c, d));
+			const __m128i q = _mm_min_epi16(_mm_max_epi16(a, b), _mm_max_epi16(c, d));
+			const __m128i m = _mm_max_epi16(_mm_min_epi16(p, q), _mm_min_epi16(_mm_max_epi16(p, q), e));
+			_mm_storeu_si128((__m128i*)(depth + i), m);
+		}
+#endif
+		for (; i < count; i++)
+		{
+			const int16_t p = std::max(std::min(h0[i], h1[i]), std::min(h2[i], h3[i]));
+			const int16_t q = std::min(std::max(h0[i], h1[i]), std::max(h2[i], h3[i]));
+			depth[i] = median3(p, q, h4[i]);
+		}
+	}
+}
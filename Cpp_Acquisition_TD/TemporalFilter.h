@@ -0,0 +1,53 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "AlignedBuffer.h"
+
+enum class TemporalFilterMode : int32_t
+{
+	Off = 0,
+	// Exponential moving average, reset where the depth jumps
+	Average,
+	// Per-pixel median over the last few frames
+	Median,
+};
+
+struct TemporalFilterSettings
+{
+	TemporalFilterMode	mode = TemporalFilterMode::Off;
+	// Weight of the new frame in the moving average, 0..1
+	double				alpha = 0.3;
+	// Depth change (mm) above which a pixel is considered moving and the
+	// average restarts from the new value instead of smearing
+	int32_t				resetThreshold = 100;
+	// 3 or 5
+	int32_t				medianFrames = 3;
+};
+
+// Smooths the int16 depth plane (mm, 0 = invalid) over time, in place.
+// All per-pixel state is kept as int16 so a 640x480 frame needs 600KB for
+// the average, or 3/5 times that for the median history.
+class TemporalFilter
+{
+public:
+	TemporalFilter();
+
+	void		apply(int16_t* depth, size_t count, const TemporalFilterSettings& settings);
+
+	// Drops the history, the next frame is passed through unchanged
+	void		reset();
+
+private:
+	void		applyAverage(int16_t* depth, size_t count, const TemporalFilterSettings& settings);
+	void		applyMedian(int16_t* depth, size_t count);
+
+	TemporalFilterMode		myMode;
+	int32_t					myMedianFrames;
+	size_t					myCount;
+	bool					myPrimed;
+
+	// The running average, or medianFrames history planes back to back
+	AlignedBuffer<int16_t>	myState;
+	int32_t					myHistoryIndex;
+};
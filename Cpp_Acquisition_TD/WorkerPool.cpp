@@ -0,0 +1,103 @@
+#include "stdafx.h"
+#include "WorkerPool.h"
+#include <algorithm>
+
+WorkerPool::WorkerPool(int numThreads) :
+	myShouldExit(false),
+	myGeneration(0),
+	myBusy(0),
+	myJob(nullptr),
+	myCount(0),
+	myGrain(1),
+	myNext(0)
+{
+	if (numThreads < 0)
+		numThreads = std::max(1, int(std::thread::hardware_concurrency())) - 1;
+
+	for (int i = 0; i < numThreads; i++)
+		myThreads.emplace_back(&WorkerPool::threadMain, this);
+}
+
+WorkerPool::~WorkerPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(myLock);
+		myShouldExit = true;
+	}
+	myWake.notify_all();
+
+	for (auto& thread : myThreads)
+	{
+		if (thread.joinable())
+			thread.join();
+	}
+}
+
+void
+WorkerPool::parallelFor(size_t count, const std::function<void(size_t, size_t)>& fn, size_t grain)
+{
+	if (count == 0)
+		return;
+
+	grain = std::max<size_t>(grain, 1);
+	if (myThreads.empty() || count <= grain)
+	{
+		fn(0, count);
+		return;
+	}
+
+	std::lock_guard<std::mutex> serialize(myJobLock);
+
+	{
+		std::lock_guard<std::mutex> lock(myLock);
+		myJob = &fn;
+		myCount = count;
+		myGrain = grain;
+		myNext = 0;
+		myBusy = unsigned(myThreads.size());
+		myGeneration++;
+	}
+	myWake.notify_all();
+
+	runChunks();
+
+	std::unique_lock<std::mutex> lock(myLock);
+	myDone.wait(lock, [this]() { return myBusy == 0; });
+	myJob = nullptr;
+}
+
+void
+WorkerPool::runChunks()
+{
+	const std::function<void(size_t, size_t)>& fn = *myJob;
+	const size_t count = myCount;
+	const size_t grain = myGrain;
+
+	for (size_t begin = myNext.fetch_add(grain); begin < count; begin = myNext.fetch_add(grain))
+		fn(begin, std::min(begin + grain, count));
+}
+
+void
+WorkerPool::threadMain()
+{
+	uint64_t seenGeneration = 0;
+
+	while (true)
+	{
+		{
+			std::unique_lock<std::mutex> lock(myLock);
+			myWake.wait(lock, [&]() { return myShouldExit || myGeneration != seenGeneration; });
+			if (myShouldExit)
+				return;
+			seenGeneration = myGeneration;
+		}
+
+		runChunks();
+
+		{
+			std::lock_guard<std::mutex> lock(myLock);
+			if (--myBusy == 0)
+				myDone.notify_one();
+		}
+	}
+}
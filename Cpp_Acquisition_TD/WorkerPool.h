@@ -0,0 +1,52 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A fixed set of threads used to split the work on a single frame. The
+// thread calling parallelFor() works on the job too, so a pool created with
+// N threads runs N + 1 chunks at once. A pool with no threads simply runs
+// everything on the caller, which is what the batch tool uses when it
+// already has one frame per core in flight.
+class WorkerPool
+{
+public:
+	// numThreads < 0 picks one less than the number of cores
+	explicit WorkerPool(int numThreads = -1);
+	~WorkerPool();
+
+	WorkerPool(const WorkerPool&) = delete;
+	WorkerPool& operator=(const WorkerPool&) = delete;
+
+	// Number of threads that take part in a parallelFor, including the caller
+	unsigned			concurrency() const { return unsigned(myThreads.size()) + 1; }
+
+	// Calls fn(begin, end) over chunks of at most grain items until [0, count)
+	// is covered, and returns once every chunk is done. Calls from several
+	// threads are serialized.
+	void				parallelFor(size_t count, const std::function<void(size_t, size_t)>& fn, size_t grain = 1);
+
+private:
+	void				threadMain();
+	void				runChunks();
+
+	std::vector<std::thread>	myThreads;
+
+	std::mutex					myJobLock;
+
+	std::mutex					myLock;
+	std::condition_variable		myWake;
+	std::condition_variable		myDone;
+	bool						myShouldExit;
+	uint64_t					myGeneration;
+	unsigned					myBusy;
+
+	const std::function<void(size_t, size_t)>*	myJob;
+	size_t						myCount;
+	size_t						myGrain;
+	std::atomic<size_t>			myNext;
+};